@@ -4,6 +4,12 @@ void AreaLight::discretize(unsigned k)
 {
 	if(discretization.size()!=k)
 		discretization.resize(k);	
+	if(k>0)
+		discretize(k, &discretization[0]);
+}
+
+void AreaLight::discretize(unsigned k, Vec3Df* points) const
+{
 	Vec3Df x1(0.0f, 0.0f, 0.0f);
 	Vec3Df y1;
 	if(orientation[0]<=0.00001f && orientation[0] >=-0.00001f)
@@ -18,7 +24,7 @@ void AreaLight::discretize(unsigned k)
 		float angle=2*3.14*rand()/RAND_MAX;
 		Vec3Df v(r*cos(angle), r*sin(angle), 0.0f);
 		Vec3Df v2(x1[0]*v[0]+y1[0]*v[1],x1[1]*v[0]+y1[1]*v[1],x1[2]*v[0]+y1[2]*v[1]);
-		discretization[i]=pos+v2;
+		points[i]=pos+v2;
 	}
 }
  
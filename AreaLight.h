@@ -15,9 +15,15 @@ public:
     virtual ~AreaLight () {}
 
     inline const Vec3Df & getOrientation () const { return orientation; }
+    // o déjà normalisée, gardée au bit près : la renormaliser la change
+    // (scène partagée, dont le hash doit rester celui du créateur)
+    inline void setOrientation (const Vec3Df & o) { orientation = o; discretize (discretization.size ()); }
     inline const std::vector<Vec3Df> & getDiscretization () const { return discretization; }
     inline float getRayon () const { return rayon; }
     void discretize(unsigned k);
+    // Mêmes k points tirés au hasard, écrits dans points sans toucher à la
+    // discrétisation de la source (pas d'allocation)
+    void discretize(unsigned k, Vec3Df* points) const;
 
 private:
     std::vector<Vec3Df> discretization;
@@ -65,6 +65,9 @@ public:
     inline float getSize () const {
         return std::max (getWidth (), std::max (getHeight (), getLength ()));
     }
+    inline float getArea () const {
+        return 2.0f * (getWidth () * getHeight () + getHeight () * getLength () + getLength () * getWidth ());
+    }
     inline float getRadius () const {
         return Vec3Df::distance (minBb, maxBb) / 2.0;
     }
@@ -7,6 +7,7 @@
 // *********************************************************
 
 #include "GLViewer.h"
+#include "Trace.h"
 
 #include <iostream>
 #include <cstdlib>
@@ -126,6 +127,7 @@ void GLViewer::init() {
 
 void GLViewer::draw () {
     if (displayMode == RayDisplayMode) {
+        TraceScope trace ("glDrawPixels");
         glDrawPixels (rayImage.width (),
                       rayImage.height (),
                       GL_RGB,
@@ -0,0 +1,44 @@
+// *********************************************************
+// Hash Class
+// 64 bits FNV-1a accumulator, used to fingerprint scenes
+// and render settings.
+// *********************************************************
+
+#ifndef HASH_H
+#define HASH_H
+
+#include <string>
+
+#include "Vec3D.h"
+
+class Hash {
+public:
+    inline Hash () : h (14695981039346656037ULL) {}
+
+    inline void add (const void * data, unsigned int size) {
+        const unsigned char * bytes = static_cast<const unsigned char *> (data);
+        for (unsigned int i = 0; i < size; i++) {
+            h ^= bytes[i];
+            h *= 1099511628211ULL;
+        }
+    }
+    inline void add (unsigned int u) { add (&u, sizeof (u)); }
+    inline void add (float f) { add (&f, sizeof (f)); }
+    inline void add (bool b) { add (static_cast<unsigned int> (b)); }
+    inline void add (const Vec3Df & v) { add (v[0]); add (v[1]); add (v[2]); }
+    inline void add (const std::string & s) { add (s.data (), s.size ()); }
+
+    inline unsigned long long get () const { return h; }
+
+private:
+    unsigned long long h;
+};
+
+#endif // HASH_H
+
+// Some Emacs-Hints -- please don't remove:
+//
+//  Local Variables:
+//  mode:C++
+//  tab-width:4
+//  End:
@@ -1,43 +1,136 @@
 #include "KDTree.h"
+#include "Trace.h"
 
-KDTree::KDTree() : root(NULL), depthMax(10)
+#include <algorithm>
+
+KDTree::KDTree() : depthMax(10), leafSize(10), extNodes(NULL), extTriangles(NULL), nbNodes(0), nbTriangles(0), mailbox(false), compressed(false)
 {}
 
-Node* KDTree::getRoot() const
+void KDTree::attach(const KDFlatNode* n, unsigned nbN, const unsigned* t, unsigned nbT, unsigned nbMeshTriangles)
 {
-	return root;
+	vector<KDFlatNode>().swap(nodes);
+	vector<unsigned>().swap(triangleIndices);
+	vector<unsigned char>().swap(leafStream);
+	compressed=false;
+	extNodes=n;
+	extTriangles=t;
+	nbNodes=nbN;
+	nbTriangles=nbT;
+	mailbox=(nbT > KD_MAILBOX_DUPLICATION*nbMeshTriangles);
 }
 
-void KDTree::buildKDTree(const Mesh& m)
+void KDTree::buildKDTree(const RenderMesh& m, const KDBuildParameters& p)
 {
-	depthMax=7;
-	const vector<Vertex>& vertices = m.getVertices();
+	TraceScope trace("KDTree::buildKDTree");
+	depthMax=std::min(p.depthMax, KD_MAX_DEPTH);
+	leafSize=p.leafSize;
+	const Vec3Df* positions = m.getPositions();
+	const unsigned* indices = m.getIndices();
 
 	vector<unsigned> triangles;
-	triangles.resize(m.getTriangles().size());
+	triangles.resize(m.getNbTriangles());
 	for(unsigned i=0; i<triangles.size(); i++)
 		triangles[i]=i;	
 
 	BoundingBox bbox;
-	bbox = BoundingBox (vertices[0].getPos ());
-	for (unsigned int i = 1; i < vertices.size (); i++)
-		bbox.extendTo (vertices[i].getPos ());
+	bbox = BoundingBox (positions[0]);
+	for (unsigned int i = 1; i < m.getNbVertices (); i++)
+		bbox.extendTo (positions[i]);
 
-	root = build(triangles, m, bbox, 0);
+	vector<BoundingBox> bounds(triangles.size());
+	for(unsigned i=0; i<triangles.size(); i++)
+	{
+		const unsigned* v = indices + 3*i;
+		bounds[i]=BoundingBox(positions[v[0]]);
+		bounds[i].extendTo(positions[v[1]]);
+		bounds[i].extendTo(positions[v[2]]);
+	}
+
+	Node* root = build(triangles, bounds, m, bbox, 0);
+
+	// Aplatissement : la racine est le noeud 0
+	extNodes=NULL;
+	extTriangles=NULL;
+	nodes.assign(1, KDFlatNode());
+	triangleIndices.clear();
+	leafStream.clear();
+	compressed=false;
+	flatten(root, 0);
+	nbNodes=nodes.size();
+	nbTriangles=triangleIndices.size();
+	mailbox=(nbTriangles > KD_MAILBOX_DUPLICATION*m.getNbTriangles());
+	delete root;
 }
 
-Node* KDTree::build(const vector<unsigned>& triangles, const Mesh& m, const BoundingBox & bbToFitIn, unsigned depth)
+void KDTree::compress(const Vec3Df& margin)
+{
+	TraceScope trace("KDTree::compress");
+	if(isAttached() || isCompressed() || nodes.empty())
+		return;
+	vector<unsigned> leaf;
+	for(unsigned i=0; i<nodes.size(); i++)
+	{
+		KDFlatNode & f = nodes[i];
+		f.bBox = BoundingBox(f.bBox.getMin()-margin, f.bBox.getMax()+margin);
+		if(!f.leaf)
+			continue;
+		leaf.assign(triangleIndices.begin()+f.firstTriangle, triangleIndices.begin()+f.firstTriangle+f.nbTriangles);
+		std::sort(leaf.begin(), leaf.end());
+		f.firstTriangle=leafStream.size();
+		unsigned previous=0;
+		for(unsigned j=0; j<leaf.size(); j++)
+		{
+			// 7 bits par octet, le bit de poids fort annonce un octet de plus
+			unsigned delta=leaf[j]-previous;
+			previous=leaf[j];
+			while(delta>=0x80u)
+			{
+				leafStream.push_back(static_cast<unsigned char>(delta | 0x80u));
+				delta>>=7;
+			}
+			leafStream.push_back(static_cast<unsigned char>(delta));
+		}
+	}
+	vector<unsigned>().swap(triangleIndices);
+	compressed=true;
+}
+
+void KDTree::flatten(const Node* n, unsigned index)
+{
+	KDFlatNode & f = nodes[index];
+	f.bBox=n->getBoundingBox();
+	if(n->isLeaf())
+	{
+		f.leaf=1;
+		f.child=0;
+		f.firstTriangle=triangleIndices.size();
+		f.nbTriangles=n->getNbTriangles();
+		triangleIndices.insert(triangleIndices.end(), n->getTriangles(), n->getTriangles()+n->getNbTriangles());
+		return;
+	}
+	// Les deux fils sont réservés ensemble pour être consécutifs
+	unsigned child = nodes.size();
+	f.leaf=0;
+	f.child=child;
+	f.firstTriangle=0;
+	f.nbTriangles=0;
+	nodes.resize(child+2);
+	flatten(n->getLeftChild(), child);
+	flatten(n->getRightChild(), child+1);
+}
+
+Node* KDTree::build(const vector<unsigned>& triangles, const vector<BoundingBox>& bounds, const RenderMesh& m, const BoundingBox & bbToFitIn, unsigned depth)
 {
 	Node* n = new Node(bbToFitIn, depth);
-	if(depth>=depthMax-1 || triangles.size()<10)
+	if(depth+1>=depthMax || triangles.size()<leafSize || triangles.empty())
 	{
 		n->setTriangles(triangles);
 		n->depth=depthMax;
 	}
 	else
 	{
-		Axis maxAxis = findMaxAxis(triangles, m);
-		Vec3Df medianSample = findMedianSample(triangles, m, maxAxis);
+		Axis maxAxis = findMaxAxis(bbToFitIn);
+		Vec3Df medianSample = findMedianSample(bounds, maxAxis);
 
 		BoundingBox bBoxRight, bBoxLeft;
 
@@ -45,11 +138,14 @@ Node* KDTree::build(const vector<unsigned>& triangles, const Mesh& m, const Boun
 
 		vector<unsigned> trianglesRight;
 		vector<unsigned> trianglesLeft;
+		vector<BoundingBox> boundsRight;
+		vector<BoundingBox> boundsLeft;
 
-		split(trianglesLeft, trianglesRight, triangles, medianSample, maxAxis, m);
+		split(trianglesLeft, boundsLeft, bBoxLeft, trianglesRight, boundsRight, bBoxRight,
+			triangles, m, bbToFitIn, maxAxis, medianSample[maxAxis]);
 
-		n->leftChild=build(trianglesLeft, m, bBoxLeft, depth+1);
-		n->rightChild=build(trianglesRight, m, bBoxRight, depth+1);
+		n->leftChild=build(trianglesLeft, boundsLeft, m, bBoxLeft, depth+1);
+		n->rightChild=build(trianglesRight, boundsRight, m, bBoxRight, depth+1);
 	}
 
 	return n;
@@ -67,43 +163,117 @@ void KDTree::splitBBox(const BoundingBox& bBox, BoundingBox& bBoxRight, Bounding
 	bBoxLeft = BoundingBox(minbb, maxLeft);
 }
 
-void KDTree::split(vector<unsigned>& trianglesLeft,vector<unsigned>& trianglesRight,const vector<unsigned>& triangles, const Vec3Df& medianSample, const Axis & maxAxis, const Mesh& m)
+// Un triangle est d'abord découpé par la boîte du noeud, puis va du côté
+// du plan que sa partie découpée touche vraiment ; chaque boîte fille est
+// ensuite resserrée sur ses triangles découpés : l'espace vide autour de la
+// géométrie n'est plus parcouru.
+void KDTree::split(vector<unsigned>& trianglesLeft, vector<BoundingBox>& boundsLeft, BoundingBox& bBoxLeft,
+	vector<unsigned>& trianglesRight, vector<BoundingBox>& boundsRight, BoundingBox& bBoxRight,
+	const vector<unsigned>& triangles, const RenderMesh& m, const BoundingBox& bBox, const Axis& axis, float plane)
 {
-	const vector<Triangle>& t = m.getTriangles();
-	const vector<Vertex>& v = m.getVertices();
+	const Vec3Df* positions = m.getPositions();
+	const unsigned* indices = m.getIndices();
+	// Marge pour qu'un triangle sur une face ne soit pas perdu aux erreurs
+	// d'arrondi près
+	float margin = 1e-5f*bBox.getSize() + 1e-7f;
+	Vec3Df polygon[MAX_CLIPPED_VERTICES], side[MAX_CLIPPED_VERTICES];
 	for(unsigned i=0; i<triangles.size(); i++)
 	{
-		bool addRight=false;
-		bool addLeft=false;
-		for(unsigned j=0; j<3; j++)
+		const unsigned* v = indices + 3*triangles[i];
+		polygon[0] = positions[v[0]];
+		polygon[1] = positions[v[1]];
+		polygon[2] = positions[v[2]];
+		unsigned nbVertices = 3;
+		for(unsigned a=0; a<3 && nbVertices>0; a++)
 		{
-			if(addRight && addLeft) 
-				break;
-			bool b=v[t[triangles[i]].getVertex(j)].getPos()[maxAxis]<medianSample[maxAxis];
-			if(b && !addLeft)
-			{
-				addLeft=true;
-				trianglesLeft.push_back(triangles[i]);
-			}
-			else if(!b && !addRight)
-			{
-				addRight=true;
-				trianglesRight.push_back(triangles[i]);
-			}
+			nbVertices = clipPolygon(polygon, nbVertices, a, bBox.getMin()[a]-margin, true);
+			nbVertices = clipPolygon(polygon, nbVertices, a, bBox.getMax()[a]+margin, false);
+		}
+		if(nbVertices==0)
+			continue;
+		float minAxis = polygon[0][axis];
+		float maxAxis = polygon[0][axis];
+		for(unsigned j=1; j<nbVertices; j++)
+		{
+			minAxis = std::min(minAxis, polygon[j][axis]);
+			maxAxis = std::max(maxAxis, polygon[j][axis]);
+		}
+		// Un triangle qui touche seulement le plan n'est pas dupliqué ; s'il
+		// est dans le plan, il va à droite
+		bool left = minAxis<plane;
+		bool right = maxAxis>plane || !left;
+		if(left)
+		{
+			std::copy(polygon, polygon+nbVertices, side);
+			unsigned n = clipPolygon(side, nbVertices, axis, plane, false);
+			trianglesLeft.push_back(triangles[i]);
+			boundsLeft.push_back(polygonBounds(side, n));
 		}
+		if(right)
+		{
+			std::copy(polygon, polygon+nbVertices, side);
+			unsigned n = clipPolygon(side, nbVertices, axis, plane, true);
+			trianglesRight.push_back(triangles[i]);
+			boundsRight.push_back(polygonBounds(side, n));
+		}
+	}
+	for(unsigned i=0; i<boundsLeft.size(); i++)
+	{
+		if(i==0)
+			bBoxLeft=boundsLeft[0];
+		else
+			bBoxLeft.extendTo(boundsLeft[i]);
+	}
+	for(unsigned i=0; i<boundsRight.size(); i++)
+	{
+		if(i==0)
+			bBoxRight=boundsRight[0];
+		else
+			bBoxRight.extendTo(boundsRight[i]);
 	}
 }
 
-Vec3Df KDTree::findMedianSample(const vector<unsigned>& triangles, const Mesh& m, const Axis& axis)
+// Sutherland-Hodgman contre un plan de normale l'axe, en gardant le côté
+// au-dessus (above) ou au-dessous du plan. Le polygone est remplacé par sa
+// partie gardée, dont le nombre de sommets est retourné.
+unsigned KDTree::clipPolygon(Vec3Df* polygon, unsigned nbVertices, unsigned axis, float plane, bool above)
 {
-	vector<Vec3Df> barycentres;
-	barycentres.resize(triangles.size());
-	for(unsigned i=0; i<triangles.size(); i++)
+	Vec3Df clipped[MAX_CLIPPED_VERTICES];
+	unsigned nbClipped = 0;
+	for(unsigned j=0; j<nbVertices; j++)
 	{
-		barycentres[i]=(m.getVertices()[m.getTriangles()[triangles[i]].getVertex(0)].getPos()
-				+ m.getVertices()[m.getTriangles()[triangles[i]].getVertex(1)].getPos()
-				+ m.getVertices()[m.getTriangles()[triangles[i]].getVertex(2)].getPos())/3;
+		const Vec3Df& p = polygon[j];
+		const Vec3Df& q = polygon[(j+1)%nbVertices];
+		bool pIn = above ? p[axis]>=plane : p[axis]<=plane;
+		bool qIn = above ? q[axis]>=plane : q[axis]<=plane;
+		if(pIn)
+			clipped[nbClipped++]=p;
+		if(pIn!=qIn)
+		{
+			Vec3Df r = p + ((plane-p[axis])/(q[axis]-p[axis]))*(q-p);
+			r[axis]=plane;
+			clipped[nbClipped++]=r;
+		}
 	}
+	std::copy(clipped, clipped+nbClipped, polygon);
+	return nbClipped;
+}
+
+BoundingBox KDTree::polygonBounds(const Vec3Df* polygon, unsigned nbVertices)
+{
+	BoundingBox bounds(polygon[0]);
+	for(unsigned j=1; j<nbVertices; j++)
+		bounds.extendTo(polygon[j]);
+	return bounds;
+}
+
+Vec3Df KDTree::findMedianSample(const vector<BoundingBox>& bounds, const Axis& axis)
+{
+	// Centres des triangles découpés par le noeud, toujours dans sa boîte
+	vector<Vec3Df> barycentres;
+	barycentres.resize(bounds.size());
+	for(unsigned i=0; i<bounds.size(); i++)
+		barycentres[i]=bounds[i].getCenter();
 	quickSort(barycentres, 0, barycentres.size()-1, axis);
 	unsigned k;
 	if(barycentres.size()%2==0)
@@ -113,19 +283,12 @@ Vec3Df KDTree::findMedianSample(const vector<unsigned>& triangles, const Mesh& m
 	return barycentres[k];
 }
 
-Axis KDTree::findMaxAxis(const vector<unsigned>& triangles, const Mesh& m)
+Axis KDTree::findMaxAxis(const BoundingBox& bBox)
 {
-	BoundingBox bbox = BoundingBox (m.getVertices()[m.getTriangles()[triangles[0]].getVertex(0)].getPos ());
-	for (unsigned int i = 1; i < triangles.size (); i++)
-	{
-		for(unsigned j=1; j<3; j++)
-			bbox.extendTo(m.getVertices()[m.getTriangles()[triangles[i]].getVertex(j)].getPos ());
-	}
-
 	Axis maxAxis=X;
-	if(bbox.getMax()[1]-bbox.getMin()[1]>bbox.getMax()[0]-bbox.getMin()[0])
+	if(bBox.getHeight()>bBox.getWidth())
 		maxAxis = Y;
-	if(bbox.getMax()[2]-bbox.getMin()[2]>bbox.getMax()[1]-bbox.getMin()[1])
+	if(bBox.getLength()>std::max(bBox.getWidth(), bBox.getHeight()))
 		maxAxis = Z;
 
 	return maxAxis;
@@ -166,7 +329,16 @@ void KDTree::swap(vector<Vec3Df>& tab, int i, int j)
 	tab[j]=temp;
 }
 
-void KDTree::printTree()
+void KDTree::printTree() const
 {
-	root->print();
+	const KDFlatNode* n = getNodes();
+	const unsigned* t = getTriangles();
+	for(unsigned i=0; i<nbNodes; i++)
+	{
+		if(!n[i].leaf)
+			continue;
+		cout << endl;
+		for(unsigned j=0; j<n[i].nbTriangles; j++)
+			cout << t[n[i].firstTriangle+j] << ", ";
+	}
 }
@@ -2,31 +2,121 @@
 #define KDTREE_H
 
 #include "Node.h"
+#include "RenderMesh.h"
 
 using namespace std;
 
+// Noeud de l'arbre aplati, stocké dans un tableau contigu : les fils d'un
+// noeud interne sont aux indices child et child+1, une feuille référence
+// nbTriangles indices à partir de firstTriangle dans le tableau des triangles.
+struct KDFlatNode
+{
+	BoundingBox bBox;
+	unsigned child;
+	unsigned firstTriangle;
+	unsigned nbTriangles;
+	unsigned leaf;
+};
+
+// Coûts relatifs du parcours d'un noeud et d'un test rayon/triangle, pour
+// l'heuristique des surfaces (SAH)
+static const float KD_TRAVERSAL_COST = 1.0f;
+static const float KD_INTERSECTION_COST = 1.5f;
+
+// Au-delà de ce nombre moyen de feuilles par triangle, le parcours retient
+// les derniers triangles testés pour ne pas les retester (mailboxing)
+static const float KD_MAILBOX_DUPLICATION = 1.2f;
+
+// Profondeur maximale des arbres construits, qui borne la pile du parcours
+// (Ray::intersectObject)
+static const unsigned KD_MAX_DEPTH = 32;
+
+// Paramètres de construction : profondeur maximale, et nombre de triangles
+// sous lequel un noeud devient une feuille. Les valeurs par défaut
+// conviennent aux petits maillages, voir KDTreeTuner pour les autres.
+struct KDBuildParameters
+{
+	KDBuildParameters() : depthMax(7), leafSize(10) {}
+	KDBuildParameters(unsigned d, unsigned l) : depthMax(d), leafSize(l) {}
+	unsigned depthMax;
+	unsigned leafSize;
+};
+
+// L'arbre est construit avec des Node puis aplati. Les tableaux aplatis
+// peuvent appartenir à l'arbre ou être dans une mémoire externe (SharedScene).
 class KDTree
 {
 	public :
 	KDTree();
-	void buildKDTree(const Mesh& m);
-	Node* getRoot() const;
+	// Construit sur le maillage de rendu, celui que lit le parcours (Ray),
+	// avant sa compression
+	void buildKDTree(const RenderMesh& m, const KDBuildParameters& p = KDBuildParameters());
+	// nbMeshTriangles : nombre de triangles du maillage, pour la duplication
+	void attach(const KDFlatNode* nodes, unsigned nbNodes, const unsigned* triangles, unsigned nbTriangles, unsigned nbMeshTriangles);
+
+	inline bool isAttached() const {return extNodes!=NULL;}
+	inline const KDFlatNode* getNodes() const {return isAttached() ? extNodes : (nodes.empty() ? NULL : &nodes[0]);}
+	inline unsigned getNbNodes() const {return nbNodes;}
+	inline const unsigned* getTriangles() const {return isAttached() ? extTriangles : (triangleIndices.empty() ? NULL : &triangleIndices[0]);}
+	inline unsigned getNbTriangles() const {return nbTriangles;}
+	inline KDBuildParameters getParameters() const {return KDBuildParameters(depthMax, leafSize);}
+	inline bool useMailbox() const {return mailbox;}
+
+	// Compression des feuilles, pour un maillage de rendu compressé : les
+	// boîtes sont élargies de margin (l'erreur de quantification des
+	// sommets), les triangles de chaque feuille triés et codés par leurs
+	// différences sur un nombre variable d'octets. firstTriangle devient la
+	// position de la feuille dans getLeafStream, getTriangles retourne NULL.
+	void compress(const Vec3Df& margin);
+	inline bool isCompressed() const {return compressed;}
+	inline const unsigned char* getLeafStream() const {return leafStream.empty() ? NULL : &leafStream[0];}
+	inline unsigned getIndexMemorySize() const {return isCompressed() ? leafStream.size() : nbTriangles*sizeof(unsigned);}
+	// Triangle suivant d'une feuille compressée, à partir du précédent (0
+	// pour le premier)
+	static inline unsigned readTriangle(const unsigned char*& stream, unsigned previous)
+	{
+		unsigned delta = 0;
+		for(unsigned shift=0; ; shift+=7)
+		{
+			unsigned char b = *stream++;
+			delta |= (b & 0x7fu) << shift;
+			if(!(b & 0x80u))
+				return previous+delta;
+		}
+	}
+	void printTree() const;
 
 	private :
 
-	Node* build(const vector<unsigned>& t, const Mesh& m, const BoundingBox & bbToFitIn, unsigned depth);
-	Axis findMaxAxis(const vector<unsigned>& triangles, const Mesh& m);
-	void split(vector<unsigned>& trianglesLeft,vector<unsigned>& trianglesRight,const vector<unsigned>& triangles, const Vec3Df& medianSample, const Axis & maxAxis, const Mesh& m);
+	// bounds[i] : boîte du triangle triangles[i] découpé par bbToFitIn
+	Node* build(const vector<unsigned>& t, const vector<BoundingBox>& bounds, const RenderMesh& m, const BoundingBox & bbToFitIn, unsigned depth);
+	Axis findMaxAxis(const BoundingBox& bBox);
+	void split(vector<unsigned>& trianglesLeft, vector<BoundingBox>& boundsLeft, BoundingBox& bBoxLeft,
+		vector<unsigned>& trianglesRight, vector<BoundingBox>& boundsRight, BoundingBox& bBoxRight,
+		const vector<unsigned>& triangles, const RenderMesh& m, const BoundingBox& bBox, const Axis& axis, float plane);
         void splitBBox(const BoundingBox& bBox, BoundingBox& bBoxRigth, BoundingBox& bBoxLeft, const Axis& axis, const Vec3Df& median);
-	Vec3Df findMedianSample(const vector<unsigned>& triangles, const Mesh& m, const Axis& axis);
+	Vec3Df findMedianSample(const vector<BoundingBox>& bounds, const Axis& axis);
+	// Un triangle découpé par les 6 plans d'une boîte puis par un plan de
+	// coupe garde au plus 3+7 sommets
+	static const unsigned MAX_CLIPPED_VERTICES = 10;
+	static unsigned clipPolygon(Vec3Df* polygon, unsigned nbVertices, unsigned axis, float plane, bool above);
+	static BoundingBox polygonBounds(const Vec3Df* polygon, unsigned nbVertices);
 	void swap(vector<Vec3Df>& tab, int i, int j);
 	void quickSort(vector<Vec3Df>& tab, int left, int right, Axis axis);
 	int partition(vector<Vec3Df>& tab, int left, int right, int pivot, Axis axis);
-	void printTree();
-
+	void flatten(const Node* n, unsigned index);
 
-	Node* root;
 	unsigned depthMax;
+	unsigned leafSize;
+	std::vector<KDFlatNode> nodes;
+	std::vector<unsigned> triangleIndices;
+	std::vector<unsigned char> leafStream;
+	const KDFlatNode* extNodes;
+	const unsigned* extTriangles;
+	unsigned nbNodes;
+	unsigned nbTriangles;
+	bool mailbox;
+	bool compressed;
 };
 #endif
 
@@ -0,0 +1,163 @@
+// *********************************************************
+// KD-Tree Tuner
+// *********************************************************
+
+#include "KDTreeTuner.h"
+#include "Object.h"
+#include "Ray.h"
+#include "Hash.h"
+#include "Trace.h"
+
+#include <cmath>
+#include <cstdio>
+#include <ctime>
+#include <vector>
+#include <algorithm>
+#include <iostream>
+
+using namespace std;
+
+static const unsigned int CACHE_VERSION = 1;
+static const unsigned int MAX_DEPTH = 24;
+
+static unsigned long long now () {
+    timespec ts;
+    clock_gettime (CLOCK_MONOTONIC, &ts);
+    return static_cast<unsigned long long> (ts.tv_sec) * 1000000000ULL + ts.tv_nsec;
+}
+
+// Same sample on every run, unlike rand ().
+static float uniform (unsigned int & state) {
+    state = state * 1664525u + 1013904223u;
+    return (state >> 8) * (1.0f / 16777216.0f);
+}
+
+// Rays from random points of the bounding sphere toward random points of the
+// box: every side of the mesh gets its share.
+static void makeSampleRays (const BoundingBox & bbox, unsigned int nbRays, vector<Ray> & rays) {
+    unsigned int state = 12345;
+    Vec3Df center = bbox.getCenter ();
+    float radius = 2.0f * std::max (bbox.getRadius (), 1e-3f);
+    rays.resize (nbRays);
+    for (unsigned int i = 0; i < nbRays; i++) {
+        Vec3Df d;
+        do
+            d = Vec3Df (2.f * uniform (state) - 1.f, 2.f * uniform (state) - 1.f, 2.f * uniform (state) - 1.f);
+        while (d.getSquaredLength () > 1.f || d.getSquaredLength () < 1e-4f);
+        d.normalize ();
+        Vec3Df origin = center + radius * d;
+        const Vec3Df & a = bbox.getMin ();
+        const Vec3Df & b = bbox.getMax ();
+        Vec3Df target (a[0] + (b[0] - a[0]) * uniform (state),
+                       a[1] + (b[1] - a[1]) * uniform (state),
+                       a[2] + (b[2] - a[2]) * uniform (state));
+        Vec3Df direction = target - origin;
+        direction.normalize ();
+        rays[i] = Ray (origin, direction);
+    }
+}
+
+// Best of a few runs, in nanoseconds per ray.
+static double measure (const Object & o, const vector<Ray> & rays) {
+    unsigned long long best = 0;
+    Vertex v;
+    for (unsigned int r = 0; r < 3; r++) {
+        unsigned long long start = now ();
+        for (unsigned int i = 0; i < rays.size (); i++)
+            rays[i].intersectObject (o, v);
+        unsigned long long elapsed = now () - start;
+        if (r == 0 || elapsed < best)
+            best = elapsed;
+    }
+    return double (best) / rays.size ();
+}
+
+KDBuildParameters KDTreeTuner::tune (const Mesh & mesh, unsigned int nbRays) {
+    TraceScope trace ("KDTreeTuner::tune");
+    unsigned int nbTriangles = mesh.getTriangles ().size ();
+    vector<KDBuildParameters> candidates (1, KDBuildParameters ());
+    const unsigned int leafSizes[] = { 2, 4, 8, 16, 32 };
+    for (unsigned int l = 0; l < 5; l++) {
+        // Depth at which the leaves would hold leafSize triangles without
+        // duplication, then deeper to make up for the straddling ones.
+        unsigned int balanced = 1 + static_cast<unsigned int> (ceil (log (std::max (1.0, double (nbTriangles) / leafSizes[l])) / log (2.0)));
+        for (unsigned int extra = 0; extra <= 4; extra += 2) {
+            KDBuildParameters p (std::min (balanced + extra, MAX_DEPTH), leafSizes[l]);
+            bool known = false;
+            for (unsigned int c = 0; c < candidates.size (); c++)
+                known = known || (candidates[c].depthMax == p.depthMax && candidates[c].leafSize == p.leafSize);
+            if (!known)
+                candidates.push_back (p);
+        }
+    }
+
+    Object o (mesh, Material ());
+    vector<Ray> rays;
+    makeSampleRays (o.getBoundingBox (), nbRays, rays);
+    KDBuildParameters best;
+    double bestCost = 0.0;
+    for (unsigned int c = 0; c < candidates.size (); c++) {
+        o.getKDTree ().buildKDTree (o.getRenderMesh (), candidates[c]);
+        double cost = measure (o, rays);
+        cout << "  depth " << candidates[c].depthMax << ", leaves of " << candidates[c].leafSize
+             << ": " << cost << " ns/ray" << endl;
+        if (c == 0 || cost < bestCost) {
+            best = candidates[c];
+            bestCost = cost;
+        }
+    }
+    cout << "Tuned kd-tree: depth " << best.depthMax << ", leaves of " << best.leafSize << " ("
+         << bestCost << " ns/ray)" << endl;
+    return best;
+}
+
+unsigned long long KDTreeTuner::computeHash (const Mesh & mesh) {
+    Hash h;
+    const vector<Vertex> & V = mesh.getVertices ();
+    const vector<Triangle> & T = mesh.getTriangles ();
+    h.add (static_cast<unsigned int> (V.size ()));
+    for (unsigned int i = 0; i < V.size (); i++)
+        h.add (V[i].getPos ());
+    h.add (static_cast<unsigned int> (T.size ()));
+    for (unsigned int i = 0; i < T.size (); i++)
+        for (unsigned int j = 0; j < 3; j++)
+            h.add (T[i].getVertex (j));
+    return h.get ();
+}
+
+bool KDTreeTuner::load (const string & meshFilename, const Mesh & mesh, KDBuildParameters & parameters) {
+    string filename = meshFilename + ".kdtree";
+    FILE * input = fopen (filename.c_str (), "r");
+    if (input == NULL)
+        return false;
+    unsigned int version, depthMax, leafSize;
+    unsigned long long hash;
+    bool valid = (fscanf (input, "raymini-kdtree %u %llx %u %u", &version, &hash, &depthMax, &leafSize) == 4
+                  && version == CACHE_VERSION && hash == computeHash (mesh)
+                  && depthMax > 0 && depthMax <= MAX_DEPTH);
+    fclose (input);
+    if (valid)
+        parameters = KDBuildParameters (depthMax, leafSize);
+    return valid;
+}
+
+bool KDTreeTuner::save (const string & meshFilename, const Mesh & mesh, const KDBuildParameters & parameters) {
+    string filename = meshFilename + ".kdtree";
+    FILE * output = fopen (filename.c_str (), "w");
+    if (output == NULL)
+        return false;
+    fprintf (output, "raymini-kdtree %u %llx %u %u\n", CACHE_VERSION, computeHash (mesh),
+             parameters.depthMax, parameters.leafSize);
+    return (fclose (output) == 0);
+}
+
+KDBuildParameters KDTreeTuner::get (const string & meshFilename, const Mesh & mesh, bool autoTune) {
+    KDBuildParameters parameters;
+    if (load (meshFilename, mesh, parameters) || !autoTune)
+        return parameters;
+    cout << "Tuning the kd-tree of " << meshFilename << endl;
+    parameters = tune (mesh);
+    if (!save (meshFilename, mesh, parameters))
+        cerr << "Cannot save the kd-tree parameters of " << meshFilename << endl;
+    return parameters;
+}
@@ -0,0 +1,42 @@
+// *********************************************************
+// KD-Tree Tuner
+// Picks the KD-tree build parameters of a mesh by timing the
+// tracing of a sample of rays with a set of candidates, and
+// caches the winner next to the mesh file (<mesh>.kdtree) so
+// that the later runs skip the search.
+// *********************************************************
+
+#ifndef KDTREETUNER_H
+#define KDTREETUNER_H
+
+#include <string>
+
+#include "Mesh.h"
+#include "KDTree.h"
+
+class KDTreeTuner {
+public:
+    // The cached parameters of the mesh loaded from meshFilename if they
+    // are still valid for it; otherwise the result of tune, saved, when
+    // autoTune is set, or the defaults.
+    static KDBuildParameters get (const std::string & meshFilename, const Mesh & mesh, bool autoTune);
+
+    // Candidates sized after the number of triangles, plus the defaults.
+    static KDBuildParameters tune (const Mesh & mesh, unsigned int nbRays = 20000);
+
+    // False when there is no cache, or a cache for other geometry.
+    static bool load (const std::string & meshFilename, const Mesh & mesh, KDBuildParameters & parameters);
+    static bool save (const std::string & meshFilename, const Mesh & mesh, const KDBuildParameters & parameters);
+
+    // Fingerprint of the geometry, to detect an edited mesh.
+    static unsigned long long computeHash (const Mesh & mesh);
+};
+
+#endif // KDTREETUNER_H
+
+// Some Emacs-Hints -- please don't remove:
+//
+//  Local Variables:
+//  mode:C++
+//  tab-width:4
+//  End:
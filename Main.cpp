@@ -7,21 +7,273 @@
 #include <QCleanlooksStyle>
 #include <string>
 #include <iostream>
+#include <cstdio>
+#include <cstdlib>
 
 #include "QTUtils.h"
+#include "RayTracer.h"
+#include "RenderCoordinator.h"
+#include "RenderWorker.h"
+#include "RenderServer.h"
+#include "RenderClient.h"
+#include "Scene.h"
+#include "SceneGenerator.h"
+#include "SceneReport.h"
+#include "SharedScene.h"
+#include "Trace.h"
+#include "RayKernels.h"
 
 using namespace std;
 
+static void usage (const char * name)
+{
+  cerr << "Usage: " << name << " [-shm <name>] [-generate <parameters>] [-autotune] [-checkpoint <file>] [-heatmap <image>] [-trace <file.json>] [-isa <name>] [-compress] [-reorder] [-clean <tolerance>] [-serialload]" << endl
+       << "       " << name << " -coordinator <port> [-workers <n>] [-checkpoint <file>] [frame options]" << endl
+       << "       " << name << " -report [-shm <name>] [-generate <parameters>] [-autotune] [-compress] [-reorder] [-clean <tolerance>] [-serialload]" << endl
+       << "       " << name << " -shmremove <name>" << endl
+       << "       " << name << " -worker <host>:<port>" << endl
+       << "       " << name << " -server <socket>" << endl
+       << "       " << name << " -client <socket> [frame options]" << endl
+       << "-autotune searches the kd-tree build parameters of the meshes without a <mesh>.kdtree cache, and saves them there." << endl
+       << "-report prints the kd-tree quality, the memory used by the scene and its startup time, then exits." << endl
+       << "-trace <file.json> writes a timeline of the run, to open in chrome://tracing or Perfetto." << endl
+       << "-heatmap <image> saves the cost of each pixel of the renders (and <image>.csv, per tile)." << endl
+       << "-shm <name> shares the scene with the other processes using the same name. The segment stays until -shmremove" << endl
+       << "  or a reboot, and is rebuilt by the first process that asks for another scene or other options under that name." << endl
+       << "-isa <scalar|sse4.2|avx2|avx512> forces a variant of the intersection kernel, by default the best one the CPU supports." << endl
+       << "-compress stores the render meshes quantized and the kd-tree leaves delta-coded: less memory, slower renders; not with -shm." << endl
+       << "-reorder sorts the triangles and vertices of the loaded meshes along a space-filling curve, for the caches." << endl
+       << "-clean <tolerance> welds the vertices of the loaded meshes closer than tolerance (0: identical ones) and removes" << endl
+       << "  the degenerate and duplicate triangles, then prints what was removed." << endl
+       << "-serialload loads the files of the default scene one after the other instead of concurrently, to compare." << endl
+       << "-generate <key=value,...> replaces the default scene by a synthetic one, keys:" << endl
+       << "  instances, triangles, meshes, placement (uniform|clustered), clusters, lights, ground, seed" << endl
+       << "Frame options: -size <w>x<h> -view <eye x y z> <target x y z> -rays <n> -shadows <soft|hard|none> -disc <n> -output <image>" << endl;
+}
+
+static bool parseAddress (const string & address, string & host, unsigned short & port)
+{
+  size_t colon = address.rfind (':');
+  if (colon == string::npos)
+    return false;
+  host = address.substr (0, colon);
+  port = static_cast<unsigned short> (atoi (address.c_str () + colon + 1));
+  return (!host.empty () && port != 0);
+}
+
+static bool parseSize (const string & size, unsigned int & width, unsigned int & height)
+{
+  return (sscanf (size.c_str (), "%ux%u", &width, &height) == 2 && width > 0 && height > 0);
+}
+
+static bool isHeadless (int argc, char **argv)
+{
+  for (int i = 1; i < argc; i++) {
+    string arg (argv[i]);
+    if (arg == "-coordinator" || arg == "-worker" || arg == "-server" || arg == "-client"
+        || arg == "-report" || arg == "-shmremove")
+      return true;
+  }
+  return false;
+}
+
+// Before the QApplication, whose construction is traced too.
+static void startTrace (int argc, char **argv)
+{
+  for (int i = 1; i + 1 < argc; i++)
+    if (string (argv[i]) == "-trace")
+      Trace::start (argv[i+1]);
+}
+
 int main (int argc, char **argv)
 {
-  QApplication raymini (argc, argv);
+  bool headless = isHeadless (argc, argv);
+  startTrace (argc, argv);
+  unsigned long long applicationStart = Trace::now ();
+  QApplication raymini (argc, argv, !headless);
+  if (Trace::isEnabled ())
+    Trace::record ("QApplication", "", -1, applicationStart, Trace::now ());
+
+  RayTracer * rayTracer = RayTracer::getInstance ();
+  RenderSettings settings = rayTracer->getSettings ();
+  string workerAddress, serverPath, clientPath, shmRemove, output ("raymini.png");
+  int coordinatorPort = -1;
+  unsigned int nbLocalWorkers = 0, width = 640, height = 480;
+  bool hasView = false, report = false;
+  Vec3Df eye, target;
+  for (int i = 1; i < argc; i++) {
+    string arg (argv[i]);
+    bool hasValue = (i + 1 < argc);
+    if (arg == "-trace" && hasValue)
+      i++;
+    else if (arg == "-report")
+      report = true;
+    else if (arg == "-autotune")
+      Scene::setAutoTune (true);
+    else if (arg == "-compress")
+      Scene::setCompressGeometry (true);
+    else if (arg == "-reorder")
+      Scene::setReorderMeshes (true);
+    else if (arg == "-clean" && hasValue && atof (argv[i+1]) >= 0.0)
+      Scene::setCleanTolerance (atof (argv[++i]));
+    else if (arg == "-serialload")
+      Scene::setParallelLoading (false);
+    else if (arg == "-isa" && hasValue) {
+      RayKernels::Isa isa;
+      if (!RayKernels::parse (argv[++i], isa) || !RayKernels::setIsa (isa)) {
+        cerr << argv[i] << " is not a variant this CPU supports." << endl;
+        usage (argv[0]);
+        return 1;
+      }
+    }
+    else if (arg == "-shm" && hasValue)
+      Scene::setSharedMemoryName (argv[++i]);
+    else if (arg == "-shmremove" && hasValue)
+      shmRemove = argv[++i];
+    else if (arg == "-generate" && hasValue) {
+      SceneGenerator::Parameters parameters;
+      try {
+        parameters.parse (argv[++i]);
+      } catch (const SceneGenerator::Exception & e) {
+        cerr << e.getMessage () << endl;
+        usage (argv[0]);
+        return 1;
+      }
+      Scene::setGeneratorSpec (parameters.toString ());
+    }
+    else if (arg == "-heatmap" && hasValue)
+      rayTracer->setHeatmapFilename (argv[++i]);
+    else if (arg == "-checkpoint" && hasValue)
+      rayTracer->setCheckpointFilename (argv[++i]);
+    else if (arg == "-coordinator" && hasValue)
+      coordinatorPort = atoi (argv[++i]);
+    else if (arg == "-workers" && hasValue)
+      nbLocalWorkers = atoi (argv[++i]);
+    else if (arg == "-worker" && hasValue)
+      workerAddress = argv[++i];
+    else if (arg == "-size" && hasValue && parseSize (argv[i+1], width, height))
+      i++;
+    else if (arg == "-output" && hasValue)
+      output = argv[++i];
+    else if (arg == "-server" && hasValue)
+      serverPath = argv[++i];
+    else if (arg == "-client" && hasValue)
+      clientPath = argv[++i];
+    else if (arg == "-view" && i + 6 < argc) {
+      for (unsigned int k = 0; k < 3; k++)
+        eye[k] = atof (argv[i+1+k]);
+      for (unsigned int k = 0; k < 3; k++)
+        target[k] = atof (argv[i+4+k]);
+      hasView = true;
+      i += 6;
+    }
+    else if (arg == "-rays" && hasValue && atoi (argv[i+1]) > 0)
+      settings.nbRaysPerPixel = atoi (argv[++i]);
+    else if (arg == "-disc" && hasValue && atoi (argv[i+1]) > 0)
+      settings.nbPointsDisc = atoi (argv[++i]);
+    else if (arg == "-shadows" && hasValue) {
+      string mode (argv[++i]);
+      settings.softShadows = (mode == "soft");
+      settings.hardShadows = (mode == "hard");
+      if (mode != "soft" && mode != "hard" && mode != "none") {
+        usage (argv[0]);
+        return 1;
+      }
+    }
+    else {
+      usage (argv[0]);
+      return 1;
+    }
+  }
+  if (Scene::getCompressGeometry () && !Scene::getSharedMemoryName ().empty ())
+    cerr << "-compress is ignored with -shm: the shared scene holds plain arrays." << endl;
+  rayTracer->setSettings (settings);
+  RenderCamera camera;
+  if (hasView)
+    camera = RenderCamera::lookAt (eye, target, Vec3Df (0.0f, 0.0f, 1.0f),
+                                   static_cast<float> (M_PI) / 4.0f, width, height);
+  else {
+    camera.screenWidth = width;
+    camera.screenHeight = height;
+  }
+
+  if (!shmRemove.empty ()) {
+    if (SharedScene::remove (shmRemove))
+      return 0;
+    cerr << "There is no shared scene " << shmRemove << "." << endl;
+    return 1;
+  }
+
+  if (report) {
+    cout << SceneReport::get (*Scene::getInstance ());
+    return 0;
+  }
+
+  if (!workerAddress.empty ()) {
+    string host;
+    unsigned short port;
+    if (!parseAddress (workerAddress, host, port)) {
+      usage (argv[0]);
+      return 1;
+    }
+    RenderWorker worker;
+    return (worker.run (host, port) ? 0 : 1);
+  }
+
+  if (coordinatorPort >= 0) {
+    try {
+      Scene * scene = Scene::getInstance ();
+      RenderCoordinator coordinator (static_cast<unsigned short> (coordinatorPort));
+      coordinator.setCheckpointFilename (rayTracer->getCheckpointFilename ());
+      coordinator.spawnLocalWorkers (nbLocalWorkers);
+      if (!hasView)
+        camera = RenderCamera::fitBoundingBox (scene->getBoundingBox (), width, height);
+      QImage image = coordinator.render (camera);
+      TraceScope trace ("QImage::save", output);
+      if (!image.save (QString (output.c_str ()))) {
+        cerr << "Cannot save " << output << endl;
+        return 1;
+      }
+      cout << "Image saved to " << output << endl;
+    } catch (const Socket::Exception & e) {
+      cerr << e.getMessage () << endl;
+      return 1;
+    }
+    return 0;
+  }
+
+  if (!serverPath.empty ()) {
+    RenderServer server;
+    return (server.run (serverPath) ? 0 : 1);
+  }
+
+  if (!clientPath.empty ()) {
+    try {
+      RenderClient client (clientPath);
+      unsigned int renderTime;
+      QImage image = client.render (camera, settings, rayTracer->getBackgroundColor (), !hasView, renderTime);
+      cout << "Rendered in " << renderTime << "ms by the server" << endl;
+      TraceScope trace ("QImage::save", output);
+      if (!image.save (QString (output.c_str ()))) {
+        cerr << "Cannot save " << output << endl;
+        return 1;
+      }
+    } catch (const Socket::Exception & e) {
+      cerr << e.getMessage () << endl;
+      return 1;
+    } catch (const Message::Exception & e) {
+      cerr << e.getMessage () << endl;
+      return 1;
+    }
+    return 0;
+  }
+
   setBoubekQTStyle (raymini);
   QApplication::setStyle (new QPlastiqueStyle);
   Window * window = new Window ();
   window->setWindowTitle ("RayMini: A minimal raytracer.");
   window->show();
   raymini.connect (&raymini, SIGNAL (lastWindowClosed()), &raymini, SLOT (quit()));
-  
+
   return raymini.exec ();
 }
-
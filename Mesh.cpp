@@ -6,7 +6,12 @@
 // ---------------------------------------------------------
 
 #include "Mesh.h"
+#include "MeshAdjacency.h"
+#include "ThreadPool.h"
+#include "Trace.h"
 #include <algorithm>
+#include <cmath>
+#include <cstring>
 #include <iostream>
 #include <fstream>
 #include <sstream>
@@ -32,57 +37,129 @@ void Mesh::unmarkAllVertices () {
         vertices[i].unmark ();
 }
 
-void Mesh::computeTriangleNormals (vector<Vec3Df> & triangleNormals) {
-    for (vector<Triangle>::const_iterator it = triangles.begin ();
-         it != triangles.end ();
-         it++) {
-        Vec3Df e01 (vertices[it->getVertex (1)].getPos () - vertices[it->getVertex (0)].getPos ());
-        Vec3Df e02 (vertices[it->getVertex (2)].getPos () - vertices[it->getVertex (0)].getPos ());
-        Vec3Df n (Vec3Df::crossProduct (e01, e02));
-        n.normalize ();
-        triangleNormals.push_back (n);
+namespace {
+
+// Normals of the triangles of a range.
+class TriangleNormals : public ThreadPool::Range {
+public:
+    TriangleNormals (const vector<Vertex> & vertices, const vector<Triangle> & triangles, Vec3Df * normals)
+        : vertices (vertices), triangles (triangles), normals (normals) {}
+    void run (unsigned int begin, unsigned int end) {
+        for (unsigned int i = begin; i < end; i++) {
+            const Triangle & t = triangles[i];
+            Vec3Df e01 (vertices[t.getVertex (1)].getPos () - vertices[t.getVertex (0)].getPos ());
+            Vec3Df e02 (vertices[t.getVertex (2)].getPos () - vertices[t.getVertex (0)].getPos ());
+            Vec3Df n (Vec3Df::crossProduct (e01, e02));
+            n.normalize ();
+            normals[i] = n;
+        }
+    }
+private:
+    const vector<Vertex> & vertices;
+    const vector<Triangle> & triangles;
+    Vec3Df * normals;
+};
+
+// Weight of the normal of triangle t at its corner j.
+inline float cornerWeight (const vector<Vertex> & vertices, const Triangle & t, unsigned int j, unsigned int normWeight) {
+    const Vertex & vj = vertices[t.getVertex (j)];
+    float w = 1.0; // uniform weights
+    Vec3Df e0 = vertices[t.getVertex ((j+1)%3)].getPos () - vj.getPos ();
+    Vec3Df e1 = vertices[t.getVertex ((j+2)%3)].getPos () - vj.getPos ();
+    if (normWeight == 1) { // area weight
+        w = Vec3Df::crossProduct (e0, e1).getLength () / 2.0;
+    } else if (normWeight == 2) { // angle weight
+        e0.normalize ();
+        e1.normalize ();
+        w = (2.0 - (Vec3Df::dotProduct (e0, e1) + 1.0)) / 2.0;
     }
+    return w;
+}
+
+// Smooth normals of the vertices of a range: the weighted normals of their
+// triangles, summed by increasing triangle as the serial loop does, hence
+// the same normals whatever the number of threads.
+class VertexNormals : public ThreadPool::Range {
+public:
+    VertexNormals (vector<Vertex> & vertices, const vector<Triangle> & triangles,
+                   const MeshAdjacency & adjacency, const vector<Vec3Df> & triangleNormals, unsigned int normWeight)
+        : vertices (vertices), triangles (triangles), adjacency (adjacency),
+          triangleNormals (triangleNormals), normWeight (normWeight) {}
+    void run (unsigned int begin, unsigned int end) {
+        for (unsigned int v = begin; v < end; v++) {
+            Vec3Df normal (0.0, 0.0, 0.0);
+            const unsigned int * corners = adjacency.getCorners (v);
+            for (unsigned int c = 0; c < adjacency.getNbCorners (v); c++) {
+                float w = cornerWeight (vertices, triangles[corners[c] / 3], corners[c] % 3, normWeight);
+                if (w <= 0.0)
+                    continue;
+                normal = normal + triangleNormals[corners[c] / 3] * w;
+            }
+            if (normal != Vec3Df (0.0, 0.0, 0.0))
+                normal.normalize ();
+            vertices[v].setNormal (normal);
+        }
+    }
+private:
+    vector<Vertex> & vertices;
+    const vector<Triangle> & triangles;
+    const MeshAdjacency & adjacency;
+    const vector<Vec3Df> & triangleNormals;
+    unsigned int normWeight;
+};
+
+const unsigned int NORMALS_GRAIN = 4096;
+
+} // namespace
+
+void Mesh::computeTriangleNormals (vector<Vec3Df> & triangleNormals) {
+    unsigned int first = triangleNormals.size ();
+    triangleNormals.resize (first + triangles.size ());
+    if (triangles.empty ())
+        return;
+    TriangleNormals range (vertices, triangles, &triangleNormals[first]);
+    ThreadPool::getInstance ().parallelFor (range, triangles.size (), NORMALS_GRAIN);
 }
 
 void Mesh::recomputeSmoothVertexNormals (unsigned int normWeight) {
+    TraceScope trace ("Mesh::recomputeSmoothVertexNormals");
     vector<Vec3Df> triangleNormals;
     computeTriangleNormals (triangleNormals);
+    ThreadPool & pool = ThreadPool::getInstance ();
+    if (pool.getNbThreads () > 1 && vertices.size () > NORMALS_GRAIN) {
+        MeshAdjacency adjacency (vertices.size (), triangles);
+        VertexNormals range (vertices, triangles, adjacency, triangleNormals, normWeight);
+        pool.parallelFor (range, vertices.size (), NORMALS_GRAIN);
+        return;
+    }
+    // On one thread, the triangles are added to their vertices directly,
+    // without the adjacency: same sums in the same order.
     for (std::vector<Vertex>::iterator it = vertices.begin (); it != vertices.end (); it++)
         it->setNormal (Vec3Df (0.0, 0.0, 0.0));
-    vector<Vec3Df>::const_iterator itNormal = triangleNormals.begin ();
-    vector<Triangle>::const_iterator it = triangles.begin ();
-    for ( ; it != triangles.end (); it++, itNormal++) 
-        for (unsigned int  j = 0; j < 3; j++) {
-            Vertex & vj = vertices[it->getVertex (j)];
-            float w = 1.0; // uniform weights
-            Vec3Df e0 = vertices[it->getVertex ((j+1)%3)].getPos () - vj.getPos ();
-            Vec3Df e1 = vertices[it->getVertex ((j+2)%3)].getPos () - vj.getPos ();
-            if (normWeight == 1) { // area weight
-                w = Vec3Df::crossProduct (e0, e1).getLength () / 2.0;
-            } else if (normWeight == 2) { // angle weight
-                e0.normalize ();
-                e1.normalize ();
-                w = (2.0 - (Vec3Df::dotProduct (e0, e1) + 1.0)) / 2.0;
-            } 
+    for (unsigned int t = 0; t < triangles.size (); t++)
+        for (unsigned int j = 0; j < 3; j++) {
+            float w = cornerWeight (vertices, triangles[t], j, normWeight);
             if (w <= 0.0)
                 continue;
-            vj.setNormal (vj.getNormal () + (*itNormal) * w);
+            Vertex & vj = vertices[triangles[t].getVertex (j)];
+            vj.setNormal (vj.getNormal () + triangleNormals[t] * w);
         }
     Vertex::normalizeNormals (vertices);
 }
 
 void Mesh::collectOneRing (vector<vector<unsigned int> > & oneRing) const {
+    MeshAdjacency adjacency (vertices.size (), triangles);
+    adjacency.computeOneRings ();
     oneRing.resize (vertices.size ());
-    for (unsigned int i = 0; i < triangles.size (); i++) {
-        const Triangle & ti = triangles[i];
-        for (unsigned int j = 0; j < 3; j++) {
-            unsigned int vj = ti.getVertex (j);
-            for (unsigned int k = 1; k < 3; k++) {
-                unsigned int vk = ti.getVertex ((j+k)%3);
-                if (find (oneRing[vj].begin (), oneRing[vj].end (), vk) == oneRing[vj].end ())
-                    oneRing[vj].push_back (vk);
-            }
-        }
+    for (unsigned int v = 0; v < vertices.size (); v++) {
+        vector<unsigned int> & ring = oneRing[v];
+        const unsigned int * neighbors = adjacency.getNeighbors (v);
+        if (ring.empty ())
+            ring.assign (neighbors, neighbors + adjacency.getNbNeighbors (v));
+        else
+            for (unsigned int n = 0; n < adjacency.getNbNeighbors (v); n++)
+                if (find (ring.begin (), ring.end (), neighbors[n]) == ring.end ())
+                    ring.push_back (neighbors[n]);
     }
 }
 
@@ -114,31 +191,34 @@ void Mesh::collectOrderedOneRing (vector<vector<unsigned int> > & oneRing) const
     }
 }
 
+// The edges come in the order of the maps: each one is inserted at the end
+// in constant time when the maps start empty.
 void Mesh::computeDualEdgeMap (EdgeMapIndex & dualVMap1, EdgeMapIndex & dualVMap2) {
-    for (vector<Triangle>::iterator it = triangles.begin ();
-         it != triangles.end (); it++) {
-        for (unsigned int i = 0; i < 3; i++) {
-            Edge eij (it->getVertex (i), it->getVertex ((i+1)%3)); 
-            if (dualVMap1.find (eij) == dualVMap1.end ())
-                dualVMap1[eij] = it->getVertex ((i+2)%3);
-            else
-                dualVMap2[eij] = it->getVertex ((i+2)%3);
-        }
-    } 
+    MeshAdjacency adjacency (vertices.size (), triangles);
+    adjacency.computeEdges ();
+    const vector<MeshAdjacency::EdgeUse> & edges = adjacency.getEdges ();
+    for (unsigned int i = 0; i < edges.size (); i++) {
+        const MeshAdjacency::EdgeUse & e = edges[i];
+        Edge eij (e.v[0], e.v[1]);
+        unsigned int size = dualVMap1.size ();
+        dualVMap1.insert (dualVMap1.end (), make_pair (eij, e.firstOpposite));
+        // The first use went to dualVMap2 too if the edge was already known.
+        if (dualVMap1.size () == size || e.nbUses > 1)
+            dualVMap2.insert (dualVMap2.end (), make_pair (eij, 0u))->second = e.lastOpposite;
+    }
 }
 
 void Mesh::markBorderEdges (EdgeMapIndex & edgeMap) {
-    for (vector<Triangle>::iterator it = triangles.begin ();
-         it != triangles.end (); it++) {
-        for (unsigned int i = 0; i < 3; i++) {
-            unsigned int j = (i+1)%3;
-            Edge eij (it->getVertex (i), it->getVertex (j)); 
-            if (edgeMap.find (eij) == edgeMap.end ())
-                edgeMap[eij] = 0;
-            else 
-                edgeMap[eij] += 1;
-        }
-    } 
+    MeshAdjacency adjacency (vertices.size (), triangles);
+    adjacency.computeEdges ();
+    const vector<MeshAdjacency::EdgeUse> & edges = adjacency.getEdges ();
+    for (unsigned int i = 0; i < edges.size (); i++) {
+        const MeshAdjacency::EdgeUse & e = edges[i];
+        unsigned int size = edgeMap.size ();
+        EdgeMapIndex::iterator it = edgeMap.insert (edgeMap.end (), make_pair (Edge (e.v[0], e.v[1]), e.nbUses - 1));
+        if (edgeMap.size () == size)
+            it->second += e.nbUses;
+    }
 }
 
 inline void glVertexVec3Df (const Vec3Df & v) {
@@ -181,6 +261,7 @@ void Mesh::renderGL (bool flat) const {
 }
 
 void Mesh::loadOFF (const std::string & filename) {
+    TraceScope trace ("Mesh::loadOFF", filename);
     clear ();
     ifstream input (filename.c_str ());
     if (!input)
@@ -210,3 +291,270 @@ void Mesh::loadOFF (const std::string & filename) {
     recomputeSmoothVertexNormals (0);
     
 }
+
+// 10 bits of x, spread to every third bit.
+static inline unsigned int spreadBits (unsigned int x) {
+    x &= 0x3ff;
+    x = (x | (x << 16)) & 0x030000ff;
+    x = (x | (x << 8)) & 0x0300f00f;
+    x = (x | (x << 4)) & 0x030c30c3;
+    x = (x | (x << 2)) & 0x09249249;
+    return x;
+}
+
+void Mesh::reorderForLocality () {
+    TraceScope trace ("Mesh::reorderForLocality");
+    if (triangles.empty ())
+        return;
+    Vec3Df minBb = vertices[0].getPos (), maxBb = minBb;
+    for (unsigned int i = 1; i < vertices.size (); i++)
+        for (unsigned int a = 0; a < 3; a++) {
+            minBb[a] = min (minBb[a], vertices[i].getPos ()[a]);
+            maxBb[a] = max (maxBb[a], vertices[i].getPos ()[a]);
+        }
+    Vec3Df scale;
+    for (unsigned int a = 0; a < 3; a++)
+        scale[a] = (maxBb[a] > minBb[a]) ? 1023.0f / (maxBb[a] - minBb[a]) : 0.0f;
+
+    // Morton code of the centroid on a 1024^3 grid over the mesh; ties keep
+    // the file order.
+    vector<pair<unsigned int, unsigned int> > keys (triangles.size ());
+    for (unsigned int i = 0; i < triangles.size (); i++) {
+        const Triangle & t = triangles[i];
+        Vec3Df c = (vertices[t.getVertex (0)].getPos () + vertices[t.getVertex (1)].getPos ()
+                    + vertices[t.getVertex (2)].getPos ()) / 3.0f;
+        unsigned int code = 0;
+        for (unsigned int a = 0; a < 3; a++)
+            code |= spreadBits (static_cast<unsigned int> ((c[a] - minBb[a]) * scale[a] + 0.5f)) << a;
+        keys[i] = make_pair (code, i);
+    }
+    sort (keys.begin (), keys.end ());
+
+    // New index of each vertex, by first use; the unused ones go last.
+    const unsigned int unused = ~0u;
+    vector<unsigned int> newIndex (vertices.size (), unused);
+    vector<Vertex> newVertices;
+    newVertices.reserve (vertices.size ());
+    vector<Triangle> newTriangles (triangles.size ());
+    for (unsigned int i = 0; i < keys.size (); i++) {
+        const Triangle & t = triangles[keys[i].second];
+        for (unsigned int j = 0; j < 3; j++) {
+            unsigned int v = t.getVertex (j);
+            if (newIndex[v] == unused) {
+                newIndex[v] = newVertices.size ();
+                newVertices.push_back (vertices[v]);
+            }
+            newTriangles[i].setVertex (j, newIndex[v]);
+        }
+    }
+    for (unsigned int v = 0; v < vertices.size (); v++)
+        if (newIndex[v] == unused)
+            newVertices.push_back (vertices[v]);
+    vertices.swap (newVertices);
+    triangles.swap (newTriangles);
+}
+
+namespace {
+
+const unsigned int NO_INDEX = ~0u;
+
+inline unsigned long long mixBits (unsigned long long k) {
+    k ^= k >> 33;
+    k *= 0xff51afd7ed558ccdULL;
+    k ^= k >> 33;
+    k *= 0xc4ceb9fe1a85ec53ULL;
+    k ^= k >> 33;
+    return k;
+}
+
+// Head of the chains of indices of the cleanup, by 64-bit key: open
+// addressing, sized once for at most nbKeys keys. The chains themselves
+// are kept by the caller.
+class ChainTable {
+public:
+    ChainTable (unsigned int nbKeys) {
+        unsigned int size = 16;
+        while (size < 2 * nbKeys)
+            size *= 2;
+        Slot empty = { 0, NO_INDEX };
+        slots.resize (size, empty);
+        mask = size - 1;
+    }
+    // NO_INDEX if the key has no chain.
+    unsigned int find (unsigned long long key) const {
+        for (unsigned int i = mixBits (key) & mask; slots[i].head != NO_INDEX; i = (i + 1) & mask)
+            if (slots[i].key == key)
+                return slots[i].head;
+        return NO_INDEX;
+    }
+    // Head of the chain of key, to be set right away if the key is new.
+    unsigned int & insert (unsigned long long key) {
+        unsigned int i = mixBits (key) & mask;
+        for ( ; slots[i].head != NO_INDEX; i = (i + 1) & mask)
+            if (slots[i].key == key)
+                return slots[i].head;
+        slots[i].key = key;
+        return slots[i].head;
+    }
+private:
+    // Key and head together: one cache miss per probe.
+    struct Slot {
+        unsigned long long key;
+        unsigned int head;
+    };
+    std::vector<Slot> slots;
+    unsigned int mask;
+};
+
+inline unsigned long long combineKeys (unsigned long long a, unsigned long long b, unsigned long long c) {
+    return mixBits (a) ^ (mixBits (b) * 3) ^ (mixBits (c) * 5);
+}
+
+// Welding grid cell of x, or the bits of x itself for exact welding (-0
+// and 0 alike).
+inline long long weldCell (float x, float inverseCellSize) {
+    if (inverseCellSize == 0.0f) {
+        float y = x + 0.0f;
+        unsigned int bits;
+        memcpy (&bits, &y, sizeof (bits));
+        return bits;
+    }
+    const double limit = 4e18;
+    double c = floor (double (x) * inverseCellSize);
+    if (!(c > -limit))
+        c = -limit;
+    else if (c > limit)
+        c = limit;
+    return static_cast<long long> (c);
+}
+
+} // namespace
+
+ostream & operator<< (ostream & output, const Mesh::CleanReport & r) {
+    return output << r.nbWeldedVertices << " vertices welded, " << r.nbUnusedVertices << " unused, "
+                  << r.nbDegenerateTriangles << " degenerate and " << r.nbDuplicateTriangles
+                  << " duplicate triangles removed";
+}
+
+Mesh::CleanReport Mesh::clean (float weldTolerance) {
+    TraceScope trace ("Mesh::clean");
+    CleanReport report;
+    const unsigned int nbVertices = vertices.size ();
+    const bool exact = !(weldTolerance > 0.0f);
+    const float tolerance = exact ? 0.0f : weldTolerance;
+    // Cells twice the tolerance wide: the vertices within the tolerance of
+    // a position are in at most 2 cells per axis.
+    const float inverseCellSize = exact ? 0.0f : 0.5f / tolerance;
+
+    // Each vertex is welded into the nearest kept vertex within the
+    // tolerance; otherwise it is kept and chained in its cell.
+    vector<unsigned int> weld (nbVertices);
+    vector<unsigned int> nextInCell (nbVertices, NO_INDEX);
+    ChainTable cells (nbVertices);
+    for (unsigned int v = 0; v < nbVertices; v++) {
+        const Vec3Df & p = vertices[v].getPos ();
+        long long low[3], high[3];
+        for (unsigned int a = 0; a < 3; a++) {
+            low[a] = weldCell (p[a] - tolerance, inverseCellSize);
+            high[a] = weldCell (p[a] + tolerance, inverseCellSize);
+        }
+        unsigned int nearest = NO_INDEX;
+        float nearestDistance = tolerance * tolerance;
+        for (long long x = low[0]; x <= high[0]; x++)
+            for (long long y = low[1]; y <= high[1]; y++)
+                for (long long z = low[2]; z <= high[2]; z++)
+                    for (unsigned int u = cells.find (combineKeys (x, y, z));
+                         u != NO_INDEX; u = nextInCell[u]) {
+                        const Vec3Df & q = vertices[u].getPos ();
+                        if (exact) {
+                            if (q == p) {
+                                nearest = u;
+                                break;
+                            }
+                            continue;
+                        }
+                        float d = Vec3Df::squaredDistance (p, q);
+                        if (d < nearestDistance || (d == nearestDistance && (nearest == NO_INDEX || u < nearest))) {
+                            nearest = u;
+                            nearestDistance = d;
+                        }
+                    }
+        if (nearest != NO_INDEX) {
+            weld[v] = nearest;
+            report.nbWeldedVertices++;
+        } else {
+            weld[v] = v;
+            unsigned int & head = cells.insert (combineKeys (weldCell (p[0], inverseCellSize),
+                                                             weldCell (p[1], inverseCellSize),
+                                                             weldCell (p[2], inverseCellSize)));
+            nextInCell[v] = head;
+            head = v;
+        }
+    }
+
+    // Triangles on the welded vertices, less the degenerate ones and the
+    // duplicates, found by their sorted vertices.
+    vector<Triangle> kept;
+    kept.reserve (triangles.size ());
+    vector<unsigned int> nextFace;
+    nextFace.reserve (triangles.size ());
+    ChainTable faces (triangles.size ());
+    for (unsigned int i = 0; i < triangles.size (); i++) {
+        unsigned int v[3];
+        for (unsigned int j = 0; j < 3; j++)
+            v[j] = weld[triangles[i].getVertex (j)];
+        if (v[0] == v[1] || v[1] == v[2] || v[2] == v[0]) {
+            report.nbDegenerateTriangles++;
+            continue;
+        }
+        // Height over the longest edge: twice the area over its length.
+        const Vec3Df & p0 = vertices[v[0]].getPos ();
+        const Vec3Df & p1 = vertices[v[1]].getPos ();
+        const Vec3Df & p2 = vertices[v[2]].getPos ();
+        float doubleArea = Vec3Df::crossProduct (p1 - p0, p2 - p0).getLength ();
+        float longest = sqrt (max (Vec3Df::squaredDistance (p0, p1),
+                                   max (Vec3Df::squaredDistance (p1, p2), Vec3Df::squaredDistance (p2, p0))));
+        if (!(doubleArea > tolerance * longest)) {
+            report.nbDegenerateTriangles++;
+            continue;
+        }
+        unsigned int s[3] = { v[0], v[1], v[2] };
+        sort (s, s + 3);
+        unsigned long long key = combineKeys (s[0], s[1], s[2]);
+        bool duplicate = false;
+        for (unsigned int f = faces.find (key); f != NO_INDEX && !duplicate; f = nextFace[f]) {
+            unsigned int t[3] = { kept[f].getVertex (0), kept[f].getVertex (1), kept[f].getVertex (2) };
+            sort (t, t + 3);
+            duplicate = (s[0] == t[0] && s[1] == t[1] && s[2] == t[2]);
+        }
+        if (duplicate) {
+            report.nbDuplicateTriangles++;
+            continue;
+        }
+        unsigned int & head = faces.insert (key);
+        nextFace.push_back (head);
+        head = kept.size ();
+        kept.push_back (Triangle (v[0], v[1], v[2]));
+    }
+
+    // Compaction of the vertices still used, in their order.
+    vector<unsigned int> newIndex (nbVertices, NO_INDEX);
+    for (unsigned int i = 0; i < kept.size (); i++)
+        for (unsigned int j = 0; j < 3; j++)
+            newIndex[kept[i].getVertex (j)] = 0;
+    vector<Vertex> newVertices;
+    newVertices.reserve (nbVertices - report.nbWeldedVertices);
+    for (unsigned int v = 0; v < nbVertices; v++) {
+        if (newIndex[v] != NO_INDEX) {
+            newIndex[v] = newVertices.size ();
+            newVertices.push_back (vertices[v]);
+        } else if (weld[v] == v)
+            report.nbUnusedVertices++;
+    }
+    for (unsigned int i = 0; i < kept.size (); i++)
+        for (unsigned int j = 0; j < 3; j++)
+            kept[i].setVertex (j, newIndex[kept[i].getVertex (j)]);
+    vertices.swap (newVertices);
+    triangles.swap (kept);
+    return report;
+}
@@ -26,6 +26,11 @@ public:
     inline Mesh (const Mesh & mesh) 
         : vertices (mesh.vertices), 
           triangles (mesh.triangles) {}
+    inline Mesh & operator= (const Mesh & mesh) {
+        vertices = mesh.vertices;
+        triangles = mesh.triangles;
+        return *this;
+    }
         
     inline virtual ~Mesh () {}
     std::vector<Vertex> & getVertices () { return vertices; }
@@ -36,16 +41,44 @@ public:
     void clearGeometry ();
     void clearTopology ();
     void unmarkAllVertices ();
+    // On the ThreadPool, with the same result as on a single thread.
     void recomputeSmoothVertexNormals (unsigned int weight);
     void computeTriangleNormals (std::vector<Vec3Df> & triangleNormals);  
-    void collectOneRing (std::vector<std::vector<unsigned int> > & oneRing) const;
     void collectOrderedOneRing (std::vector<std::vector<unsigned int> > & oneRing) const;
+    // These three build a MeshAdjacency, in linear time.
+    void collectOneRing (std::vector<std::vector<unsigned int> > & oneRing) const;
     void computeDualEdgeMap (EdgeMapIndex & dualVMap1, EdgeMapIndex & dualVMap2);
     void markBorderEdges (EdgeMapIndex & edgeMap);
     
     void renderGL (bool flat) const;
     
     void loadOFF (const std::string & filename);
+
+    // Sorts the triangles along a Morton curve of their centroids, then
+    // renumbers the vertices in the order the triangles first use them:
+    // triangles close in space become close in memory, and so do the
+    // vertices they share. Same surface, same connectivity.
+    void reorderForLocality ();
+
+    // What clean removed.
+    struct CleanReport {
+        unsigned int nbWeldedVertices;       // merged into an earlier vertex
+        unsigned int nbUnusedVertices;       // used by no remaining triangle
+        unsigned int nbDegenerateTriangles;  // thinner than the tolerance
+        unsigned int nbDuplicateTriangles;   // same vertices as an earlier one
+        CleanReport ()
+            : nbWeldedVertices (0), nbUnusedVertices (0),
+              nbDegenerateTriangles (0), nbDuplicateTriangles (0) {}
+    };
+
+    // Import cleanup, in expected linear time (hash tables, no sort):
+    // welds each vertex into the nearest earlier one within weldTolerance
+    // (0: identical positions only), removes the triangles whose height is
+    // below it and those with the same vertices as an earlier one, whatever
+    // their winding, then drops the unused vertices. The vertices and
+    // triangles left keep their order and the vertices their normal:
+    // recompute the normals after.
+    CleanReport clean (float weldTolerance);
   
     class Exception {
     private: 
@@ -61,6 +94,8 @@ private:
     std::vector<Triangle> triangles;
 };
 
+extern std::ostream & operator<< (std::ostream & output, const Mesh::CleanReport & r);
+
 #endif // MESH_H
 
 // Some Emacs-Hints -- please don't remove:
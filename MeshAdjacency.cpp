@@ -0,0 +1,102 @@
+// *********************************************************
+// Mesh Adjacency
+// *********************************************************
+
+#include "MeshAdjacency.h"
+
+#include <algorithm>
+
+using namespace std;
+
+static const unsigned int NO_VERTEX = ~0u;
+
+MeshAdjacency::MeshAdjacency (unsigned int nbVertices, const vector<Triangle> & triangles)
+    : triangles (triangles), cornerOffsets (nbVertices + 1, 0) {
+    // Counting sort of the corners by vertex, stable: by triangle for each.
+    for (unsigned int t = 0; t < triangles.size (); t++)
+        for (unsigned int j = 0; j < 3; j++)
+            cornerOffsets[triangles[t].getVertex (j) + 1]++;
+    for (unsigned int v = 0; v < nbVertices; v++)
+        cornerOffsets[v + 1] += cornerOffsets[v];
+    corners.resize (3 * triangles.size ());
+    vector<unsigned int> next (cornerOffsets.begin (), cornerOffsets.end () - 1);
+    for (unsigned int t = 0; t < triangles.size (); t++)
+        for (unsigned int j = 0; j < 3; j++)
+            corners[next[triangles[t].getVertex (j)]++] = 3 * t + j;
+}
+
+void MeshAdjacency::computeOneRings () {
+    // The other two vertices of each corner, less those already listed:
+    // counted, then written.
+    unsigned int nbVertices = getNbVertices ();
+    vector<unsigned int> listedBy (nbVertices, NO_VERTEX);
+    neighborOffsets.assign (nbVertices + 1, 0);
+    for (unsigned int pass = 0; pass < 2; pass++) {
+        if (pass == 1) {
+            neighbors.resize (neighborOffsets[nbVertices]);
+            listedBy.assign (nbVertices, NO_VERTEX);
+        }
+        for (unsigned int v = 0; v < nbVertices; v++) {
+            unsigned int n = neighborOffsets[v];
+            for (unsigned int c = cornerOffsets[v]; c < cornerOffsets[v + 1]; c++) {
+                const Triangle & t = triangles[corners[c] / 3];
+                unsigned int j = corners[c] % 3;
+                for (unsigned int k = 1; k < 3; k++) {
+                    unsigned int u = t.getVertex ((j + k) % 3);
+                    if (listedBy[u] == v)
+                        continue;
+                    listedBy[u] = v;
+                    if (pass == 1)
+                        neighbors[n] = u;
+                    n++;
+                }
+            }
+            if (pass == 0)
+                neighborOffsets[v + 1] = n;
+        }
+    }
+}
+
+static inline bool beforeInEdgeMap (const MeshAdjacency::EdgeUse & a, const MeshAdjacency::EdgeUse & b) {
+    return a.v[1] > b.v[1];
+}
+
+void MeshAdjacency::computeEdges () {
+    // Each side of a triangle is found from the corner of its lower vertex,
+    // from the side starting there (i) or the one ending there (i + 2); the
+    // sides with the same vertex at both ends from the former only.
+    unsigned int nbVertices = getNbVertices ();
+    vector<unsigned int> listedBy (nbVertices, NO_VERTEX);
+    vector<unsigned int> slot (nbVertices);
+    vector<EdgeUse> around;
+    edges.clear ();
+    edges.reserve (triangles.size () * 3 / 2 + 1);
+    for (unsigned int v = 0; v < nbVertices; v++) {
+        around.clear ();
+        for (unsigned int c = cornerOffsets[v]; c < cornerOffsets[v + 1]; c++) {
+            const Triangle & t = triangles[corners[c] / 3];
+            unsigned int j = corners[c] % 3;
+            for (unsigned int side = 0; side < 2; side++) {
+                unsigned int other = t.getVertex ((side == 0) ? (j + 1) % 3 : (j + 2) % 3);
+                unsigned int opposite = t.getVertex ((side == 0) ? (j + 2) % 3 : (j + 1) % 3);
+                if (other < v || (other == v && side == 1))
+                    continue;
+                if (listedBy[other] != v) {
+                    listedBy[other] = v;
+                    slot[other] = around.size ();
+                    EdgeUse e;
+                    e.v[0] = v;
+                    e.v[1] = other;
+                    e.nbUses = 0;
+                    e.firstOpposite = opposite;
+                    around.push_back (e);
+                }
+                EdgeUse & e = around[slot[other]];
+                e.nbUses++;
+                e.lastOpposite = opposite;
+            }
+        }
+        sort (around.begin (), around.end (), beforeInEdgeMap);
+        edges.insert (edges.end (), around.begin (), around.end ());
+    }
+}
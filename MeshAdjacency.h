@@ -0,0 +1,70 @@
+// *********************************************************
+// Mesh Adjacency
+// Compressed (CSR) adjacency of a triangle mesh: the corners
+// of the triangles around each vertex, and optionally the
+// one-ring of each vertex and the table of the edges. Built
+// with counting sorts and marker arrays, in linear time, in
+// a few flat arrays instead of one container per vertex.
+// *********************************************************
+
+#ifndef MESHADJACENCY_H
+#define MESHADJACENCY_H
+
+#include <cstddef>
+#include <vector>
+
+#include "Triangle.h"
+
+class MeshAdjacency {
+public:
+    // Edge of the table, with the triangles using it in their order.
+    struct EdgeUse {
+        unsigned int v[2];           // v[0] <= v[1], as in Edge
+        unsigned int nbUses;         // sides of triangles along it
+        unsigned int firstOpposite;  // vertex facing it in the first triangle
+        unsigned int lastOpposite;   // in the last one
+    };
+
+    // The corners only.
+    MeshAdjacency (unsigned int nbVertices, const std::vector<Triangle> & triangles);
+
+    // Neighbors of each vertex, in the order collectOneRing lists them.
+    void computeOneRings ();
+    // Edges in the order of EdgeMapIndex (compareEdge).
+    void computeEdges ();
+
+    inline unsigned int getNbVertices () const { return cornerOffsets.size () - 1; }
+
+    // Corners 3 * triangle + i of the triangles around v, by increasing
+    // triangle.
+    inline unsigned int getNbCorners (unsigned int v) const { return cornerOffsets[v + 1] - cornerOffsets[v]; }
+    inline const unsigned int * getCorners (unsigned int v) const {
+        return corners.empty () ? NULL : &corners[0] + cornerOffsets[v];
+    }
+
+    // After computeOneRings.
+    inline unsigned int getNbNeighbors (unsigned int v) const { return neighborOffsets[v + 1] - neighborOffsets[v]; }
+    inline const unsigned int * getNeighbors (unsigned int v) const {
+        return neighbors.empty () ? NULL : &neighbors[0] + neighborOffsets[v];
+    }
+
+    // After computeEdges.
+    inline const std::vector<EdgeUse> & getEdges () const { return edges; }
+
+private:
+    const std::vector<Triangle> & triangles;
+    std::vector<unsigned int> cornerOffsets;
+    std::vector<unsigned int> corners;
+    std::vector<unsigned int> neighborOffsets;
+    std::vector<unsigned int> neighbors;
+    std::vector<EdgeUse> edges;
+};
+
+#endif // MESHADJACENCY_H
+
+// Some Emacs-Hints -- please don't remove:
+//
+//  Local Variables:
+//  mode:C++
+//  tab-width:4
+//  End:
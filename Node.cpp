@@ -1,9 +1,16 @@
 #include "Node.h"
 
-Node::Node() : leftChild(NULL), rightChild(NULL), triangles(), bBox(), depth(0), nbTriangles(0)
+Node::Node() : nbTriangles(0), depth(0), leftChild(NULL), rightChild(NULL), bBox(), triangles(NULL)
 {}
 
-Node::Node(BoundingBox bb, unsigned d) : leftChild(NULL), rightChild(NULL), bBox(bb), depth(d), nbTriangles(0) {}
+Node::Node(BoundingBox bb, unsigned d) : nbTriangles(0), depth(d), leftChild(NULL), rightChild(NULL), bBox(bb), triangles(NULL) {}
+
+Node::~Node()
+{
+	delete leftChild;
+	delete rightChild;
+	delete [] triangles;
+}
 
 void Node::setTriangles(const vector<unsigned>& t)
 {
@@ -17,12 +17,13 @@ class Node
 	public :
 	Node();
 	Node(BoundingBox bb, unsigned d);
+	~Node();
 	inline const BoundingBox & getBoundingBox() const {return bBox;}
 	inline const unsigned* getTriangles() const {return triangles;}
 	inline Node* getRightChild() const {return rightChild;}
 	inline Node* getLeftChild() const {return leftChild;}
 	inline unsigned getNbTriangles() const {return nbTriangles;}
-	inline bool isLeaf() {return (leftChild==NULL && rightChild == NULL);}
+	inline bool isLeaf() const {return (leftChild==NULL && rightChild == NULL);}
 	void setTriangles(const vector<unsigned>& t);
 	void print();
 
@@ -9,13 +9,32 @@
 
 using namespace std;
 
+void Object::build (const Mesh & m, const Material & material, const KDBuildParameters & kdParameters) {
+    mesh = m;
+    renderMesh = RenderMesh (mesh);
+    mat = material;
+    updateBoundingBox ();
+    kdtree.buildKDTree (renderMesh, kdParameters);
+//  kdtree.printTree ();
+}
+
 void Object::updateBoundingBox () {
-    const vector<Vertex> & V = mesh.getVertices ();
-    if (V.empty ())
+    if (renderMesh.getNbVertices () == 0)
         bbox = BoundingBox ();
     else {
-        bbox = BoundingBox (V[0].getPos ());
-        for (unsigned int i = 1; i < V.size (); i++)
-            bbox.extendTo (V[i].getPos ());
+        bbox = BoundingBox (renderMesh.getPosition (0));
+        for (unsigned int i = 1; i < renderMesh.getNbVertices (); i++)
+            bbox.extendTo (renderMesh.getPosition (i));
     }
 }
+
+void Object::compress () {
+    if (renderMesh.isCompressed () || renderMesh.isAttached () || kdtree.isAttached ())
+        return;
+    renderMesh.compress ();
+    // The boxes of the tree must still hold the moved vertices, with some
+    // room for the rounding of the decoding.
+    float slack = 1e-6f * (bbox.getSize () + bbox.getMax ().getLength () + bbox.getMin ().getLength ());
+    kdtree.compress (renderMesh.getQuantizationError () + Vec3Df (slack, slack, slack));
+    updateBoundingBox ();
+}
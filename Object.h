@@ -12,6 +12,7 @@
 #include <vector>
 
 #include "Mesh.h"
+#include "RenderMesh.h"
 #include "KDTree.h"
 #include "Material.h"
 #include "BoundingBox.h"
@@ -19,21 +20,27 @@
 class Object {
 public:
     inline Object () {}
-    inline Object (const Mesh & mesh, const Material & mat) : mesh (mesh), mat (mat) {
-        updateBoundingBox ();
-	std::cout << "building kdtree" << std::endl;
-	kdtree.buildKDTree(mesh);
-//	kdtree.printTree();
-	std::cout << "kdtree built" << std::endl;
+    inline Object (const Mesh & mesh, const Material & mat,
+                   const KDBuildParameters & kdParameters = KDBuildParameters ()) {
+        build (mesh, mat, kdParameters);
     }
     virtual ~Object () {}
 
+    // What the constructor does, in place, e.g. in a vector of objects
+    // sized beforehand: no copy of the tree.
+    void build (const Mesh & mesh, const Material & mat,
+                const KDBuildParameters & kdParameters = KDBuildParameters ());
+
     inline const Vec3Df & getTrans () const { return trans;}
     inline void setTrans (const Vec3Df & t) { trans = t; }
 
     inline const Mesh & getMesh () const { return mesh; }
     inline Mesh & getMesh () { return mesh; }
     
+    // Geometry read by the ray tracer, packed from the mesh at construction.
+    inline const RenderMesh & getRenderMesh () const { return renderMesh; }
+    inline RenderMesh & getRenderMesh () { return renderMesh; }
+
     inline const KDTree & getKDTree () const { return kdtree; }
     inline KDTree & getKDTree () { return kdtree; }
 
@@ -42,9 +49,15 @@ public:
 
     inline const BoundingBox & getBoundingBox () const { return bbox; }
     void updateBoundingBox ();
+
+    // Compresses the render mesh and the leaves of the KD-tree (see
+    // RenderMesh::compress): less memory, slower intersections. Once built,
+    // before any copy to a shared segment, which takes plain arrays only.
+    void compress ();
     
 private:
     Mesh mesh;
+    RenderMesh renderMesh;
     KDTree kdtree;
     Material mat;
     BoundingBox bbox;
@@ -6,200 +6,293 @@
 // *********************************************************
 
 #include "Ray.h"
+#include "RayKernels.h"
 
 using namespace std;
 
-static const unsigned int NUMDIM = 3, RIGHT = 0, LEFT = 1, MIDDLE = 2;
-
-bool Ray::intersect (const BoundingBox & bbox, float & tmin) const {
-	const Vec3Df & minBb = bbox.getMin ();
-	const Vec3Df & maxBb = bbox.getMax ();
-	bool inside = true;
-	unsigned int  quadrant[NUMDIM];
-	register unsigned int i;
-	unsigned int whichPlane;
-	Vec3Df maxT;
-	Vec3Df candidatePlane;
-	Vec3Df intersectionPoint;
-
-	for (i=0; i<NUMDIM; i++)
-		if (origin[i] < minBb[i]) {
-			quadrant[i] = LEFT;
-			candidatePlane[i] = minBb[i];
-			inside = false;
-		} else if (origin[i] > maxBb[i]) {
-			quadrant[i] = RIGHT;
-			candidatePlane[i] = maxBb[i];
-			inside = false;
-		} else	{
-			quadrant[i] = MIDDLE;
-		}
+// Nombre de triangles retenus par le mailboxing (puissance de 2)
+static const unsigned int MAILBOX_SIZE = 32;
+// Triangles d'une feuille passés ensemble au noyau d'intersection quand le
+// mailboxing les filtre (multiple de la largeur AVX-512)
+static const unsigned int LEAF_BATCH = 64;
 
-	if (inside)	{
-		intersectionPoint = origin;
-		return (true);
+// Indices d'un paquet de triangles décodés : le triangle k du paquet a les
+// sommets 3k, 3k+1 et 3k+2
+struct BatchIndices
+{
+	unsigned vertices[3*LEAF_BATCH];
+	unsigned triangles[LEAF_BATCH];
+	BatchIndices()
+	{
+		for(unsigned i=0; i<3*LEAF_BATCH; i++)
+			vertices[i]=i;
+		for(unsigned i=0; i<LEAF_BATCH; i++)
+			triangles[i]=i;
 	}
+};
+static const BatchIndices batchIndices;
 
-	for (i = 0; i < NUMDIM; i++)
-		if (quadrant[i] != MIDDLE && direction[i] !=0.)
-			maxT[i] = (candidatePlane[i]-origin[i]) / direction[i];
-		else
-			maxT[i] = -1.;
-
-	whichPlane = 0;
-	for (i = 1; i < NUMDIM; i++)
-		if (maxT[whichPlane] < maxT[i])
-			whichPlane = i;
-
-	if (maxT[whichPlane] < 0.) return (false);
-	for (i = 0; i < NUMDIM; i++)
-		if (whichPlane != i) {
-			intersectionPoint[i] = origin[i] + maxT[whichPlane] *direction[i];
-			if (intersectionPoint[i] < minBb[i] || intersectionPoint[i] > maxBb[i])
-				return (false);
-		} else {
-			intersectionPoint[i] = candidatePlane[i];
-		}
-	tmin=maxT[whichPlane];
-	return (true);			
+static inline bool intersectDecodedBatch(const Ray& ray, const Vec3Df* corners, const unsigned* batch, unsigned nbBatch,
+	float& tmin, unsigned& tri, float& coef1, float& coef2)
+{
+	unsigned k;
+	if(!RayKernels::intersectLeaf(ray, corners, batchIndices.vertices, batchIndices.triangles, nbBatch, tmin, k, coef1, coef2))
+		return false;
+	tri=batch[k];
+	return true;
 }
-bool Ray::intersect (const BoundingBox & bbox, Vec3Df & intersectionPoint) const {
-	const Vec3Df & minBb = bbox.getMin ();
-	const Vec3Df & maxBb = bbox.getMax ();
-	bool inside = true;
-	unsigned int  quadrant[NUMDIM];
-	register unsigned int i;
-	unsigned int whichPlane;
-	Vec3Df maxT;
-	Vec3Df candidatePlane;
-
-	for (i=0; i<NUMDIM; i++)
-		if (origin[i] < minBb[i]) {
-			quadrant[i] = LEFT;
-			candidatePlane[i] = minBb[i];
-			inside = false;
-		} else if (origin[i] > maxBb[i]) {
-			quadrant[i] = RIGHT;
-			candidatePlane[i] = maxBb[i];
-			inside = false;
-		} else	{
-			quadrant[i] = MIDDLE;
-		}
 
-	if (inside)	{
-		intersectionPoint = origin;
-		return (true);
+// Feuille d'un arbre compressé : les triangles sont lus dans le flux de la
+// feuille, leurs sommets décodés, et passés au noyau par paquets de
+// LEAF_BATCH. mailbox est NULL sans mailboxing.
+static bool intersectCompressedLeaf(const Ray& ray, const RenderMesh& m, const unsigned char* stream, unsigned nbTriangles,
+	unsigned* mailbox, float& tmin, unsigned& tri, float& coef1, float& coef2, RenderCounters* counters)
+{
+	(void) counters;
+	const unsigned* indices = m.getIndices();
+	const PackedVertex* vertices = m.getPackedVertices();
+	Vec3Df corners[3*LEAF_BATCH];
+	unsigned batch[LEAF_BATCH];
+	unsigned nbBatch = 0;
+	unsigned triangle = 0;
+	bool found = false;
+	for(unsigned i=0; i<nbTriangles; i++)
+	{
+		triangle=KDTree::readTriangle(stream, triangle);
+		if(mailbox)
+		{
+			unsigned & slot = mailbox[triangle & (MAILBOX_SIZE-1)];
+			if(slot==triangle)
+			{
+				RAYMINI_STAT(if(counters) counters->mailboxHits++);
+				continue;
+			}
+			slot=triangle;
+		}
+		const unsigned* v = indices + 3*triangle;
+		for(unsigned j=0; j<3; j++)
+			corners[3*nbBatch+j]=m.decodePosition(vertices[v[j]]);
+		batch[nbBatch++]=triangle;
+		if(nbBatch==LEAF_BATCH)
+		{
+			RAYMINI_STAT(if(counters) counters->triangleTests+=nbBatch);
+			if(intersectDecodedBatch(ray, corners, batch, nbBatch, tmin, tri, coef1, coef2))
+				found=true;
+			nbBatch=0;
+		}
 	}
+	if(nbBatch>0)
+	{
+		RAYMINI_STAT(if(counters) counters->triangleTests+=nbBatch);
+		if(intersectDecodedBatch(ray, corners, batch, nbBatch, tmin, tri, coef1, coef2))
+			found=true;
+	}
+	return found;
+}
 
-	for (i = 0; i < NUMDIM; i++)
-		if (quadrant[i] != MIDDLE && direction[i] !=0.)
-			maxT[i] = (candidatePlane[i]-origin[i]) / direction[i];
-		else
-			maxT[i] = -1.;
-
-	whichPlane = 0;
-	for (i = 1; i < NUMDIM; i++)
-		if (maxT[whichPlane] < maxT[i])
-			whichPlane = i;
-
-	if (maxT[whichPlane] < 0.) return (false);
-	for (i = 0; i < NUMDIM; i++)
-		if (whichPlane != i) {
-			intersectionPoint[i] = origin[i] + maxT[whichPlane] *direction[i];
-			if (intersectionPoint[i] < minBb[i] || intersectionPoint[i] > maxBb[i])
-				return (false);
-		} else {
-			intersectionPoint[i] = candidatePlane[i];
-		}
-	return (true);			
+bool Ray::intersect (const BoundingBox & bbox, float & t) const {
+	float tFar;
+	if (!intersect (bbox, t, tFar))
+		return false;
+	if (t < 0.0f)
+		t = 0.0f;
+	return true;
 }
-bool Ray::intersectObject(const Object & o, Vertex & intersectionPoint) const
+
+bool Ray::intersect (const BoundingBox & bbox, Vec3Df & intersectionPoint) const {
+	float t;
+	if (!intersect (bbox, t))
+		return false;
+	intersectionPoint = origin + t * direction;
+	return true;
+}
+
+bool Ray::intersectObject(const Object & o, Vertex & intersectionPoint, RenderCounters * counters) const
 {
 	bool intersection=false;
-	const Mesh & m = o.getMesh();
+	const RenderMesh & m = o.getRenderMesh();
 	const KDTree & kdtree = o.getKDTree();
-	Node* node = kdtree.getRoot();
-	stack<Node*> stackNode;
-	const std::vector<Triangle> & triangles = m.getTriangles();
-	const std::vector<Vertex> & vertices = m.getVertices();
-	float t;
+	const KDFlatNode* nodes = kdtree.getNodes();
+	const unsigned* leafTriangles = kdtree.getTriangles();
+	const unsigned* triangles = m.getIndices();
+	const Vec3Df* positions = m.getPositions();
+	const Vec3Df* normals = m.getNormals();
+	// Maillage et feuilles compressés ensemble (Object::compress)
+	const bool compressed = kdtree.isCompressed();
+	const unsigned char* leafStream = kdtree.getLeafStream();
+	if(nodes==NULL)
+		return false;
+	unsigned node = 0;
+	// Sortie du rayon du noeud courant, inconnue pour la racine
+	float nodeFar = INFINITY;
+	// Un noeud empilé par niveau au plus, avec son entrée et sa sortie :
+	// pas d'allocation
+	unsigned stackNode[KD_MAX_DEPTH];
+	float stackNear[KD_MAX_DEPTH];
+	float stackFar[KD_MAX_DEPTH];
+	unsigned stackSize = 0;
 	float tmin = INFINITY;
-	float coef1, coef2;
 	float coefBary1, coefBary2;
 	unsigned tri;
 
+	// Derniers triangles testés par ce rayon, rangés par leur indice modulo
+	// MAILBOX_SIZE : un triangle présent dans plusieurs feuilles n'est testé
+	// qu'une fois. Seulement pour les arbres qui dupliquent beaucoup.
+	const bool useMailbox = kdtree.useMailbox();
+	unsigned mailbox[MAILBOX_SIZE];
+	if(useMailbox)
+		for(unsigned i=0; i<MAILBOX_SIZE; i++)
+			mailbox[i]=~0u;
+
 	bool end = false;
 	while(!end)
 	{
-		if(node->isLeaf())
+		const KDFlatNode & n = nodes[node];
+		bool pop = false;
+		RAYMINI_STAT(if(counters) counters->nodesVisited++);
+		if(n.leaf)
 		{
-			const unsigned* trianglesLeaf = node->getTriangles();
-			for(unsigned i=0; i<node->getNbTriangles(); i++)
-			{	
-				const Vec3Df & va = vertices[triangles[trianglesLeaf[i]].getVertex(0)].getPos();
-				const Vec3Df & vb = vertices[triangles[trianglesLeaf[i]].getVertex(1)].getPos();
-				const Vec3Df & vc = vertices[triangles[trianglesLeaf[i]].getVertex(2)].getPos();
-				if(intersectTriangle(va, vb, vc, t, coef1, coef2))
-				{
+			RAYMINI_STAT(if(counters) counters->leavesVisited++);
+			const unsigned* trianglesLeaf = compressed ? NULL : leafTriangles + n.firstTriangle;
+			if(compressed)
+			{
+				if(intersectCompressedLeaf(*this, m, leafStream + n.firstTriangle, n.nbTriangles, useMailbox ? mailbox : NULL,
+						tmin, tri, coefBary1, coefBary2, counters))
 					intersection=true;
-					end=true;
-					if(t < tmin)
-					{
-						tmin=t;
-						coefBary1=coef1;
-						coefBary2=coef2;
-						tri=trianglesLeaf[i];
-					}
-				}
 			}
-			if(!intersection)
+			else if(!useMailbox)
 			{
-				if(stackNode.size()==0)
-					end=true;
-				else
+				RAYMINI_STAT(if(counters) counters->triangleTests+=n.nbTriangles);
+				if(RayKernels::intersectLeaf(*this, positions, triangles, trianglesLeaf, n.nbTriangles, tmin, tri, coefBary1, coefBary2))
+					intersection=true;
+			}
+			else
+			{
+				// Les triangles pas encore testés sont passés au noyau par
+				// paquets de LEAF_BATCH
+				unsigned batch[LEAF_BATCH];
+				unsigned nbBatch = 0;
+				for(unsigned i=0; i<n.nbTriangles; i++)
 				{	
-					node=stackNode.top();
-					stackNode.pop();
+					unsigned & slot = mailbox[trianglesLeaf[i] & (MAILBOX_SIZE-1)];
+					if(slot==trianglesLeaf[i])
+					{
+						RAYMINI_STAT(if(counters) counters->mailboxHits++);
+						continue;
+					}
+					slot=trianglesLeaf[i];
+					batch[nbBatch++]=trianglesLeaf[i];
+					if(nbBatch==LEAF_BATCH)
+					{
+						RAYMINI_STAT(if(counters) counters->triangleTests+=nbBatch);
+						if(RayKernels::intersectLeaf(*this, positions, triangles, batch, nbBatch, tmin, tri, coefBary1, coefBary2))
+							intersection=true;
+						nbBatch=0;
+					}
+				}
+				if(nbBatch>0)
+				{
+					RAYMINI_STAT(if(counters) counters->triangleTests+=nbBatch);
+					if(RayKernels::intersectLeaf(*this, positions, triangles, batch, nbBatch, tmin, tri, coefBary1, coefBary2))
+						intersection=true;
 				}
 			}
+			// Un triangle touché avant la sortie de la feuille termine le
+			// parcours : les noeuds empilés sont plus loin. Touché au-delà
+			// (le triangle dépasse de la feuille), un triangle d'une feuille
+			// suivante peut être plus proche.
+			if(intersection && tmin<=nodeFar)
+				end=true;
+			else
+				pop=true;
 		} 
 
 		else
 		{
-			float t1, t2;
+			float t1, t2, tFar1, tFar2;
 			bool b1 = false;
 			bool b2 = false;
-			b1 = intersect((node->getLeftChild())->getBoundingBox(), t1);
-			b2 = intersect((node->getRightChild())->getBoundingBox(), t2);
+			unsigned left = n.child;
+			unsigned right = n.child+1;
+			// Les feuilles vides ne sont jamais visitées
+			const KDFlatNode & l = nodes[left];
+			const KDFlatNode & r = nodes[right];
+			if(!l.leaf || l.nbTriangles>0)
+			{
+				RAYMINI_STAT(if(counters) counters->boxTests++);
+				b1 = intersect(l.bBox, t1, tFar1);
+			}
+			if(!r.leaf || r.nbTriangles>0)
+			{
+				RAYMINI_STAT(if(counters) counters->boxTests++);
+				b2 = intersect(r.bBox, t2, tFar2);
+			}
 
 			if(b1 && b2)
 			{
 				if(t1<t2)
 				{
-					stackNode.push(node->getRightChild());
-					node=node->getLeftChild();
+					stackNode[stackSize]=right;
+					stackNear[stackSize]=t2;
+					stackFar[stackSize++]=tFar2;
+					node=left;
+					nodeFar=tFar1;
 				}
 				else
 				{
-					stackNode.push(node->getLeftChild());
-					node=node->getRightChild();
+					stackNode[stackSize]=left;
+					stackNear[stackSize]=t1;
+					stackFar[stackSize++]=tFar1;
+					node=right;
+					nodeFar=tFar2;
 				}
 			}
 			else if(b1 && !b2)
-				node=node->getLeftChild();
+			{
+				node=left;
+				nodeFar=tFar1;
+			}
 			else if(!b1 && b2)
-				node=node->getRightChild();
+			{
+				node=right;
+				nodeFar=tFar2;
+			}
+			// Les boîtes des fils sont resserrées : le rayon peut traverser
+			// le noeud sans toucher aucun des deux
 			else
-				end=true;
+				pop=true;
 		}	 
+
+		if(pop)
+		{
+			// Les noeuds qui commencent après le triangle déjà touché sont
+			// abandonnés
+			while(stackSize>0 && stackNear[stackSize-1]>tmin)
+				stackSize--;
+			if(stackSize==0)
+				end=true;
+			else
+			{
+				--stackSize;
+				node=stackNode[stackSize];
+				nodeFar=stackFar[stackSize];
+			}
+		}
 	}
 
 	if(intersection)
 	{
+		RAYMINI_STAT(if(counters) counters->hits++);
+		const unsigned* v = triangles + 3*tri;
 		intersectionPoint.setPos(origin + tmin*direction);
-		intersectionPoint.setNormal((1-coefBary1-coefBary2)*vertices[triangles[tri].getVertex(0)].getNormal()
-			+ coefBary1*vertices[triangles[tri].getVertex(1)].getNormal()
-			+ coefBary2*vertices[triangles[tri].getVertex(2)].getNormal());
+		if(compressed)
+			intersectionPoint.setNormal((1-coefBary1-coefBary2)*m.getNormal(v[0])
+				+ coefBary1*m.getNormal(v[1])
+				+ coefBary2*m.getNormal(v[2]));
+		else
+			intersectionPoint.setNormal((1-coefBary1-coefBary2)*normals[v[0]]
+				+ coefBary1*normals[v[1]]
+				+ coefBary2*normals[v[2]]);
 	}
 
 	return intersection;
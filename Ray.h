@@ -10,32 +10,62 @@
 
 #include <iostream>
 #include <vector>
-#include <stack>
+#include <cfloat>
 
 #include "Vec3D.h"
 #include "BoundingBox.h"
 #include "Object.h"
+#include "RenderStats.h"
 
 class Ray {
 public:
-    inline Ray () {}
+    inline Ray () { init (); }
     inline Ray (const Vec3Df & origin, const Vec3Df & direction)
-        : origin (origin), direction (direction) {}
+        : origin (origin), direction (direction) { init (); }
     inline virtual ~Ray () {}
 
+    // Read-only: the inverse direction is cached.
     inline const Vec3Df & getOrigin () const { return origin; }
-    inline Vec3Df & getOrigin () { return origin; }
     inline const Vec3Df & getDirection () const { return direction; }
-    inline Vec3Df & getDirection () { return direction; }
+    inline const Vec3Df & getInvDirection () const { return invDirection; }
 
+    // Slab test. [tNear, tFar] is the part of the ray's line inside the box,
+    // tNear < 0 when the origin is inside; false if the box is missed or
+    // behind the origin. The near and far planes are picked with the signs
+    // of the direction, without branches; the comparisons are ordered so that
+    // the NaN of an axis-parallel ray on a slab plane are ignored.
+    inline bool intersect (const BoundingBox & bbox, float & tNear, float & tFar) const {
+        const Vec3Df & minBb = bbox.getMin ();
+        const Vec3Df & maxBb = bbox.getMax ();
+        tNear = -FLT_MAX;
+        tFar = FLT_MAX;
+        for (unsigned int i = 0; i < 3; i++) {
+            float t0 = ((sign[i] ? maxBb[i] : minBb[i]) - origin[i]) * invDirection[i];
+            float t1 = ((sign[i] ? minBb[i] : maxBb[i]) - origin[i]) * invDirection[i];
+            tNear = (t0 > tNear) ? t0 : tNear;
+            tFar = (t1 < tFar) ? t1 : tFar;
+        }
+        return (tNear <= tFar && tFar >= 0.0f);
+    }
+    // Entry point, or distance, clamped to the origin when it is inside.
     bool intersect (const BoundingBox & bbox, Vec3Df & intersectionPoint) const;
     bool intersect (const BoundingBox & bbox, float & t) const;
-    bool intersectObject(const Object & o, Vertex & intersectionPoint) const;
+    // counters, if not NULL, receives the traversal statistics (RAYMINI_STATS builds only).
+    bool intersectObject(const Object & o, Vertex & intersectionPoint, RenderCounters * counters = NULL) const;
     bool intersectTriangle(const Vec3Df & va, const Vec3Df & vb, const Vec3Df & vc, float & t, float & coef1, float & coef2) const;
     
 private:
+    inline void init () {
+        for (unsigned int i = 0; i < 3; i++) {
+            invDirection[i] = 1.0f / direction[i];
+            sign[i] = (invDirection[i] < 0.0f);
+        }
+    }
+
     Vec3Df origin;
     Vec3Df direction;
+    Vec3Df invDirection;
+    unsigned int sign[3];
 };
 
 
@@ -0,0 +1,91 @@
+// *********************************************************
+// Ray Kernels
+// *********************************************************
+
+#include "RayKernels.h"
+#include "RayKernelsLanes.h"
+#include "Ray.h"
+
+using namespace std;
+
+static bool intersectLeafScalar (const Ray & ray,
+                                 const Vec3Df * positions, const unsigned int * indices,
+                                 const unsigned int * triangles, unsigned int nbTriangles,
+                                 float & tMin, unsigned int & triangle, float & coef1, float & coef2) {
+    bool found = false;
+    float t, c1, c2;
+    for (unsigned int i = 0; i < nbTriangles; i++) {
+        const unsigned int * v = indices + 3 * triangles[i];
+        // t < tMin also rejects the NaN of degenerate triangles.
+        if (ray.intersectTriangle (positions[v[0]], positions[v[1]], positions[v[2]], t, c1, c2) && t < tMin) {
+            found = true;
+            tMin = t;
+            triangle = triangles[i];
+            coef1 = c1;
+            coef2 = c2;
+        }
+    }
+    return found;
+}
+
+
+static const char * isaNames[RayKernels::NbIsas] = { "scalar", "sse4.2", "avx2", "avx512" };
+
+RayKernels::Isa RayKernels::isa = RayKernels::getBestSupported ();
+RayKernels::LeafFunction RayKernels::leafFunction = RayKernels::getLeafFunction (RayKernels::isa);
+
+bool RayKernels::isSupported (Isa i) {
+#ifdef RAYMINI_VECTOR_KERNELS
+    // Also called by the static initializers, before main.
+    __builtin_cpu_init ();
+    switch (i) {
+    case Scalar: return true;
+    case SSE42: return __builtin_cpu_supports ("sse4.2");
+    case AVX2: return __builtin_cpu_supports ("avx2");
+    case AVX512: return __builtin_cpu_supports ("avx512f") && __builtin_cpu_supports ("avx512dq");
+    default: return false;
+    }
+#else
+    return (i == Scalar);
+#endif
+}
+
+RayKernels::Isa RayKernels::getBestSupported () {
+    Isa best = Scalar;
+    for (int i = Scalar; i < NbIsas; i++)
+        if (isSupported (static_cast<Isa> (i)))
+            best = static_cast<Isa> (i);
+    return best;
+}
+
+const char * RayKernels::getName (Isa i) {
+    return (i >= Scalar && i < NbIsas) ? isaNames[i] : "unknown";
+}
+
+bool RayKernels::parse (const string & name, Isa & i) {
+    for (int k = Scalar; k < NbIsas; k++)
+        if (name == isaNames[k]) {
+            i = static_cast<Isa> (k);
+            return true;
+        }
+    return false;
+}
+
+bool RayKernels::setIsa (Isa i) {
+    if (!isSupported (i))
+        return false;
+    isa = i;
+    leafFunction = getLeafFunction (i);
+    return true;
+}
+
+RayKernels::LeafFunction RayKernels::getLeafFunction (Isa i) {
+    switch (i) {
+#ifdef RAYMINI_VECTOR_KERNELS
+    case SSE42: return intersectLeafSSE42;
+    case AVX2: return intersectLeafAVX2;
+    case AVX512: return intersectLeafAVX512;
+#endif
+    default: return intersectLeafScalar;
+    }
+}
@@ -0,0 +1,64 @@
+// *********************************************************
+// Ray Kernels
+// Instruction-set variants of the hot intersection kernel: the
+// nearest hit among the triangles of a kd-tree leaf, tested
+// 4 (SSE4.2), 8 (AVX2) or 16 (AVX-512) triangles at a time.
+// The best variant the CPU runs is picked at startup, so that
+// a single binary uses the widest one of each render node.
+// *********************************************************
+
+#ifndef RAYKERNELS_H
+#define RAYKERNELS_H
+
+#include <string>
+
+#include "Vec3D.h"
+
+class Ray;
+
+class RayKernels {
+public:
+    enum Isa { Scalar = 0, SSE42, AVX2, AVX512, NbIsas };
+
+    // Nearest intersection of the ray with the triangles (indices in the
+    // render mesh), closer than tMin. When found, tMin, triangle and the
+    // barycentric coordinates of the hit (those of Ray::intersectTriangle)
+    // are updated. Same results as Ray::intersectTriangle in order, for
+    // every variant: ties go to the first triangle.
+    typedef bool (*LeafFunction) (const Ray & ray,
+                                  const Vec3Df * positions, const unsigned int * indices,
+                                  const unsigned int * triangles, unsigned int nbTriangles,
+                                  float & tMin, unsigned int & triangle, float & coef1, float & coef2);
+
+    static bool isSupported (Isa isa);
+    static Isa getBestSupported ();
+    static const char * getName (Isa isa);
+    // Name as printed by getName; false if unknown.
+    static bool parse (const std::string & name, Isa & isa);
+
+    // The variant used by Ray::intersectObject, the best supported one
+    // unless changed; false (and unchanged) if the CPU lacks it.
+    static inline Isa getIsa () { return isa; }
+    static bool setIsa (Isa isa);
+    static LeafFunction getLeafFunction (Isa isa);
+
+    static inline bool intersectLeaf (const Ray & ray,
+                                      const Vec3Df * positions, const unsigned int * indices,
+                                      const unsigned int * triangles, unsigned int nbTriangles,
+                                      float & tMin, unsigned int & triangle, float & coef1, float & coef2) {
+        return leafFunction (ray, positions, indices, triangles, nbTriangles, tMin, triangle, coef1, coef2);
+    }
+
+private:
+    static Isa isa;
+    static LeafFunction leafFunction;
+};
+
+#endif // RAYKERNELS_H
+
+// Some Emacs-Hints -- please don't remove:
+//
+//  Local Variables:
+//  mode:C++
+//  tab-width:4
+//  End:
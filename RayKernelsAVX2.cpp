@@ -0,0 +1,24 @@
+// *********************************************************
+// Ray Kernels, AVX2 variant
+// *********************************************************
+
+#include "Ray.h"
+
+#ifdef __GNUC__
+#pragma GCC target ("avx2")
+// No fused multiply-adds: the same roundings as the scalar kernel.
+#pragma GCC optimize ("fp-contract=off")
+#endif
+
+#include "RayKernelsLanes.h"
+
+#ifdef RAYMINI_VECTOR_KERNELS
+
+bool intersectLeafAVX2 (const Ray & ray,
+                        const Vec3Df * positions, const unsigned int * indices,
+                        const unsigned int * triangles, unsigned int nbTriangles,
+                        float & tMin, unsigned int & triangle, float & coef1, float & coef2) {
+    return intersectLeafLanes<8> (ray, positions, indices, triangles, nbTriangles, tMin, triangle, coef1, coef2);
+}
+
+#endif // RAYMINI_VECTOR_KERNELS
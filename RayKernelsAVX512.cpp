@@ -0,0 +1,24 @@
+// *********************************************************
+// Ray Kernels, AVX512 variant
+// *********************************************************
+
+#include "Ray.h"
+
+#ifdef __GNUC__
+#pragma GCC target ("avx512f,avx512dq")
+// No fused multiply-adds: the same roundings as the scalar kernel.
+#pragma GCC optimize ("fp-contract=off")
+#endif
+
+#include "RayKernelsLanes.h"
+
+#ifdef RAYMINI_VECTOR_KERNELS
+
+bool intersectLeafAVX512 (const Ray & ray,
+                          const Vec3Df * positions, const unsigned int * indices,
+                          const unsigned int * triangles, unsigned int nbTriangles,
+                          float & tMin, unsigned int & triangle, float & coef1, float & coef2) {
+    return intersectLeafLanes<16> (ray, positions, indices, triangles, nbTriangles, tMin, triangle, coef1, coef2);
+}
+
+#endif // RAYMINI_VECTOR_KERNELS
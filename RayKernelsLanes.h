@@ -0,0 +1,147 @@
+// *********************************************************
+// Ray Kernels Lanes
+// The vector variants of RayKernels, written once with the
+// GCC vector extensions. Each RayKernels<ISA>.cpp includes
+// this file after a "#pragma GCC target", which compiles what
+// follows for that instruction set only: no special flag for
+// the whole build, which must still run on the oldest nodes.
+// The other headers go before the pragma, so that their inline
+// functions are never emitted with the wider instructions.
+// *********************************************************
+
+#ifndef RAYKERNELSLANES_H
+#define RAYKERNELSLANES_H
+
+#include "Vec3D.h"
+#include "Ray.h"
+
+#if defined (__GNUC__) && (defined (__x86_64__) || defined (__i386__))
+#define RAYMINI_VECTOR_KERNELS
+#endif
+
+#ifdef RAYMINI_VECTOR_KERNELS
+
+// RayKernels::LeafFunction, 4, 8 and 16 triangles at a time.
+bool intersectLeafSSE42 (const Ray & ray,
+                         const Vec3Df * positions, const unsigned int * indices,
+                         const unsigned int * triangles, unsigned int nbTriangles,
+                         float & tMin, unsigned int & triangle, float & coef1, float & coef2);
+bool intersectLeafAVX2 (const Ray & ray,
+                        const Vec3Df * positions, const unsigned int * indices,
+                        const unsigned int * triangles, unsigned int nbTriangles,
+                        float & tMin, unsigned int & triangle, float & coef1, float & coef2);
+bool intersectLeafAVX512 (const Ray & ray,
+                          const Vec3Df * positions, const unsigned int * indices,
+                          const unsigned int * triangles, unsigned int nbTriangles,
+                          float & tMin, unsigned int & triangle, float & coef1, float & coef2);
+
+namespace {
+
+template <unsigned int W> struct Lanes {
+    typedef float Float __attribute__ ((vector_size (4 * W)));
+    typedef int Mask __attribute__ ((vector_size (4 * W)));
+};
+
+template <typename V>
+inline void loadLanes (V & v, const float * values) {
+    __builtin_memcpy (&v, values, sizeof (V));
+}
+
+// Ray::intersectTriangle on nbTriangles <= W triangles at once, with the
+// same operations in the same order, hence the same values per triangle:
+// the files including it turn off the contraction into FMA, which the
+// avx512f target would otherwise allow. The vertices are gathered in
+// structure-of-arrays lanes; the missing triangles are copies of the last
+// one, which never win a tie.
+template <unsigned int W>
+inline bool intersectGroup (const Ray & ray,
+                            const Vec3Df * positions, const unsigned int * indices,
+                            const unsigned int * triangles, unsigned int nbTriangles,
+                            float & tMin, unsigned int & triangle, float & coef1, float & coef2) {
+    typedef typename Lanes<W>::Float Float;
+    typedef typename Lanes<W>::Mask Mask;
+    float lanes[9][W] __attribute__ ((aligned (64)));
+    for (unsigned int k = 0; k < W; k++) {
+        const unsigned int * v = indices + 3 * triangles[(k < nbTriangles) ? k : nbTriangles - 1];
+        for (unsigned int j = 0; j < 3; j++) {
+            const Vec3Df & p = positions[v[j]];
+            lanes[3 * j][k] = p[0];
+            lanes[3 * j + 1][k] = p[1];
+            lanes[3 * j + 2][k] = p[2];
+        }
+    }
+    Float ax, ay, az, bx, by, bz, cx, cy, cz;
+    loadLanes (ax, lanes[0]); loadLanes (ay, lanes[1]); loadLanes (az, lanes[2]);
+    loadLanes (bx, lanes[3]); loadLanes (by, lanes[4]); loadLanes (bz, lanes[5]);
+    loadLanes (cx, lanes[6]); loadLanes (cy, lanes[7]); loadLanes (cz, lanes[8]);
+    const Vec3Df & o = ray.getOrigin ();
+    const Vec3Df & d = ray.getDirection ();
+    Float zero = ax - ax;
+    Float dx = zero + d[0], dy = zero + d[1], dz = zero + d[2];
+
+    Float v1x = ax - bx, v1y = ay - by, v1z = az - bz;
+    Float v2x = ax - cx, v2y = ay - cy, v2z = az - cz;
+    Float v3x = ax - o[0], v3y = ay - o[1], v3z = az - o[2];
+    Float m0 = v2y * dz - dy * v2z;
+    Float m1 = dx * v2z - v2x * dz;
+    Float m2 = v2x * dy - v2y * dx;
+    Float M = v1x * m0 + v1y * m1 + v1z * m2;
+    Float c1 = (v3x * m0 + v3y * m1 + v3z * m2) / M;
+    Float q0 = v1x * v3y - v3x * v1y;
+    Float q1 = v3x * v1z - v1x * v3z;
+    Float q2 = v1y * v3z - v3y * v1z;
+    Float c2 = (dz * q0 + dy * q1 + dx * q2) / M;
+    Float t = -(v2z * q0 + v2y * q1 + v2x * q2) / M;
+    // The NaN of degenerate triangles fail every comparison.
+    Mask hit = (c1 >= zero) & (c1 <= zero + 1.0f) & (c2 >= zero) & (c1 + c2 <= zero + 1.0f)
+        & (t > zero + 0.0001f) & (t < zero + tMin);
+    Mask none = hit ^ hit;
+    if (__builtin_memcmp (&hit, &none, sizeof (Mask)) == 0)
+        return false;
+    bool found = false;
+    for (unsigned int k = 0; k < W; k++)
+        if (hit[k] && t[k] < tMin) {
+            found = true;
+            tMin = t[k];
+            triangle = triangles[k];
+            coef1 = c1[k];
+            coef2 = c2[k];
+        }
+    return found;
+}
+
+// Groups of W triangles while more than W / 2 are left, the last one padded;
+// fewer go through narrower groups, as a padding lane costs as much as a
+// real one.
+template <unsigned int W>
+inline bool intersectLeafLanes (const Ray & ray,
+                                const Vec3Df * positions, const unsigned int * indices,
+                                const unsigned int * triangles, unsigned int nbTriangles,
+                                float & tMin, unsigned int & triangle, float & coef1, float & coef2) {
+    bool found = false;
+    unsigned int first = 0;
+    while (first < nbTriangles && (W == 4 || nbTriangles - first > W / 2)) {
+        unsigned int n = (nbTriangles - first < W) ? nbTriangles - first : W;
+        if (intersectGroup<W> (ray, positions, indices, triangles + first, n, tMin, triangle, coef1, coef2))
+            found = true;
+        first += n;
+    }
+    if (first < nbTriangles
+        && intersectLeafLanes<(W > 4) ? W / 2 : 4> (ray, positions, indices, triangles + first, nbTriangles - first,
+                                                      tMin, triangle, coef1, coef2))
+        found = true;
+    return found;
+}
+
+} // namespace
+
+#endif // RAYMINI_VECTOR_KERNELS
+
+#endif // RAYKERNELSLANES_H
+
+// Some Emacs-Hints -- please don't remove:
+//
+//  Local Variables:
+//  mode:C++
+//  tab-width:4
+//  End:
@@ -9,7 +9,12 @@
 #include "Ray.h"
 #include "Scene.h"
 #include "KDTree.h"
+#include "Hash.h"
+#include "RenderCheckpoint.h"
+#include "Trace.h"
+#include "ScratchArena.h"
 #include <QProgressDialog>
+#include <QApplication>
 
 
 static RayTracer * instance = NULL;
@@ -36,6 +41,18 @@ inline int clamp (float f, int inf, int sup)
 	return (v < inf ? inf : (v > sup ? sup : v));
 }
 
+// Compteurs de l'objet k, NULL si les statistiques ne sont pas compilées
+static inline RenderCounters * objectCounters (RenderStats * stats, unsigned int k)
+{
+#ifdef RAYMINI_STATS
+	return (stats != NULL) ? &stats->getObject (k) : NULL;
+#else
+	(void) stats;
+	(void) k;
+	return NULL;
+#endif
+}
+
 QImage RayTracer::render (const Vec3Df & camPos,
 		const Vec3Df & direction,
 		const Vec3Df & upVector,
@@ -45,195 +62,381 @@ QImage RayTracer::render (const Vec3Df & camPos,
 		unsigned int screenWidth,
 		unsigned int screenHeight) 
 {
+	return render (RenderCamera (camPos, direction, upVector, rightVector,
+				fieldOfView, aspectRatio, screenWidth, screenHeight));
+}
+
+QImage RayTracer::render (const RenderCamera & camera)
+{
+	TraceScope trace ("RayTracer::render");
+	unsigned int screenWidth = camera.screenWidth;
+	unsigned int screenHeight = camera.screenHeight;
 	QImage image (QSize (screenWidth, screenHeight), QImage::Format_RGB888);
+	unsigned int nbTiles = settings.getNbTiles (screenWidth, screenHeight);
 	Scene * scene = Scene::getInstance ();
-	QProgressDialog progressDialog ("Raytracing...", "Cancel", 0, 100);
-	progressDialog.show ();
-	for (unsigned int i = 0; i < screenWidth; i++) 
+	lastStats.reset (scene->getObjects ().size (), scene->getAreaLights ().size ());
+	// Compteurs du thread de rendu, fusionnés à la fin
+	RenderStats stats;
+	stats.reset (scene->getObjects ().size (), scene->getAreaLights ().size ());
+	vector<bool> done (nbTiles, false);
+	unsigned int nbDone = 0;
+	// Carte des coûts, seulement si elle est demandée
+	RenderCostMap * costs = NULL;
+	if (!heatmapFilename.empty ())
+	{
+		costs = new RenderCostMap ();
+		costs->reset (screenWidth, screenHeight, nbTiles);
+	}
+
+	// Reprise d'un rendu interrompu : les tuiles déjà journalisées sont recopiées dans l'image
+	RenderCheckpoint checkpoint;
+	if (!checkpointFilename.empty ())
+	{
+		nbDone = checkpoint.resume (checkpointFilename, Scene::getInstance ()->computeHash (),
+				computeSettingsHash (camera), settings, image, done);
+		if (nbDone > 0)
+			cout << "Resuming render: " << nbDone << "/" << nbTiles << " tiles restored from " << checkpointFilename << endl;
+	}
+
+	// Pas de fenêtre de progression pour les processus sans interface (serveur, workers)
+	QProgressDialog * progressDialog = NULL;
+	if (QApplication::type () != QApplication::Tty)
+	{
+		progressDialog = new QProgressDialog ("Raytracing...", "Cancel", 0, 100);
+		progressDialog->show ();
+	}
+	for (unsigned int t = 0; t < nbTiles; t++) 
 	{
-		progressDialog.setValue ((100*i)/screenWidth);
-		for (unsigned int j = 0; j < screenHeight; j++) 
+		if (done[t])
+			continue;
+		TraceScope tileTrace ("tile", static_cast<int> (t));
+		if (progressDialog != NULL)
+			progressDialog->setValue ((100*nbDone)/nbTiles);
+		RenderTile tile = settings.getTile (t, screenWidth, screenHeight);
+		unsigned long long tileStart = RenderCostMap::now ();
+		unsigned long long nbRays = renderTile (camera, tile, image, RenderStats::isEnabled () ? &stats : NULL, costs);
+		if (costs != NULL)
+			costs->setTile (t, tile, RenderCostMap::now () - tileStart, nbRays);
+		checkpoint.commitTile (image, t);
+		nbDone++;
+	}
+	if (progressDialog != NULL)
+	{
+		progressDialog->setValue (100);
+		delete progressDialog;
+	}
+	checkpoint.finish ();
+	lastStats.merge (stats);
+	if (costs != NULL)
+	{
+		if (costs->save (heatmapFilename))
+			cout << "Heatmap saved to " << heatmapFilename << " (slowest tile: "
+				<< costs->getImbalance () << "x the mean)" << endl;
+		else
+			cerr << "Cannot save the heatmap to " << heatmapFilename << endl;
+		delete costs;
+	}
+	return image;
+}
+
+unsigned long long RayTracer::computeSettingsHash (const RenderCamera & camera) const
+{
+	Hash h;
+	h.add (camera.position);
+	h.add (camera.viewDirection);
+	h.add (camera.upVector);
+	h.add (camera.rightVector);
+	h.add (camera.fieldOfView);
+	h.add (camera.aspectRatio);
+	h.add (camera.screenWidth);
+	h.add (camera.screenHeight);
+	h.add (backgroundColor);
+	h.add (settings.softShadows);
+	h.add (settings.hardShadows);
+	h.add (settings.nbRaysPerPixel);
+	h.add (settings.nbPointsDisc);
+	h.add (settings.tileSize);
+	return h.get ();
+}
+
+unsigned long long RayTracer::renderTile (const RenderCamera & camera, const RenderTile & tile, QImage & image,
+		RenderStats * stats, RenderCostMap * costs) const
+{
+	// Choisie une fois pour toute la tuile, pas à chaque pixel
+	ShadeFunction shade = getShadeFunction ();
+	// Mémoire temporaire des pixels, vidée à chaque tuile
+	ScratchArena & scratch = ScratchArena::getThreadArena ();
+	scratch.reset ();
+	unsigned long long nbHits = 0;
+	for (unsigned int i = tile.x0; i < tile.x1; i++) 
+		for (unsigned int j = tile.y0; j < tile.y1; j++) 
 		{
-			//Paramètres variables
-			bool softShadows=true;
-			bool hardShadows=false;
-			unsigned nbRaysPerPixel=2; // 2 => distribution 2*2, 3 => distribution 3*3, etc 
-			unsigned nbPointsDisc = 20; // nombre de point répartis aléatoirement sur la source étendue
-
-			float tanX = tan (fieldOfView)*aspectRatio;
-			float tanY = tan (fieldOfView);
-			float pixelWidth =tanX/screenWidth;
-			float pixelHeight = tanY/screenHeight;
-			Vec3Df stepX = (float (i) - screenWidth/2.f) * pixelWidth * rightVector;
-			Vec3Df stepY = (float (j) - screenHeight/2.f) * pixelHeight * upVector;
-			Vec3Df step = stepX + stepY;
-			Vec3Df dir = direction + step;
-			dir.normalize ();
-			Vertex intersectionPoint;
-			unsigned objectIntersectedIndex; // retient l'objet de la scene qui a été intersecté
-			float smallestIntersectionDistance = 1000000.f;
-			Vec3Df c (backgroundColor);
-			bool hasIntersection=false;  
-			vector<Vec3Df> miniSteps;  // Pour créer des points espacés régulirement à l'intérieur du pixel
-			miniSteps.resize(nbRaysPerPixel*nbRaysPerPixel);
-			vector<Vec3Df> colors; // c sera la moyenne des couleurs obtenu pour chaque rayon du pixel
-			colors.resize(nbRaysPerPixel*nbRaysPerPixel);
-			for(unsigned i1=0; i1<colors.size(); i1++)
-				colors[i1]=Vec3Df(backgroundColor);
-
-			// On crée des points espacés régulièrement à l'intérieur du pixel
-			for(unsigned rx=0; rx<nbRaysPerPixel; rx++)
-			{
-				for(unsigned ry=0; ry<nbRaysPerPixel; ry++)
-				{	
-					miniSteps[ry*nbRaysPerPixel+rx] = Vec3Df(((float)(rx+1)/(float)(nbRaysPerPixel+1)-0.5f)*pixelWidth,
-							((float)(ry+1)/(float)(nbRaysPerPixel+1)-0.5f)*pixelHeight,0);
+			unsigned long long pixelStart = (costs != NULL) ? RenderCostMap::now () : 0;
+			Vec3Df c = (this->*shade) (camera, i, j, stats, scratch, nbHits);
+			if (costs != NULL)
+				costs->setPixel (i, j, RenderCostMap::now () - pixelStart);
+			image.setPixel (i, j, qRgb (clamp (c[0], 0, 255), clamp (c[1], 0, 255), clamp (c[2], 0, 255)));
+		}
+	// Rayons de la tuile, comptés sans RAYMINI_STATS : les rayons primaires
+	// sont fixés par les réglages, et chaque intersection envoie un rayon
+	// par source (un par point de la source pour les ombres douces)
+	unsigned long long nbPixels = static_cast<unsigned long long> (tile.x1 - tile.x0) * (tile.y1 - tile.y0);
+	unsigned long long nbShadowRaysPerHit = 0;
+	if (settings.getShadowMode () == RenderSettings::SoftShadows)
+		nbShadowRaysPerHit = Scene::getInstance ()->getAreaLights ().size () * settings.nbPointsDisc;
+	else if (settings.getShadowMode () == RenderSettings::HardShadows)
+		nbShadowRaysPerHit = Scene::getInstance ()->getAreaLights ().size ();
+	return nbPixels * settings.nbRaysPerPixel * settings.nbRaysPerPixel + nbHits * nbShadowRaysPerHit;
+}
+
+void RayTracer::getTilePixels (const QImage & image, const RenderTile & tile, vector<unsigned char> & pixels)
+{
+	TraceScope trace ("RayTracer::getTilePixels");
+	pixels.resize (3 * (tile.x1 - tile.x0) * (tile.y1 - tile.y0));
+	unsigned int k = 0;
+	for (unsigned int j = tile.y0; j < tile.y1; j++)
+		for (unsigned int i = tile.x0; i < tile.x1; i++)
+		{
+			QRgb c = image.pixel (i, j);
+			pixels[k++] = qRed (c);
+			pixels[k++] = qGreen (c);
+			pixels[k++] = qBlue (c);
+		}
+}
+
+void RayTracer::setTilePixels (QImage & image, const RenderTile & tile, const vector<unsigned char> & pixels)
+{
+	TraceScope trace ("RayTracer::setTilePixels");
+	unsigned int k = 0;
+	for (unsigned int j = tile.y0; j < tile.y1; j++)
+		for (unsigned int i = tile.x0; i < tile.x1; i++, k += 3)
+			image.setPixel (i, j, qRgb (pixels[k], pixels[k+1], pixels[k+2]));
+}
+
+// Instances de shadePixel : grilles de 1x1 à 4x4 rayons par pixel, et les
+// 20 points par défaut pour les ombres douces ; les autres réglages passent
+// par l'instance générique (0).
+RayTracer::ShadeFunction RayTracer::getShadeFunction () const
+{
+	switch (settings.getShadowMode ())
+	{
+	case RenderSettings::NoShadows:
+		return getShadeFunction<RenderSettings::NoShadows, 1> (settings.nbRaysPerPixel);
+	case RenderSettings::HardShadows:
+		return getShadeFunction<RenderSettings::HardShadows, 1> (settings.nbRaysPerPixel);
+	default:
+		if (settings.nbPointsDisc == 20)
+			return getShadeFunction<RenderSettings::SoftShadows, 20> (settings.nbRaysPerPixel);
+		return getShadeFunction<RenderSettings::SoftShadows, 0> (settings.nbRaysPerPixel);
+	}
+}
+
+template <int shadowMode, unsigned int pointsDisc>
+RayTracer::ShadeFunction RayTracer::getShadeFunction (unsigned int nbRaysPerPixel)
+{
+	switch (nbRaysPerPixel)
+	{
+	case 1: return &RayTracer::shadePixel<shadowMode, 1, pointsDisc>;
+	case 2: return &RayTracer::shadePixel<shadowMode, 2, pointsDisc>;
+	case 3: return &RayTracer::shadePixel<shadowMode, 3, pointsDisc>;
+	case 4: return &RayTracer::shadePixel<shadowMode, 4, pointsDisc>;
+	default: return &RayTracer::shadePixel<shadowMode, 0, pointsDisc>;
+	}
+}
+
+template <int shadowMode, unsigned int raysPerPixel, unsigned int pointsDisc>
+Vec3Df RayTracer::shadePixel (const RenderCamera & camera, unsigned int i, unsigned int j, RenderStats * stats,
+		ScratchArena & scratch, unsigned long long & nbHits) const
+{
+	// Paramètres fixés par l'instance, sinon lus dans RenderSettings : les
+	// tests du mode d'ombres disparaissent à la compilation et les boucles de
+	// taille connue sont déroulées
+	const bool softShadows = (shadowMode == RenderSettings::SoftShadows);
+	const bool hardShadows = (shadowMode == RenderSettings::HardShadows);
+	const unsigned nbRaysPerPixel = (raysPerPixel > 0) ? raysPerPixel : settings.nbRaysPerPixel;
+	const unsigned nbPointsDisc = softShadows ? ((pointsDisc > 0) ? pointsDisc : settings.nbPointsDisc) : 1;
+	const Scene * scene = Scene::getInstance ();
+	const std::vector<AreaLight> & sceneAreaLights = scene->getAreaLights();
+	const Vec3Df & camPos = camera.position;
+	const Vec3Df & direction = camera.viewDirection;
+	const Vec3Df & upVector = camera.upVector;
+	const Vec3Df & rightVector = camera.rightVector;
+	float fieldOfView = camera.fieldOfView;
+	float aspectRatio = camera.aspectRatio;
+	unsigned int screenWidth = camera.screenWidth;
+	unsigned int screenHeight = camera.screenHeight;
+
+	float tanX = tan (fieldOfView)*aspectRatio;
+	float tanY = tan (fieldOfView);
+	float pixelWidth =tanX/screenWidth;
+	float pixelHeight = tanY/screenHeight;
+	Vec3Df stepX = (float (i) - screenWidth/2.f) * pixelWidth * rightVector;
+	Vec3Df stepY = (float (j) - screenHeight/2.f) * pixelHeight * upVector;
+	Vec3Df step = stepX + stepY;
+	Vec3Df dir = direction + step;
+	dir.normalize ();
+	Vertex intersectionPoint;
+	unsigned objectIntersectedIndex; // retient l'objet de la scene qui a été intersecté
+	float smallestIntersectionDistance = 1000000.f;
+	Vec3Df c (backgroundColor);
+	bool hasIntersection=false;  
+	// Points des sources étendues, tirés à nouveau pour chaque source : pris
+	// dans la mémoire de la tuile et rendus à la fin du pixel
+	size_t scratchMark = scratch.getMark ();
+	Vec3Df * discretization = softShadows ? scratch.allocate<Vec3Df> (nbPointsDisc) : NULL;
+
+	//On cherche l'intersection de chacun des rayons passant par un point du pixel avec la scene
+	//Les rayons passent par des points espacés régulièrement à l'intérieur du pixel
+	for(unsigned r=0; r<nbRaysPerPixel*nbRaysPerPixel; r++)
+	{
+		unsigned rx = r%nbRaysPerPixel;
+		unsigned ry = r/nbRaysPerPixel;
+		Vec3Df miniStep(((float)(rx+1)/(float)(nbRaysPerPixel+1)-0.5f)*pixelWidth,
+				((float)(ry+1)/(float)(nbRaysPerPixel+1)-0.5f)*pixelHeight,0);
+		// c sera la moyenne des couleurs obtenues pour chaque rayon du pixel
+		Vec3Df color(backgroundColor);
+		RAYMINI_STAT(if(stats) stats->getRays().primaryRays++);
+		//On test tous les objets de la scene et on ne garde que l'intersection de l'objet le plus proche
+		for (unsigned int k = 0; k < scene->getObjects().size (); k++) 
+		{
+			Vertex intersectionPointTemp;
+			const Object & o = scene->getObjects()[k];
+			Ray ray(camPos-o.getTrans (), dir+miniStep);
+			if (ray.intersectObject (o, intersectionPointTemp, objectCounters (stats, k)))
+			{	
+				float intersectionDistance = Vec3Df::squaredDistance (intersectionPointTemp.getPos() + o.getTrans (), camPos);
+				if (intersectionDistance < smallestIntersectionDistance) 
+				{
+					hasIntersection=true;
+					objectIntersectedIndex=k;
+					intersectionPoint=intersectionPointTemp;
+					smallestIntersectionDistance = intersectionDistance;
 				}
 			}
+		}
+
+		//Si le rayon a intersecté un triangle
+		if(hasIntersection)
+		{
+			RAYMINI_STAT(if(stats) stats->getRays().hits++);
+			nbHits++;
+			//L'objet sera noir s'il n'est visible par aucune source lumineuse
+			color = Vec3Df(0.0f,0.0f,0.0f);
+			const Object & o = scene->getObjects()[objectIntersectedIndex];
+			const Material & material = o.getMaterial();
 
-			//On cherche l'intersection de chacun des rayons passant par un point du pixel avec la scene
-			for(unsigned r=0; r<nbRaysPerPixel*nbRaysPerPixel; r++)
+			//On traite chaque source de lumière
+			for(unsigned l=0; l < sceneAreaLights.size(); l++)
 			{
-				//On test tous les objets de la scene et on ne garde que l'intersection de l'objet le plus proche
-				for (unsigned int k = 0; k < scene->getObjects().size (); k++) 
-				{
-					Vertex intersectionPointTemp;
-					const Object & o = scene->getObjects()[k];
-					Ray ray(camPos-o.getTrans (), dir+miniSteps[r]);
-					if (ray.intersectObject (o, intersectionPointTemp))
-					{	
-						float intersectionDistance = Vec3Df::squaredDistance (intersectionPointTemp.getPos() + o.getTrans (), camPos);
-						if (intersectionDistance < smallestIntersectionDistance) 
-						{
-							hasIntersection=true;
-							objectIntersectedIndex=k;
-							intersectionPoint=intersectionPointTemp;
-							smallestIntersectionDistance = intersectionDistance;
-						}
-					}
-				}
+				// Position du point en World Space
+				Vec3Df pointWS = intersectionPoint.getPos()+o.getTrans();
+
+				// Position de la source lumineuse, elle est fixe dans l'espace caméra
+				Vec3Df lightPos=sceneAreaLights[l].getPos();
+				lightPos[0]=Vec3Df::dotProduct(rightVector,lightPos);
+				lightPos[1]=Vec3Df::dotProduct(upVector,lightPos);
+				lightPos[2]=Vec3Df::dotProduct(-direction,lightPos);
+				lightPos+=camPos;
 
-				//Si le rayon a intersecté un triangle
-				if(hasIntersection)
+				//Direction du point vers la source lumineuse
+				Vec3Df directionToLight = lightPos - pointWS;
+				directionToLight.normalize();
+				float visibility = (float)nbPointsDisc;
+
+				//Si l'on veut représenter des ombres douces
+				if(softShadows)
 				{
-					//L'objet sera noir s'il n'est visible par aucune source lumineuse
-					colors[r] = Vec3Df(0.0f,0.0f,0.0f);
-					const Object & o = scene->getObjects()[objectIntersectedIndex];
-					Material material = o.getMaterial();
-					std::vector<AreaLight> sceneAreaLights = scene->getAreaLights();
-
-					//On traite chaque source de lumière
-					for(unsigned l=0; l < sceneAreaLights.size(); l++)
+					// On répartit aléatoirement des point sur la surface de la source
+					sceneAreaLights[l].discretize(nbPointsDisc, discretization);
+
+					// Pour chacun des points discrétisés On va lancé un rayon vers chacun des points discrétisé
+					for(unsigned n=0; n<nbPointsDisc; n++)
 					{
-						// Position du point en World Space
-						Vec3Df pointWS = intersectionPoint.getPos()+o.getTrans();
-
-						// Position de la source lumineuse, elle est fixe dans l'espace caméra
-						Vec3Df lightPos=sceneAreaLights[l].getPos();
-						lightPos[0]=Vec3Df::dotProduct(rightVector,lightPos);
-						lightPos[1]=Vec3Df::dotProduct(upVector,lightPos);
-						lightPos[2]=Vec3Df::dotProduct(-direction,lightPos);
-						lightPos+=camPos;
-
-						//Direction du point vers la source lumineuse
-						Vec3Df directionToLight = lightPos - pointWS;
-						directionToLight.normalize();
-						float visibility = (float)nbPointsDisc;
-
-						//Si l'on veut représenter des ombres douces
-						if(softShadows)
-						{
-							// On répartit aléatoirement des point sur la surface de la source
-							sceneAreaLights[l].discretize(nbPointsDisc);
-							const vector<Vec3Df>& discretization = sceneAreaLights[l].getDiscretization();
+						// Le point discrétisé de la source étendue reste fixe par rapport à la caméra
+						Vec3Df lightPosDisc=discretization[n];
+						lightPosDisc[0]=Vec3Df::dotProduct(rightVector,lightPosDisc);
+						lightPosDisc[1]=Vec3Df::dotProduct(upVector,lightPosDisc);
+						lightPosDisc[2]=Vec3Df::dotProduct(-direction,lightPosDisc);
+						lightPosDisc+=camPos;
 
-							// Pour chacun des points discrétisés On va lancé un rayon vers chacun des points discrétisé
-							for(unsigned n=0; n<nbPointsDisc; n++)
-							{
-								// Le point discrétisé de la source étendue reste fixe par rapport à la caméra
-								Vec3Df lightPosDisc=discretization[n];
-								lightPosDisc[0]=Vec3Df::dotProduct(rightVector,lightPosDisc);
-								lightPosDisc[1]=Vec3Df::dotProduct(upVector,lightPosDisc);
-								lightPosDisc[2]=Vec3Df::dotProduct(-direction,lightPosDisc);
-								lightPosDisc+=camPos;
-
-								Vec3Df directionToLightDisc = lightPosDisc - pointWS;
-								directionToLightDisc.normalize();
-
-								//On test si le point d'intersection est visible du point
-								// discretisé de la source lumineuse
-								for (unsigned int k = 0; k < scene->getObjects().size (); k++) 
-								{
-									Vertex intersectionPointTemp;
-									const Object & oTemp = scene->getObjects()[k];
-									Ray rayPointToLightDisc(pointWS-oTemp.getTrans(), directionToLightDisc);
-									// 
-									if (rayPointToLightDisc.intersectObject (oTemp, intersectionPointTemp))
-									{
-										//Un objet cache le point discretisé de la source étendue
-										//Ce point de la source étendu n'éclaire donc pas le point d'intersection 
-										visibility--;
-										// Pas la peine de chercher d'autres intersections avec d'autres objets
-										break;
-									}
-								}
-							}
-						}// On a fini de traiter les ombres douces
+						Vec3Df directionToLightDisc = lightPosDisc - pointWS;
+						directionToLightDisc.normalize();
+						RAYMINI_STAT(if(stats) { stats->getRays().shadowRays++; stats->getLight(l).shadowRays++; });
 
-						//Si l'on veut représenter des ombres dures
-						//On ne considére que des sources ponctuelles
-						//On n'envoie par conséquent qu'un rayon vers la source lumineuse
-						else if(hardShadows)
+						//On test si le point d'intersection est visible du point
+						// discretisé de la source lumineuse
+						for (unsigned int k = 0; k < scene->getObjects().size (); k++) 
 						{
-							for (unsigned int k = 0; k < scene->getObjects().size (); k++) 
+							Vertex intersectionPointTemp;
+							const Object & oTemp = scene->getObjects()[k];
+							Ray rayPointToLightDisc(pointWS-oTemp.getTrans(), directionToLightDisc);
+							// 
+							if (rayPointToLightDisc.intersectObject (oTemp, intersectionPointTemp, objectCounters (stats, k)))
 							{
-								Vertex intersectionPointTemp;
-								const Object & oTemp = scene->getObjects()[k];
-								Ray rayPointToLight(pointWS-oTemp.getTrans(), directionToLight);
-								if (rayPointToLight.intersectObject (oTemp, intersectionPointTemp))
-								{
-									visibility=0.0f; // L'objet n'est pas éclairé
-									break;
-								}
+								RAYMINI_STAT(if(stats) stats->getLight(l).hits++);
+								//Un objet cache le point discretisé de la source étendue
+								//Ce point de la source étendu n'éclaire donc pas le point d'intersection 
+								visibility--;
+								// Pas la peine de chercher d'autres intersections avec d'autres objets
+								break;
 							}
 						}
+					}
+				}// On a fini de traiter les ombres douces
 
-						visibility/=(float)nbPointsDisc;
-
-						//Si l'objet est au moins partiellement éclairé
-						if(visibility>0.0f)
+				//Si l'on veut représenter des ombres dures
+				//On ne considére que des sources ponctuelles
+				//On n'envoie par conséquent qu'un rayon vers la source lumineuse
+				else if(hardShadows)
+				{
+					RAYMINI_STAT(if(stats) { stats->getRays().shadowRays++; stats->getLight(l).shadowRays++; });
+					for (unsigned int k = 0; k < scene->getObjects().size (); k++) 
+					{
+						Vertex intersectionPointTemp;
+						const Object & oTemp = scene->getObjects()[k];
+						Ray rayPointToLight(pointWS-oTemp.getTrans(), directionToLight);
+						if (rayPointToLight.intersectObject (oTemp, intersectionPointTemp, objectCounters (stats, k)))
 						{
-							//Phong Shading
-
-
-							//la normal de l'objet en ce point
-							//Seule des translations ont été appliquées à l'objet, la normale n'est dont pas modifiée
-							Vec3Df normal=intersectionPoint.getNormal()/intersectionPoint.getNormal().getLength();
-
-							float diff = Vec3Df::dotProduct(normal, directionToLight);
-							Vec3Df reflected = 2*diff*normal-directionToLight;
-							if(diff<=0.0f)
-								diff=0.0f;
-							reflected.normalize();
-							float spec = Vec3Df::dotProduct(reflected, -dir); 
-							if(spec <= 0.0f)
-								spec=0.0f;
-
-							colors[r] += sceneAreaLights[l].getIntensity()*(material.getDiffuse()*diff 
-									+ material.getSpecular()*spec)*sceneAreaLights[l].getColor()*material.getColor();
-							
-							//l'intensité est plus ou moins forte selon que le point est plus ou moins eclairé
-							colors[r]*=visibility;
+							RAYMINI_STAT(if(stats) stats->getLight(l).hits++);
+							visibility=0.0f; // L'objet n'est pas éclairé
+							break;
 						}
-					}// On a fini de traiter chacune des lumières de la scène
-				}// On a fini de calculer la couleur du pixel lorsqu'un rayon intersecte la scène
-				c+=colors[r];
-			}// On a traité tous les rayons envoyés à l'intérieur d'un même pixel
+					}
+				}
 
-			c=255.0f*c/colors.size(); // On fait la moyenne de la couleur obtenue pour chaque rayon;
-			image.setPixel (i, j, qRgb (clamp (c[0], 0, 255), clamp (c[1], 0, 255), clamp (c[2], 0, 255)));
-		}
-	}
-	progressDialog.setValue (100);
-	return image;
+				visibility/=(float)nbPointsDisc;
+
+				//Si l'objet est au moins partiellement éclairé
+				if(visibility>0.0f)
+				{
+					//Phong Shading
+
+
+					//la normal de l'objet en ce point
+					//Seule des translations ont été appliquées à l'objet, la normale n'est dont pas modifiée
+					Vec3Df normal=intersectionPoint.getNormal()/intersectionPoint.getNormal().getLength();
+
+					float diff = Vec3Df::dotProduct(normal, directionToLight);
+					Vec3Df reflected = 2*diff*normal-directionToLight;
+					if(diff<=0.0f)
+						diff=0.0f;
+					reflected.normalize();
+					float spec = Vec3Df::dotProduct(reflected, -dir); 
+					if(spec <= 0.0f)
+						spec=0.0f;
+
+					color += sceneAreaLights[l].getIntensity()*(material.getDiffuse()*diff 
+							+ material.getSpecular()*spec)*sceneAreaLights[l].getColor()*material.getColor();
+					
+					//l'intensité est plus ou moins forte selon que le point est plus ou moins eclairé
+					color*=visibility;
+				}
+			}// On a fini de traiter chacune des lumières de la scène
+		}// On a fini de calculer la couleur du pixel lorsqu'un rayon intersecte la scène
+		c+=color;
+	}// On a traité tous les rayons envoyés à l'intérieur d'un même pixel
+
+	c=255.0f*c/(nbRaysPerPixel*nbRaysPerPixel); // On fait la moyenne de la couleur obtenue pour chaque rayon;
+	scratch.rewind (scratchMark);
+	return c;
 }
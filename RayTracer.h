@@ -10,9 +10,15 @@
 
 #include <iostream>
 #include <vector>
+#include <string>
 #include <QImage>
 
 #include "Vec3D.h"
+#include "RenderSettings.h"
+#include "RenderStats.h"
+#include "RenderCostMap.h"
+
+class ScratchArena;
 
 class RayTracer {
 public:
@@ -21,6 +27,22 @@ public:
 
     inline const Vec3Df & getBackgroundColor () const { return backgroundColor;}
     inline void setBackgroundColor (const Vec3Df & c) { backgroundColor = c; }
+
+    inline const RenderSettings & getSettings () const { return settings; }
+    inline void setSettings (const RenderSettings & s) { settings = s; }
+
+    // When set, completed tiles are journaled to this file and a render
+    // of the same scene and settings restarts from the tiles found there.
+    inline const std::string & getCheckpointFilename () const { return checkpointFilename; }
+    inline void setCheckpointFilename (const std::string & f) { checkpointFilename = f; }
+
+    // When set, the time spent on each pixel is saved as a heatmap image
+    // under this name, and the cost of each tile in <name>.csv.
+    inline const std::string & getHeatmapFilename () const { return heatmapFilename; }
+    inline void setHeatmapFilename (const std::string & f) { heatmapFilename = f; }
+
+    // Counters of the last render (all 0 unless built with RAYMINI_STATS).
+    inline const RenderStats & getLastStats () const { return lastStats; }
     
     QImage render (const Vec3Df & camPos,
                    const Vec3Df & viewDirection,
@@ -30,13 +52,49 @@ public:
                    float aspectRatio,
                    unsigned int screenWidth,
                    unsigned int screenHeight);
+    QImage render (const RenderCamera & camera);
+
+    // Renders the pixels of one tile of the frame into image, which has the
+    // size of the whole frame. Used by the tile workers of distributed renders.
+    // stats, if not NULL, accumulates the counters of the tile, and costs
+    // receives the time spent on each pixel. Returns the primary and shadow
+    // rays traced for the tile, counted in every build.
+    unsigned long long renderTile (const RenderCamera & camera, const RenderTile & tile, QImage & image,
+                                   RenderStats * stats = NULL, RenderCostMap * costs = NULL) const;
+    unsigned long long computeSettingsHash (const RenderCamera & camera) const;
+
+    // RGB888 copy of the pixels of a tile, row by row.
+    static void getTilePixels (const QImage & image, const RenderTile & tile, std::vector<unsigned char> & pixels);
+    static void setTilePixels (QImage & image, const RenderTile & tile, const std::vector<unsigned char> & pixels);
     
 protected:
     inline RayTracer () {}
     inline virtual ~RayTracer () {}
     
 private:
+    typedef Vec3Df (RayTracer::*ShadeFunction) (const RenderCamera & camera, unsigned int i, unsigned int j,
+                                                 RenderStats * stats, ScratchArena & scratch,
+                                                 unsigned long long & nbHits) const;
+
+    // shadePixel is compiled for the common settings: the shadow mode, the
+    // grid of rays per pixel and the points of the area lights are constants
+    // there, 0 standing for the value of the settings. getShadeFunction picks
+    // the instance of the current settings. The temporary arrays of a pixel
+    // come from scratch, the arena of the render thread, and are released
+    // when it returns: shading a pixel allocates nothing on the heap. nbHits
+    // counts the primary rays that hit, each one followed by shadow rays.
+    ShadeFunction getShadeFunction () const;
+    template <int shadowMode, unsigned int pointsDisc>
+    static ShadeFunction getShadeFunction (unsigned int nbRaysPerPixel);
+    template <int shadowMode, unsigned int raysPerPixel, unsigned int pointsDisc>
+    Vec3Df shadePixel (const RenderCamera & camera, unsigned int i, unsigned int j, RenderStats * stats,
+                       ScratchArena & scratch, unsigned long long & nbHits) const;
+
     Vec3Df backgroundColor;
+    RenderSettings settings;
+    std::string checkpointFilename;
+    std::string heatmapFilename;
+    RenderStats lastStats;
 };
 
 
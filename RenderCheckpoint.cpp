@@ -0,0 +1,148 @@
+// *********************************************************
+// Render Checkpoint Class
+// *********************************************************
+
+#include "RenderCheckpoint.h"
+#include "Hash.h"
+#include "RayTracer.h"
+
+#include <cstdio>
+#include <iostream>
+
+using namespace std;
+
+static const char CHECKPOINT_MAGIC[4] = {'R', 'M', 'C', 'K'};
+static const unsigned int CHECKPOINT_VERSION = 1;
+
+RenderCheckpoint::RenderCheckpoint ()
+    : sceneHash (0), settingsHash (0), width (0), height (0) {}
+
+RenderCheckpoint::~RenderCheckpoint () {
+    if (output.is_open ())
+        output.close ();
+}
+
+unsigned int RenderCheckpoint::resume (const string & f,
+                                       unsigned long long sHash,
+                                       unsigned long long rHash,
+                                       const RenderSettings & s,
+                                       QImage & image,
+                                       vector<bool> & done) {
+    filename = f;
+    sceneHash = sHash;
+    settingsHash = rHash;
+    settings = s;
+    width = image.width ();
+    height = image.height ();
+    unsigned int nbTiles = settings.getNbTiles (width, height);
+    done.assign (nbTiles, false);
+
+    unsigned int recovered = 0;
+    streampos validEnd = 0;
+    ifstream input (filename.c_str (), ios::binary);
+    if (input) {
+        if (readHeader (input)) {
+            validEnd = input.tellg ();
+            vector<unsigned char> pixels;
+            while (true) {
+                unsigned int tileIndex, sum;
+                if (!input.read (reinterpret_cast<char *> (&tileIndex), sizeof (tileIndex)) || tileIndex >= nbTiles)
+                    break;
+                RenderTile tile = settings.getTile (tileIndex, width, height);
+                pixels.resize (3 * (tile.x1 - tile.x0) * (tile.y1 - tile.y0));
+                if (!input.read (reinterpret_cast<char *> (&pixels[0]), pixels.size ())
+                    || !input.read (reinterpret_cast<char *> (&sum), sizeof (sum))
+                    || sum != checksum (tileIndex, pixels))
+                    break;
+                RayTracer::setTilePixels (image, tile, pixels);
+                if (!done[tileIndex]) {
+                    done[tileIndex] = true;
+                    recovered++;
+                }
+                validEnd = input.tellg ();
+            }
+        } else
+            cerr << "[Checkpoint] " << filename << " belongs to another scene or settings, restarting." << endl;
+        input.close ();
+    }
+
+    if (validEnd > 0) {
+        // Rewrite the valid prefix so that a torn record does not stay in
+        // front of the tiles appended from now on.
+        ifstream prefix (filename.c_str (), ios::binary);
+        vector<char> data (static_cast<size_t> (validEnd));
+        prefix.read (&data[0], data.size ());
+        prefix.close ();
+        output.open (filename.c_str (), ios::binary | ios::trunc);
+        output.write (&data[0], data.size ());
+        output.flush ();
+    } else {
+        output.open (filename.c_str (), ios::binary | ios::trunc);
+        writeHeader ();
+    }
+    if (!output)
+        cerr << "[Checkpoint] Cannot write " << filename << ", the render will not be resumable." << endl;
+    return recovered;
+}
+
+void RenderCheckpoint::commitTile (const QImage & image, unsigned int tileIndex) {
+    if (!output.is_open ())
+        return;
+    RenderTile tile = settings.getTile (tileIndex, width, height);
+    vector<unsigned char> pixels;
+    RayTracer::getTilePixels (image, tile, pixels);
+    unsigned int sum = checksum (tileIndex, pixels);
+    output.write (reinterpret_cast<const char *> (&tileIndex), sizeof (tileIndex));
+    output.write (reinterpret_cast<const char *> (&pixels[0]), pixels.size ());
+    output.write (reinterpret_cast<const char *> (&sum), sizeof (sum));
+    output.flush ();
+}
+
+void RenderCheckpoint::finish () {
+    if (!output.is_open ())
+        return;
+    output.close ();
+    remove (filename.c_str ());
+}
+
+bool RenderCheckpoint::readHeader (ifstream & input) const {
+    char magic[4];
+    unsigned int version, w, h, ts, rays, disc;
+    unsigned long long sHash, rHash;
+    input.read (magic, 4);
+    input.read (reinterpret_cast<char *> (&version), sizeof (version));
+    input.read (reinterpret_cast<char *> (&sHash), sizeof (sHash));
+    input.read (reinterpret_cast<char *> (&rHash), sizeof (rHash));
+    input.read (reinterpret_cast<char *> (&w), sizeof (w));
+    input.read (reinterpret_cast<char *> (&h), sizeof (h));
+    input.read (reinterpret_cast<char *> (&ts), sizeof (ts));
+    input.read (reinterpret_cast<char *> (&rays), sizeof (rays));
+    input.read (reinterpret_cast<char *> (&disc), sizeof (disc));
+    if (!input)
+        return false;
+    return (equal (magic, magic + 4, CHECKPOINT_MAGIC)
+            && version == CHECKPOINT_VERSION
+            && sHash == sceneHash && rHash == settingsHash
+            && w == width && h == height && ts == settings.tileSize
+            && rays == settings.nbRaysPerPixel && disc == settings.nbPointsDisc);
+}
+
+void RenderCheckpoint::writeHeader () {
+    output.write (CHECKPOINT_MAGIC, 4);
+    output.write (reinterpret_cast<const char *> (&CHECKPOINT_VERSION), sizeof (CHECKPOINT_VERSION));
+    output.write (reinterpret_cast<const char *> (&sceneHash), sizeof (sceneHash));
+    output.write (reinterpret_cast<const char *> (&settingsHash), sizeof (settingsHash));
+    output.write (reinterpret_cast<const char *> (&width), sizeof (width));
+    output.write (reinterpret_cast<const char *> (&height), sizeof (height));
+    output.write (reinterpret_cast<const char *> (&settings.tileSize), sizeof (settings.tileSize));
+    output.write (reinterpret_cast<const char *> (&settings.nbRaysPerPixel), sizeof (settings.nbRaysPerPixel));
+    output.write (reinterpret_cast<const char *> (&settings.nbPointsDisc), sizeof (settings.nbPointsDisc));
+    output.flush ();
+}
+
+unsigned int RenderCheckpoint::checksum (unsigned int tileIndex, const vector<unsigned char> & pixels) {
+    Hash h;
+    h.add (tileIndex);
+    h.add (&pixels[0], pixels.size ());
+    return static_cast<unsigned int> (h.get () ^ (h.get () >> 32));
+}
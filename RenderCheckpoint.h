@@ -0,0 +1,66 @@
+// *********************************************************
+// Render Checkpoint Class
+// Journal of the tiles completed during a long render, so
+// that a killed job can be resumed where it stopped.
+// *********************************************************
+
+#ifndef RENDERCHECKPOINT_H
+#define RENDERCHECKPOINT_H
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <QImage>
+
+#include "RenderSettings.h"
+
+// File layout: a header identifying the frame (scene hash, settings hash,
+// resolution, tile size) followed by one record per completed tile: tile
+// index, RGB pixels of the tile, checksum. Records are appended and flushed
+// as tiles complete; a truncated trailing record is simply ignored.
+class RenderCheckpoint {
+public:
+    RenderCheckpoint ();
+    virtual ~RenderCheckpoint ();
+
+    // Opens the journal of the frame. If an existing file matches the scene and
+    // settings hashes, its tiles are copied into image and flagged in done,
+    // otherwise the file is restarted from scratch. Returns the number of
+    // tiles recovered.
+    unsigned int resume (const std::string & filename,
+                         unsigned long long sceneHash,
+                         unsigned long long settingsHash,
+                         const RenderSettings & settings,
+                         QImage & image,
+                         std::vector<bool> & done);
+
+    // Appends the pixels of a completed tile to the journal.
+    void commitTile (const QImage & image, unsigned int tileIndex);
+
+    // The frame is complete: the journal is closed and removed.
+    void finish ();
+
+    inline bool isOpen () const { return output.is_open (); }
+
+private:
+    bool readHeader (std::ifstream & input) const;
+    void writeHeader ();
+    static unsigned int checksum (unsigned int tileIndex, const std::vector<unsigned char> & pixels);
+
+    std::string filename;
+    std::ofstream output;
+    unsigned long long sceneHash;
+    unsigned long long settingsHash;
+    RenderSettings settings;
+    unsigned int width;
+    unsigned int height;
+};
+
+#endif // RENDERCHECKPOINT_H
+
+// Some Emacs-Hints -- please don't remove:
+//
+//  Local Variables:
+//  mode:C++
+//  tab-width:4
+//  End:
@@ -0,0 +1,47 @@
+// *********************************************************
+// Render Client Class
+// *********************************************************
+
+#include "RenderClient.h"
+#include "RayTracer.h"
+
+#include <vector>
+
+using namespace std;
+
+RenderClient::RenderClient (const string & path) {
+    socket = Socket::connectLocal (path);
+}
+
+RenderClient::~RenderClient () {
+    socket.close ();
+}
+
+QImage RenderClient::render (const RenderCamera & camera,
+                             const RenderSettings & settings,
+                             const Vec3Df & backgroundColor,
+                             bool fitCamera,
+                             unsigned int & renderTime) {
+    Message request (Message::Request);
+    request.write (static_cast<unsigned int> (fitCamera ? Message::FitCameraToScene : 0));
+    request.writeFrame (camera, settings, backgroundColor);
+    socket.send (request);
+
+    Message answer;
+    if (!socket.receive (answer))
+        throw Socket::Exception ("The server closed the connection.");
+    if (answer.getType () == Message::Error)
+        throw Message::Exception (answer.readString ());
+    if (answer.getType () != Message::Image)
+        throw Message::Exception ("Unexpected answer.");
+    RenderTile frame;
+    frame.x0 = frame.y0 = 0;
+    frame.x1 = answer.read<unsigned int> ();
+    frame.y1 = answer.read<unsigned int> ();
+    renderTime = answer.read<unsigned int> ();
+    vector<unsigned char> pixels (3 * frame.x1 * frame.y1);
+    answer.read (&pixels[0], pixels.size ());
+    QImage image (QSize (frame.x1, frame.y1), QImage::Format_RGB888);
+    RayTracer::setTilePixels (image, frame, pixels);
+    return image;
+}
@@ -0,0 +1,40 @@
+// *********************************************************
+// Render Client Class
+// Sends render requests to a RenderServer.
+// *********************************************************
+
+#ifndef RENDERCLIENT_H
+#define RENDERCLIENT_H
+
+#include <string>
+#include <QImage>
+
+#include "RenderSettings.h"
+#include "Socket.h"
+
+class RenderClient {
+public:
+    RenderClient (const std::string & path);
+    virtual ~RenderClient ();
+
+    // Renders a frame on the server. With fitCamera, only the resolution of
+    // camera is used and the server frames the whole scene. Throws
+    // Socket::Exception or Message::Exception on failure.
+    QImage render (const RenderCamera & camera,
+                   const RenderSettings & settings,
+                   const Vec3Df & backgroundColor,
+                   bool fitCamera,
+                   unsigned int & renderTime);
+
+private:
+    Socket socket;
+};
+
+#endif // RENDERCLIENT_H
+
+// Some Emacs-Hints -- please don't remove:
+//
+//  Local Variables:
+//  mode:C++
+//  tab-width:4
+//  End:
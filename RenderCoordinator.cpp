@@ -0,0 +1,385 @@
+// *********************************************************
+// Render Coordinator Class
+// *********************************************************
+
+#include "RenderCoordinator.h"
+#include "RayTracer.h"
+#include "Scene.h"
+#include "Trace.h"
+#include "RayKernels.h"
+
+#include <iostream>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+
+using namespace std;
+
+// Tiles queued on a worker at once: one being rendered, one waiting, so that
+// the worker never stays idle during a round trip.
+static const unsigned int MAX_TILES_IN_FLIGHT = 2;
+// At most that many workers render the same tile when rebalancing.
+static const unsigned int MAX_TILE_COPIES = 2;
+// Seconds a new connection has to send its Hello; the workers load their
+// scene before connecting, so it comes right away.
+static const double HELLO_TIMEOUT = 10.0;
+// A connected worker may not leave a message half sent longer than this.
+static const unsigned int RECEIVE_TIMEOUT_MS = 10000;
+// Seconds without any worker, connected or starting on this host, before
+// the coordinator renders the tiles itself.
+static const double WORKER_WAIT = 10.0;
+
+static double now () {
+    timeval tv;
+    gettimeofday (&tv, NULL);
+    return tv.tv_sec + 1e-6 * tv.tv_usec;
+}
+
+RenderCoordinator::RenderCoordinator (unsigned short port)
+    : port (port), sceneHash (0), frameId (0), nbDone (0) {
+    listener = Socket::listenTCP (port);
+}
+
+RenderCoordinator::~RenderCoordinator () {
+    for (unsigned int w = 0; w < workers.size (); w++)
+        workers[w].socket.close ();
+    listener.close ();
+    for (unsigned int i = 0; i < localWorkers.size (); i++)
+        waitpid (localWorkers[i], NULL, 0);
+}
+
+void RenderCoordinator::spawnLocalWorkers (unsigned int n) {
+    char address[32];
+    snprintf (address, sizeof (address), "127.0.0.1:%u", port);
+    // The workers build the same scene; those of the same node map the one
+    // built by the coordinator.
+    const string & shm = Scene::getSharedMemoryName ();
+    const string & generator = Scene::getGeneratorSpec ();
+    // Same kernel as ours when it was forced.
+    RayKernels::Isa isa = RayKernels::getIsa ();
+    vector<const char *> args;
+    args.push_back ("raymini");
+    if (!shm.empty ()) {
+        args.push_back ("-shm");
+        args.push_back (shm.c_str ());
+    }
+    if (!generator.empty ()) {
+        args.push_back ("-generate");
+        args.push_back (generator.c_str ());
+    }
+    if (isa != RayKernels::getBestSupported ()) {
+        args.push_back ("-isa");
+        args.push_back (RayKernels::getName (isa));
+    }
+    if (Scene::getCompressGeometry ())
+        args.push_back ("-compress");
+    if (Scene::getReorderMeshes ())
+        args.push_back ("-reorder");
+    char tolerance[32];
+    if (Scene::getCleanTolerance () >= 0.0f) {
+        snprintf (tolerance, sizeof (tolerance), "%.9g", Scene::getCleanTolerance ());
+        args.push_back ("-clean");
+        args.push_back (tolerance);
+    }
+    args.push_back ("-worker");
+    args.push_back (address);
+    args.push_back (NULL);
+    for (unsigned int i = 0; i < n; i++) {
+        pid_t pid = fork ();
+        if (pid == 0) {
+            execv ("/proc/self/exe", const_cast<char * const *> (&args[0]));
+            perror ("[RenderCoordinator] exec");
+            _exit (127);
+        } else if (pid > 0)
+            localWorkers.push_back (pid);
+        else
+            perror ("[RenderCoordinator] fork");
+    }
+}
+
+QImage RenderCoordinator::render (const RenderCamera & c) {
+    TraceScope trace ("RenderCoordinator::render");
+    RayTracer * rayTracer = RayTracer::getInstance ();
+    camera = c;
+    frameId++;
+    settings = rayTracer->getSettings ();
+    sceneHash = Scene::getInstance ()->computeHash ();
+    image = QImage (QSize (camera.screenWidth, camera.screenHeight), QImage::Format_RGB888);
+    unsigned int nbTiles = settings.getNbTiles (camera.screenWidth, camera.screenHeight);
+    done.assign (nbTiles, false);
+    nbDone = 0;
+
+    if (!checkpointFilename.empty ())
+        nbDone = checkpoint.resume (checkpointFilename, sceneHash,
+                                    rayTracer->computeSettingsHash (camera), settings, image, done);
+    queue.clear ();
+    for (unsigned int t = nbTiles; t > 0; t--)
+        if (!done[t-1])
+            queue.push_back (t-1);
+
+    Message frame (Message::Frame);
+    frame.writeFrame (camera, settings, rayTracer->getBackgroundColor ());
+    for (unsigned int w = workers.size (); w > 0; w--) {
+        // The others get the frame once greeted.
+        if (!workers[w-1].greeted)
+            continue;
+        try {
+            workers[w-1].socket.send (frame);
+            workers[w-1].ready = true;
+            assignTiles (workers[w-1]);
+        } catch (const Socket::Exception & e) {
+            dropWorker (w-1);
+        }
+    }
+
+    unsigned int lastPercent = 0;
+    double lastWorkerTime = now ();
+    bool renderingHere = false;
+    while (nbDone < nbTiles) {
+        // Nobody to render the frame: one tile here per round, still
+        // accepting the workers that show up.
+        if (!workers.empty () || reapLocalWorkers () > 0) {
+            lastWorkerTime = now ();
+            renderingHere = false;
+        } else if (now () - lastWorkerTime > WORKER_WAIT) {
+            if (!renderingHere)
+                cerr << "[RenderCoordinator] No worker, rendering the remaining tiles here." << endl;
+            renderingHere = true;
+            renderTileHere ();
+        }
+
+        vector<pollfd> fds (workers.size () + 1);
+        fds[0].fd = listener.getDescriptor ();
+        fds[0].events = POLLIN;
+        for (unsigned int w = 0; w < workers.size (); w++) {
+            fds[w+1].fd = workers[w].socket.getDescriptor ();
+            fds[w+1].events = POLLIN;
+        }
+        int nbReady = poll (&fds[0], fds.size (), renderingHere ? 0 : 1000);
+        // Connections that never said Hello.
+        for (unsigned int w = workers.size (); w > 0; w--)
+            if (!workers[w-1].greeted && now () - workers[w-1].acceptTime > HELLO_TIMEOUT
+                && !(nbReady > 0 && (fds[w].revents & (POLLIN | POLLHUP | POLLERR)))) {
+                cerr << "[RenderCoordinator] No greeting from a new connection, closed." << endl;
+                dropWorker (w-1);
+                fds.erase (fds.begin () + w);
+            }
+        if (nbReady <= 0)
+            continue;
+        // Workers first, from the last one, so that dropping one does not
+        // shift the descriptors left to read.
+        for (unsigned int w = workers.size (); w > 0; w--) {
+            if (!(fds[w].revents & (POLLIN | POLLHUP | POLLERR)))
+                continue;
+            Worker & worker = workers[w-1];
+            try {
+                Message message;
+                bool greeting = !worker.greeted;
+                if (!worker.socket.receive (message)
+                    || !(greeting ? greetWorker (worker, message, frame) : handleMessage (worker, message))) {
+                    dropWorker (w-1);
+                    continue;
+                }
+                assignTiles (worker);
+            } catch (const Socket::Exception & e) {
+                cerr << e.getMessage () << endl;
+                dropWorker (w-1);
+            } catch (const Message::Exception & e) {
+                cerr << e.getMessage () << endl;
+                dropWorker (w-1);
+            }
+        }
+        if (fds[0].revents & POLLIN)
+            acceptWorker ();
+        unsigned int percent = (100 * nbDone) / nbTiles;
+        if (percent / 10 != lastPercent / 10)
+            cout << "Raytracing... " << percent << "%" << endl;
+        lastPercent = percent;
+    }
+    checkpoint.finish ();
+
+    Message doneMessage (Message::Done);
+    for (unsigned int w = workers.size (); w > 0; w--) {
+        if (!workers[w-1].greeted)
+            continue;
+        cout << "Worker " << w-1 << ": " << workers[w-1].nbTilesDone << " tiles" << endl;
+        workers[w-1].ready = false;
+        workers[w-1].inFlight.clear ();
+        workers[w-1].startTimes.clear ();
+        workers[w-1].nbTilesDone = 0;
+        try {
+            workers[w-1].socket.send (doneMessage);
+        } catch (const Socket::Exception & e) {
+            dropWorker (w-1);
+        }
+    }
+    return image;
+}
+
+// Its Hello is read by the poll loop, so that a silent connection does not
+// hold the frame.
+void RenderCoordinator::acceptWorker () {
+    Worker worker;
+    try {
+        worker.socket = listener.accept ();
+        worker.socket.setReceiveTimeout (RECEIVE_TIMEOUT_MS);
+    } catch (const Socket::Exception & e) {
+        cerr << e.getMessage () << endl;
+        worker.socket.close ();
+        return;
+    }
+    worker.acceptTime = now ();
+    workers.push_back (worker);
+}
+
+bool RenderCoordinator::greetWorker (Worker & worker, Message & hello, const Message & frame) {
+    if (hello.getType () != Message::Hello) {
+        cerr << "[RenderCoordinator] Unexpected greeting." << endl;
+        return false;
+    }
+    if (hello.read<unsigned long long> () != sceneHash) {
+        Message error (Message::Error);
+        error.writeString ("The worker did not load the same scene as the coordinator.");
+        worker.socket.send (error);
+        cerr << "[RenderCoordinator] Scene mismatch, worker rejected." << endl;
+        return false;
+    }
+    worker.socket.send (frame);
+    worker.greeted = true;
+    worker.ready = true;
+    return true;
+}
+
+bool RenderCoordinator::handleMessage (Worker & worker, Message & message) {
+    if (message.getType () == Message::Error) {
+        cerr << "[Worker] " << message.readString () << endl;
+        return false;
+    }
+    if (message.getType () != Message::Pixels)
+        return false;
+    // Late answer to a tile of a previous frame.
+    if (message.read<unsigned int> () != frameId)
+        return true;
+    unsigned int tile = message.read<unsigned int> ();
+    if (tile >= done.size ())
+        return false;
+    RenderTile t = settings.getTile (tile, camera.screenWidth, camera.screenHeight);
+    vector<unsigned char> pixels (3 * (t.x1 - t.x0) * (t.y1 - t.y0));
+    message.read (&pixels[0], pixels.size ());
+    for (unsigned int i = 0; i < worker.inFlight.size (); i++)
+        if (worker.inFlight[i] == tile) {
+            worker.inFlight.erase (worker.inFlight.begin () + i);
+            worker.startTimes.erase (worker.startTimes.begin () + i);
+            break;
+        }
+    worker.nbTilesDone++;
+    if (!done[tile]) {
+        RayTracer::setTilePixels (image, t, pixels);
+        done[tile] = true;
+        nbDone++;
+        checkpoint.commitTile (image, tile);
+    }
+    return true;
+}
+
+void RenderCoordinator::dropWorker (unsigned int w) {
+    vector<unsigned int> inFlight = workers[w].inFlight;
+    workers[w].socket.close ();
+    workers.erase (workers.begin () + w);
+    for (unsigned int i = 0; i < inFlight.size (); i++)
+        if (!done[inFlight[i]] && countCopies (inFlight[i]) == 0)
+            queue.push_back (inFlight[i]);
+    for (unsigned int i = 0; i < workers.size (); i++)
+        if (workers[i].ready)
+            assignTiles (workers[i]);
+}
+
+void RenderCoordinator::assignTiles (Worker & worker) {
+    unsigned int tile;
+    while (worker.ready && worker.inFlight.size () < MAX_TILES_IN_FLIGHT && pickTile (worker, tile))
+        sendTile (worker, tile);
+}
+
+bool RenderCoordinator::pickTile (const Worker & worker, unsigned int & tile) {
+    while (!queue.empty ()) {
+        tile = queue.back ();
+        queue.pop_back ();
+        if (!done[tile])
+            return true;
+    }
+    // Nothing left to hand out: duplicate the oldest tile still running on
+    // another worker.
+    double oldest = 0.0;
+    bool found = false;
+    for (unsigned int w = 0; w < workers.size (); w++) {
+        const Worker & other = workers[w];
+        if (&other == &worker)
+            continue;
+        for (unsigned int i = 0; i < other.inFlight.size (); i++) {
+            unsigned int t = other.inFlight[i];
+            if (done[t] || countCopies (t) >= MAX_TILE_COPIES)
+                continue;
+            if (find (worker.inFlight.begin (), worker.inFlight.end (), t) != worker.inFlight.end ())
+                continue;
+            if (!found || other.startTimes[i] < oldest) {
+                oldest = other.startTimes[i];
+                tile = t;
+                found = true;
+            }
+        }
+    }
+    return found;
+}
+
+void RenderCoordinator::sendTile (Worker & worker, unsigned int tile) {
+    Message message (Message::Tile);
+    message.write (frameId);
+    message.write (tile);
+    // A send failure shows up as a hang-up on the next poll, where the
+    // worker is dropped and its tiles requeued.
+    try {
+        worker.socket.send (message);
+    } catch (const Socket::Exception & e) {
+        worker.ready = false;
+    }
+    worker.inFlight.push_back (tile);
+    worker.startTimes.push_back (now ());
+}
+
+unsigned int RenderCoordinator::reapLocalWorkers () {
+    for (unsigned int i = localWorkers.size (); i > 0; i--) {
+        int status;
+        if (waitpid (localWorkers[i-1], &status, WNOHANG) == localWorkers[i-1]) {
+            if (!WIFEXITED (status) || WEXITSTATUS (status) != 0)
+                cerr << "[RenderCoordinator] Local worker " << localWorkers[i-1] << " failed." << endl;
+            localWorkers.erase (localWorkers.begin () + (i-1));
+        }
+    }
+    return localWorkers.size ();
+}
+
+// Only without workers: nothing is in flight, the tiles left are queued.
+void RenderCoordinator::renderTileHere () {
+    while (!queue.empty () && done[queue.back ()])
+        queue.pop_back ();
+    if (queue.empty ())
+        return;
+    unsigned int tile = queue.back ();
+    queue.pop_back ();
+    TraceScope trace ("tile", static_cast<int> (tile));
+    RayTracer::getInstance ()->renderTile (camera, settings.getTile (tile, camera.screenWidth, camera.screenHeight), image);
+    done[tile] = true;
+    nbDone++;
+    checkpoint.commitTile (image, tile);
+}
+
+unsigned int RenderCoordinator::countCopies (unsigned int tile) const {
+    unsigned int n = 0;
+    for (unsigned int w = 0; w < workers.size (); w++)
+        n += count (workers[w].inFlight.begin (), workers[w].inFlight.end (), tile);
+    return n;
+}
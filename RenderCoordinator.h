@@ -0,0 +1,90 @@
+// *********************************************************
+// Render Coordinator Class
+// Spreads the tiles of one frame over worker processes
+// (see RenderWorker) and assembles the final image.
+// *********************************************************
+
+#ifndef RENDERCOORDINATOR_H
+#define RENDERCOORDINATOR_H
+
+#include <string>
+#include <vector>
+#include <sys/types.h>
+#include <QImage>
+
+#include "RenderSettings.h"
+#include "Socket.h"
+#include "RenderCheckpoint.h"
+
+// Workers connect over TCP, so they may run on this host or on farm nodes.
+// Tiles are handed out on demand, a few at a time per worker, so fast workers
+// naturally take more of the frame. Once no tile is left to hand out, idle
+// workers get a copy of the tile that has been running the longest elsewhere:
+// the first result wins, which keeps a slow or stalled worker from holding
+// the frame. The tiles of a worker that disconnects go back to the queue.
+// When no worker is connected nor starting for a while, the coordinator
+// renders the remaining tiles itself, so that a frame always completes.
+class RenderCoordinator {
+public:
+    RenderCoordinator (unsigned short port);
+    virtual ~RenderCoordinator ();
+
+    // Starts n raymini processes on this host, connected as workers.
+    void spawnLocalWorkers (unsigned int n);
+
+    QImage render (const RenderCamera & camera);
+
+    inline void setCheckpointFilename (const std::string & f) { checkpointFilename = f; }
+
+private:
+    class Worker {
+    public:
+        inline Worker () : greeted (false), ready (false), nbTilesDone (0), acceptTime (0.0) {}
+        Socket socket;
+        bool greeted;  // sent the Hello of the same scene
+        bool ready;
+        std::vector<unsigned int> inFlight;
+        std::vector<double> startTimes;
+        unsigned int nbTilesDone;
+        double acceptTime;
+    };
+
+    void acceptWorker ();
+    // The first message of a worker; false if it is to be dropped.
+    bool greetWorker (Worker & worker, Message & hello, const Message & frame);
+    bool handleMessage (Worker & worker, Message & message);
+    // Forgets the local workers that exited; returns how many are running.
+    unsigned int reapLocalWorkers ();
+    void renderTileHere ();
+    void dropWorker (unsigned int w);
+    void assignTiles (Worker & worker);
+    bool pickTile (const Worker & worker, unsigned int & tile);
+    void sendTile (Worker & worker, unsigned int tile);
+    unsigned int countCopies (unsigned int tile) const;
+
+    unsigned short port;
+    Socket listener;
+    std::vector<pid_t> localWorkers;
+    std::string checkpointFilename;
+
+    // State of the frame being rendered.
+    RenderCamera camera;
+    RenderSettings settings;
+    unsigned long long sceneHash;
+    unsigned int frameId;
+    std::vector<Worker> workers;
+    std::vector<unsigned int> queue;
+    std::vector<bool> done;
+    unsigned int nbDone;
+    QImage image;
+    RenderCheckpoint checkpoint;
+};
+
+#endif // RENDERCOORDINATOR_H
+
+// Some Emacs-Hints -- please don't remove:
+//
+//  Local Variables:
+//  mode:C++
+//  tab-width:4
+//  End:
@@ -0,0 +1,83 @@
+// *********************************************************
+// Render Cost Map
+// *********************************************************
+
+#include "RenderCostMap.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <QString>
+
+using namespace std;
+
+void RenderCostMap::reset (unsigned int w, unsigned int h, unsigned int nbTiles) {
+    width = w;
+    height = h;
+    pixels.assign (w * h, 0.0f);
+    TileCost none;
+    none.tile.x0 = none.tile.y0 = none.tile.x1 = none.tile.y1 = 0;
+    none.ns = none.rays = 0;
+    none.rendered = false;
+    tiles.assign (nbTiles, none);
+}
+
+void RenderCostMap::setTile (unsigned int index, const RenderTile & tile, unsigned long long ns, unsigned long long rays) {
+    TileCost & t = tiles[index];
+    t.tile = tile;
+    t.ns = ns;
+    t.rays = rays;
+    t.rendered = true;
+}
+
+// Heat colors, for c in [0,1].
+static inline QRgb heat (float c) {
+    c = std::min (std::max (c, 0.0f), 1.0f);
+    int r = static_cast<int> (255.0f * std::min (1.0f, 3.0f * c));
+    int g = static_cast<int> (255.0f * std::min (1.0f, std::max (0.0f, 3.0f * c - 1.0f)));
+    int b = static_cast<int> (255.0f * std::max (0.0f, 3.0f * c - 2.0f));
+    return qRgb (r, g, b);
+}
+
+QImage RenderCostMap::toImage () const {
+    QImage image (QSize (width, height), QImage::Format_RGB888);
+    vector<float> sorted (pixels);
+    float scale = 0.0f;
+    if (!sorted.empty ()) {
+        unsigned int k = (sorted.size () - 1) * 99 / 100;
+        nth_element (sorted.begin (), sorted.begin () + k, sorted.end ());
+        scale = sorted[k];
+    }
+    for (unsigned int j = 0; j < height; j++)
+        for (unsigned int i = 0; i < width; i++)
+            image.setPixel (i, j, heat (scale > 0.0f ? pixels[j * width + i] / scale : 0.0f));
+    return image;
+}
+
+bool RenderCostMap::save (const string & filename) const {
+    if (!toImage ().save (QString (filename.c_str ())))
+        return false;
+    string csvFilename = filename + ".csv";
+    FILE * csv = fopen (csvFilename.c_str (), "w");
+    if (csv == NULL)
+        return false;
+    fprintf (csv, "tile,x0,y0,x1,y1,ms,rays\n");
+    for (unsigned int t = 0; t < tiles.size (); t++) {
+        const TileCost & c = tiles[t];
+        if (c.rendered)
+            fprintf (csv, "%u,%u,%u,%u,%u,%.3f,%llu\n", t, c.tile.x0, c.tile.y0, c.tile.x1, c.tile.y1,
+                     c.ns / 1e6, c.rays);
+    }
+    return (fclose (csv) == 0);
+}
+
+float RenderCostMap::getImbalance () const {
+    unsigned long long total = 0, highest = 0;
+    unsigned int nbRendered = 0;
+    for (unsigned int t = 0; t < tiles.size (); t++)
+        if (tiles[t].rendered) {
+            total += tiles[t].ns;
+            highest = std::max (highest, tiles[t].ns);
+            nbRendered++;
+        }
+    return (total > 0) ? static_cast<float> (highest) * nbRendered / total : 0.0f;
+}
@@ -0,0 +1,67 @@
+// *********************************************************
+// Render Cost Map
+// Time spent on each pixel and tile of a render, saved as a
+// heatmap image next to the render, with the per tile costs
+// in CSV to check how balanced the tiles are.
+// *********************************************************
+
+#ifndef RENDERCOSTMAP_H
+#define RENDERCOSTMAP_H
+
+#include <string>
+#include <vector>
+#include <ctime>
+#include <QImage>
+
+#include "RenderSettings.h"
+
+class RenderCostMap {
+public:
+    // Monotonic clock, in nanoseconds.
+    static inline unsigned long long now () {
+        timespec ts;
+        clock_gettime (CLOCK_MONOTONIC, &ts);
+        return static_cast<unsigned long long> (ts.tv_sec) * 1000000000ULL + ts.tv_nsec;
+    }
+
+    void reset (unsigned int width, unsigned int height, unsigned int nbTiles);
+
+    inline void setPixel (unsigned int i, unsigned int j, unsigned long long ns) {
+        pixels[j * width + i] = static_cast<float> (ns);
+    }
+    // rays: primary and shadow rays of the tile, see RayTracer::renderTile.
+    void setTile (unsigned int index, const RenderTile & tile, unsigned long long ns, unsigned long long rays);
+
+    // Black (cheapest) to red, yellow and white (at the 99th percentile of
+    // the pixel costs and above). Tiles not rendered (resumed from a
+    // checkpoint) stay black.
+    QImage toImage () const;
+
+    // Writes the heatmap to filename and the tile costs to filename.csv.
+    bool save (const std::string & filename) const;
+
+    // Cost of the most expensive tile relative to the mean one.
+    float getImbalance () const;
+
+private:
+    struct TileCost {
+        RenderTile tile;
+        unsigned long long ns;
+        unsigned long long rays;
+        bool rendered;
+    };
+
+    unsigned int width;
+    unsigned int height;
+    std::vector<float> pixels;
+    std::vector<TileCost> tiles;
+};
+
+#endif // RENDERCOSTMAP_H
+
+// Some Emacs-Hints -- please don't remove:
+//
+//  Local Variables:
+//  mode:C++
+//  tab-width:4
+//  End:
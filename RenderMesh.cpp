@@ -0,0 +1,91 @@
+// *********************************************************
+// Render Mesh Class
+// *********************************************************
+
+#include "RenderMesh.h"
+#include "Trace.h"
+
+#include <cmath>
+
+using namespace std;
+
+RenderMesh::RenderMesh (const Mesh & mesh)
+    : extPositions (NULL), extNormals (NULL), extIndices (NULL), compressed (false) {
+    TraceScope trace ("RenderMesh");
+    const vector<Vertex> & V = mesh.getVertices ();
+    const vector<Triangle> & T = mesh.getTriangles ();
+    nbVertices = V.size ();
+    nbTriangles = T.size ();
+    positions.resize (nbVertices);
+    normals.resize (nbVertices);
+    for (unsigned int i = 0; i < nbVertices; i++) {
+        positions[i] = V[i].getPos ();
+        normals[i] = V[i].getNormal ();
+    }
+    indices.resize (3 * nbTriangles);
+    for (unsigned int i = 0; i < nbTriangles; i++)
+        for (unsigned int j = 0; j < 3; j++)
+            indices[3*i+j] = T[i].getVertex (j);
+}
+
+void RenderMesh::attach (const Vec3Df * p,
+                         const Vec3Df * n,
+                         unsigned int nbV,
+                         const unsigned int * t,
+                         unsigned int nbT) {
+    vector<Vec3Df> ().swap (positions);
+    vector<Vec3Df> ().swap (normals);
+    vector<unsigned int> ().swap (indices);
+    vector<PackedVertex> ().swap (packedVertices);
+    compressed = false;
+    extPositions = p;
+    extNormals = n;
+    extIndices = t;
+    nbVertices = nbV;
+    nbTriangles = nbT;
+}
+
+// Nearest of the 2^16 values spread over [0, 1].
+static inline unsigned short quantize (float x) {
+    x = floor (x * 65535.0f + 0.5f);
+    return static_cast<unsigned short> (x < 0.0f ? 0.0f : (x > 65535.0f ? 65535.0f : x));
+}
+
+// Projection on the octahedron |x| + |y| + |z| = 1, whose lower half is
+// unfolded over the corners of the square, then 16-bit signed values.
+static inline void encodeNormal (const Vec3Df & n, short * e) {
+    float l1 = fabs (n[0]) + fabs (n[1]) + fabs (n[2]);
+    float x = (l1 > 0.0f) ? n[0] / l1 : 0.0f;
+    float y = (l1 > 0.0f) ? n[1] / l1 : 0.0f;
+    if (n[2] < 0.0f) {
+        float fx = (1.0f - fabs (y)) * (x < 0.0f ? -1.0f : 1.0f);
+        float fy = (1.0f - fabs (x)) * (y < 0.0f ? -1.0f : 1.0f);
+        x = fx;
+        y = fy;
+    }
+    e[0] = static_cast<short> (floor (x * 32767.0f + 0.5f));
+    e[1] = static_cast<short> (floor (y * 32767.0f + 0.5f));
+}
+
+void RenderMesh::compress () {
+    TraceScope trace ("RenderMesh::compress");
+    if (compressed || isAttached () || nbVertices == 0)
+        return;
+    BoundingBox box (positions[0]);
+    for (unsigned int i = 1; i < nbVertices; i++)
+        box.extendTo (positions[i]);
+    quantizationMin = box.getMin ();
+    Vec3Df extent = box.getMax () - box.getMin ();
+    for (unsigned int a = 0; a < 3; a++)
+        quantizationStep[a] = extent[a] / 65535.0f;
+    packedVertices.resize (nbVertices);
+    for (unsigned int i = 0; i < nbVertices; i++) {
+        PackedVertex & v = packedVertices[i];
+        for (unsigned int a = 0; a < 3; a++)
+            v.position[a] = (extent[a] > 0.0f) ? quantize ((positions[i][a] - quantizationMin[a]) / extent[a]) : 0;
+        encodeNormal (normals[i], v.normal);
+    }
+    vector<Vec3Df> ().swap (positions);
+    vector<Vec3Df> ().swap (normals);
+    compressed = true;
+}
@@ -0,0 +1,119 @@
+// *********************************************************
+// Render Mesh Class
+// Packed, read-only geometry used by the ray tracer: vertex
+// positions, vertex normals and triangle index triples.
+// Optionally compressed, for the meshes too big for the cache
+// or the memory: 10 bytes per vertex instead of 24, decoded on
+// the fly by the traversal.
+// *********************************************************
+
+#ifndef RENDERMESH_H
+#define RENDERMESH_H
+
+#include <vector>
+
+#include "Vec3D.h"
+#include "Mesh.h"
+#include "BoundingBox.h"
+
+// Vertex of a compressed mesh: the position quantized to 16 bits per axis
+// within the box of the mesh, and the normal octahedral-encoded on two
+// 16-bit signed values.
+struct PackedVertex {
+    unsigned short position[3];
+    short normal[2];
+};
+
+// The arrays are either owned by the RenderMesh, or live in external
+// storage (e.g. a shared memory segment, see SharedScene) which must then
+// outlive it.
+class RenderMesh {
+public:
+    inline RenderMesh ()
+        : nbVertices (0), nbTriangles (0),
+          extPositions (NULL), extNormals (NULL), extIndices (NULL), compressed (false) {}
+    RenderMesh (const Mesh & mesh);
+    virtual ~RenderMesh () {}
+
+    // Drops the owned arrays in favor of a copy living in external storage.
+    void attach (const Vec3Df * positions,
+                 const Vec3Df * normals,
+                 unsigned int nbVertices,
+                 const unsigned int * indices,
+                 unsigned int nbTriangles);
+    inline bool isAttached () const { return extPositions != NULL; }
+
+    // Replaces the positions and normals by packed vertices; getPositions and
+    // getNormals return NULL from then on. The positions move by at most
+    // getQuantizationError on each axis, the same for every triangle that
+    // shares them, which keeps the mesh watertight. Owned arrays only.
+    void compress ();
+    inline bool isCompressed () const { return compressed; }
+    inline const PackedVertex * getPackedVertices () const { return data (packedVertices); }
+    inline Vec3Df getQuantizationError () const { return 0.5f * quantizationStep; }
+
+    // Position and normal of vertex i, whether compressed or not.
+    inline Vec3Df getPosition (unsigned int i) const {
+        return compressed ? decodePosition (packedVertices[i]) : getPositions ()[i];
+    }
+    inline Vec3Df getNormal (unsigned int i) const {
+        return compressed ? decodeNormal (packedVertices[i]) : getNormals ()[i];
+    }
+    inline Vec3Df decodePosition (const PackedVertex & v) const {
+        return Vec3Df (quantizationMin[0] + v.position[0] * quantizationStep[0],
+                       quantizationMin[1] + v.position[1] * quantizationStep[1],
+                       quantizationMin[2] + v.position[2] * quantizationStep[2]);
+    }
+    // Not normalized, as the interpolated normals of the hits.
+    static inline Vec3Df decodeNormal (const PackedVertex & v) {
+        float x = v.normal[0] * (1.0f / 32767.0f);
+        float y = v.normal[1] * (1.0f / 32767.0f);
+        float z = 1.0f - (x < 0.0f ? -x : x) - (y < 0.0f ? -y : y);
+        if (z < 0.0f) {
+            // Lower hemisphere, folded over the diagonals.
+            float fx = (1.0f - (y < 0.0f ? -y : y)) * (x < 0.0f ? -1.0f : 1.0f);
+            float fy = (1.0f - (x < 0.0f ? -x : x)) * (y < 0.0f ? -1.0f : 1.0f);
+            x = fx;
+            y = fy;
+        }
+        return Vec3Df (x, y, z);
+    }
+
+    inline unsigned int getNbVertices () const { return nbVertices; }
+    inline unsigned int getNbTriangles () const { return nbTriangles; }
+    inline const Vec3Df * getPositions () const { return isAttached () ? extPositions : data (positions); }
+    inline const Vec3Df * getNormals () const { return isAttached () ? extNormals : data (normals); }
+    inline const unsigned int * getIndices () const { return isAttached () ? extIndices : data (indices); }
+
+    inline unsigned int getMemorySize () const {
+        return nbVertices * (compressed ? sizeof (PackedVertex) : 2 * sizeof (Vec3Df))
+            + nbTriangles * 3 * sizeof (unsigned int);
+    }
+
+private:
+    template<typename T> static inline const T * data (const std::vector<T> & v) {
+        return v.empty () ? NULL : &v[0];
+    }
+
+    unsigned int nbVertices;
+    unsigned int nbTriangles;
+    std::vector<Vec3Df> positions;
+    std::vector<Vec3Df> normals;
+    std::vector<unsigned int> indices;
+    const Vec3Df * extPositions;
+    const Vec3Df * extNormals;
+    const unsigned int * extIndices;
+    bool compressed;
+    std::vector<PackedVertex> packedVertices;
+    Vec3Df quantizationMin;
+    Vec3Df quantizationStep;
+};
+
+#endif // RENDERMESH_H
+
+// Some Emacs-Hints -- please don't remove:
+//
+//  Local Variables:
+//  mode:C++
+//  tab-width:4
+//  End:
@@ -0,0 +1,72 @@
+// *********************************************************
+// Render Protocol
+// *********************************************************
+
+#include "RenderProtocol.h"
+
+#include <cstring>
+
+using namespace std;
+
+void Message::write (const void * bytes, unsigned int size) {
+    const unsigned char * b = static_cast<const unsigned char *> (bytes);
+    data.insert (data.end (), b, b + size);
+}
+
+void Message::read (void * bytes, unsigned int size) {
+    if (readPos + size > data.size ())
+        throw Exception ("Truncated message.");
+    if (size > 0)
+        memcpy (bytes, &data[readPos], size);
+    readPos += size;
+}
+
+void Message::writeString (const string & s) {
+    write (static_cast<unsigned int> (s.size ()));
+    write (s.data (), s.size ());
+}
+
+string Message::readString () {
+    unsigned int size = read<unsigned int> ();
+    if (readPos + size > data.size ())
+        throw Exception ("Truncated string.");
+    string s (reinterpret_cast<const char *> (&data[0]) + readPos, size);
+    readPos += size;
+    return s;
+}
+
+void Message::writeFrame (const RenderCamera & camera, const RenderSettings & settings, const Vec3Df & backgroundColor) {
+    write (camera.position);
+    write (camera.viewDirection);
+    write (camera.upVector);
+    write (camera.rightVector);
+    write (camera.fieldOfView);
+    write (camera.aspectRatio);
+    write (camera.screenWidth);
+    write (camera.screenHeight);
+    write (static_cast<unsigned int> (settings.softShadows));
+    write (static_cast<unsigned int> (settings.hardShadows));
+    write (settings.nbRaysPerPixel);
+    write (settings.nbPointsDisc);
+    write (settings.tileSize);
+    write (backgroundColor);
+}
+
+void Message::readFrame (RenderCamera & camera, RenderSettings & settings, Vec3Df & backgroundColor) {
+    camera.position = read<Vec3Df> ();
+    camera.viewDirection = read<Vec3Df> ();
+    camera.upVector = read<Vec3Df> ();
+    camera.rightVector = read<Vec3Df> ();
+    camera.fieldOfView = read<float> ();
+    camera.aspectRatio = read<float> ();
+    camera.screenWidth = read<unsigned int> ();
+    camera.screenHeight = read<unsigned int> ();
+    settings.softShadows = (read<unsigned int> () != 0);
+    settings.hardShadows = (read<unsigned int> () != 0);
+    settings.nbRaysPerPixel = read<unsigned int> ();
+    settings.nbPointsDisc = read<unsigned int> ();
+    settings.tileSize = read<unsigned int> ();
+    backgroundColor = read<Vec3Df> ();
+    if (settings.tileSize == 0 || settings.nbRaysPerPixel == 0 || settings.nbPointsDisc == 0)
+        throw Exception ("Invalid render settings.");
+}
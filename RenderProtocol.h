@@ -0,0 +1,81 @@
+// *********************************************************
+// Render Protocol
+// Messages exchanged between raymini processes (tile
+// coordinator and workers, render server and clients).
+// *********************************************************
+
+#ifndef RENDERPROTOCOL_H
+#define RENDERPROTOCOL_H
+
+#include <string>
+#include <vector>
+
+#include "Vec3D.h"
+#include "RenderSettings.h"
+
+// A message is a type and a flat byte payload. Values are written in host
+// byte order: all the processes of a render are expected to run on the same
+// architecture.
+class Message {
+public:
+    enum Type {
+        Hello = 1,   // worker -> coordinator : scene hash
+        Frame,       // coordinator -> worker : camera, settings, background color
+        Tile,        // coordinator -> worker : frame id, tile index
+        Pixels,      // worker -> coordinator : frame id, tile index, RGB pixels
+        Done,        // coordinator -> worker : the frame is complete
+        Error,       // either way : error string
+        Request,     // client -> server : request flags, camera, settings, background color
+        Image        // server -> client : width, height, render time (ms), RGB pixels
+    };
+
+    // Flags of a Message::Request.
+    enum RequestFlag {
+        FitCameraToScene = 1 // the server replaces the camera position and
+                             // orientation by RenderCamera::fitBoundingBox
+    };
+
+    inline Message (unsigned int type = 0) : type (type), readPos (0) {}
+    virtual ~Message () {}
+
+    inline unsigned int getType () const { return type; }
+    inline void setType (unsigned int t) { type = t; }
+    inline std::vector<unsigned char> & getData () { return data; }
+    inline const std::vector<unsigned char> & getData () const { return data; }
+    inline void clear () { data.clear (); readPos = 0; }
+
+    void write (const void * bytes, unsigned int size);
+    void read (void * bytes, unsigned int size);
+
+    template<typename T> inline void write (const T & value) { write (&value, sizeof (T)); }
+    template<typename T> inline T read () { T value; read (&value, sizeof (T)); return value; }
+
+    void writeString (const std::string & s);
+    std::string readString ();
+
+    void writeFrame (const RenderCamera & camera, const RenderSettings & settings, const Vec3Df & backgroundColor);
+    void readFrame (RenderCamera & camera, RenderSettings & settings, Vec3Df & backgroundColor);
+
+    class Exception {
+    private:
+        std::string msg;
+    public:
+        Exception (const std::string & msg) : msg ("[Message Exception]" + msg) {}
+        virtual ~Exception () {}
+        inline const std::string & getMessage () const { return msg; }
+    };
+
+private:
+    unsigned int type;
+    std::vector<unsigned char> data;
+    unsigned int readPos;
+};
+
+#endif // RENDERPROTOCOL_H
+
+// Some Emacs-Hints -- please don't remove:
+//
+//  Local Variables:
+//  mode:C++
+//  tab-width:4
+//  End:
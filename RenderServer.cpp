@@ -0,0 +1,102 @@
+// *********************************************************
+// Render Server Class
+// *********************************************************
+
+#include "RenderServer.h"
+#include "RayTracer.h"
+#include "Scene.h"
+
+#include <iostream>
+#include <vector>
+#include <unistd.h>
+#include <QTime>
+
+using namespace std;
+
+RenderServer::RenderServer () {
+    QTime timer;
+    timer.start ();
+    Scene::getInstance ();
+    cout << "Scene loaded in " << timer.elapsed () << "ms" << endl;
+}
+
+RenderServer::~RenderServer () {
+    if (!path.empty ())
+        unlink (path.c_str ());
+}
+
+bool RenderServer::run (const string & p) {
+    Socket listener;
+    try {
+        listener = Socket::listenLocal (p);
+    } catch (const Socket::Exception & e) {
+        cerr << e.getMessage () << endl;
+        return false;
+    }
+    path = p;
+    cout << "Listening on " << path << endl;
+    while (true) {
+        Socket client;
+        try {
+            client = listener.accept ();
+            serve (client);
+        } catch (const Socket::Exception & e) {
+            cerr << e.getMessage () << endl;
+        }
+        client.close ();
+    }
+    listener.close ();
+    return true;
+}
+
+void RenderServer::serve (Socket & client) {
+    Message request;
+    while (client.receive (request)) {
+        Message answer;
+        try {
+            if (request.getType () != Message::Request)
+                throw Message::Exception ("Unexpected message.");
+            answer = handleRequest (request);
+        } catch (const Message::Exception & e) {
+            answer = Message (Message::Error);
+            answer.writeString (e.getMessage ());
+        }
+        client.send (answer);
+    }
+}
+
+Message RenderServer::handleRequest (Message & request) {
+    RayTracer * rayTracer = RayTracer::getInstance ();
+    unsigned int flags = request.read<unsigned int> ();
+    RenderCamera camera;
+    RenderSettings settings;
+    Vec3Df backgroundColor;
+    request.readFrame (camera, settings, backgroundColor);
+    if (camera.screenWidth == 0 || camera.screenHeight == 0)
+        throw Message::Exception ("Empty frame.");
+    if (flags & Message::FitCameraToScene)
+        camera = RenderCamera::fitBoundingBox (Scene::getInstance ()->getBoundingBox (),
+                                               camera.screenWidth, camera.screenHeight);
+    rayTracer->setSettings (settings);
+    rayTracer->setBackgroundColor (backgroundColor);
+
+    QTime timer;
+    timer.start ();
+    QImage image = rayTracer->render (camera);
+    unsigned int elapsed = timer.elapsed ();
+    cout << "Rendered " << camera.screenWidth << "x" << camera.screenHeight
+         << " in " << elapsed << "ms" << endl;
+
+    RenderTile frame;
+    frame.x0 = frame.y0 = 0;
+    frame.x1 = camera.screenWidth;
+    frame.y1 = camera.screenHeight;
+    vector<unsigned char> pixels;
+    RayTracer::getTilePixels (image, frame, pixels);
+    Message answer (Message::Image);
+    answer.write (camera.screenWidth);
+    answer.write (camera.screenHeight);
+    answer.write (elapsed);
+    answer.write (&pixels[0], pixels.size ());
+    return answer;
+}
@@ -0,0 +1,39 @@
+// *********************************************************
+// Render Server Class
+// Long-running process keeping the scene, its meshes and
+// KD-trees resident, and rendering the frames requested
+// over a Unix domain socket (see RenderClient).
+// *********************************************************
+
+#ifndef RENDERSERVER_H
+#define RENDERSERVER_H
+
+#include <string>
+
+#include "Socket.h"
+
+class RenderServer {
+public:
+    // Loads the scene and builds its acceleration structures.
+    RenderServer ();
+    virtual ~RenderServer ();
+
+    // Serves requests on the socket at path, one client at a time, until
+    // the process is killed. Returns false if the socket cannot be created.
+    bool run (const std::string & path);
+
+private:
+    void serve (Socket & client);
+    Message handleRequest (Message & request);
+
+    std::string path;
+};
+
+#endif // RENDERSERVER_H
+
+// Some Emacs-Hints -- please don't remove:
+//
+//  Local Variables:
+//  mode:C++
+//  tab-width:4
+//  End:
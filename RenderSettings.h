@@ -0,0 +1,124 @@
+// *********************************************************
+// Render Settings
+// Camera and sampling parameters of a ray-traced frame.
+// *********************************************************
+
+#ifndef RENDERSETTINGS_H
+#define RENDERSETTINGS_H
+
+#include <algorithm>
+
+#include "Vec3D.h"
+#include "BoundingBox.h"
+
+// Rectangle of pixels [x0,x1[ x [y0,y1[ rendered as one unit of work.
+struct RenderTile {
+    unsigned int x0, y0, x1, y1;
+};
+
+class RenderCamera {
+public:
+    inline RenderCamera ()
+        : fieldOfView (0.0f), aspectRatio (1.0f), screenWidth (0), screenHeight (0) {}
+    inline RenderCamera (const Vec3Df & position,
+                         const Vec3Df & viewDirection,
+                         const Vec3Df & upVector,
+                         const Vec3Df & rightVector,
+                         float fieldOfView,
+                         float aspectRatio,
+                         unsigned int screenWidth,
+                         unsigned int screenHeight)
+        : position (position), viewDirection (viewDirection),
+          upVector (upVector), rightVector (rightVector),
+          fieldOfView (fieldOfView), aspectRatio (aspectRatio),
+          screenWidth (screenWidth), screenHeight (screenHeight) {}
+
+    // Camera at eye looking at target, with up as close as possible to the
+    // given vertical and a vertical field of view fov (radians).
+    static inline RenderCamera lookAt (const Vec3Df & eye,
+                                       const Vec3Df & target,
+                                       const Vec3Df & up,
+                                       float fov,
+                                       unsigned int width,
+                                       unsigned int height) {
+        RenderCamera c;
+        c.position = eye;
+        c.fieldOfView = fov;
+        c.screenWidth = width;
+        c.screenHeight = height;
+        c.aspectRatio = static_cast<float> (width) / static_cast<float> (height);
+        c.viewDirection = target - eye;
+        c.viewDirection.normalize ();
+        c.rightVector = Vec3Df::crossProduct (c.viewDirection, up);
+        c.rightVector.normalize ();
+        c.upVector = Vec3Df::crossProduct (c.rightVector, c.viewDirection);
+        return c;
+    }
+
+    // Camera used when there is no viewer to take one from: looks at the
+    // center of bbox along (-1,-1,-1), Z up, with the default QGLViewer field
+    // of view, far enough to see the whole box.
+    static inline RenderCamera fitBoundingBox (const BoundingBox & bbox,
+                                               unsigned int width,
+                                               unsigned int height) {
+        float fov = static_cast<float> (M_PI) / 4.0f;
+        Vec3Df direction (-1.0f, -1.0f, -1.0f);
+        direction.normalize ();
+        float distance = std::max (bbox.getRadius (), 0.001f) / sin (fov / 2.0f);
+        return lookAt (bbox.getCenter () - distance * direction, bbox.getCenter (),
+                       Vec3Df (0.0f, 0.0f, 1.0f), fov, width, height);
+    }
+
+    Vec3Df position;
+    Vec3Df viewDirection;
+    Vec3Df upVector;
+    Vec3Df rightVector;
+    float fieldOfView;
+    float aspectRatio;
+    unsigned int screenWidth;
+    unsigned int screenHeight;
+};
+
+class RenderSettings {
+public:
+    enum ShadowMode { NoShadows, HardShadows, SoftShadows };
+
+    inline RenderSettings ()
+        : softShadows (true), hardShadows (false),
+          nbRaysPerPixel (2), nbPointsDisc (20), tileSize (32) {}
+
+    // Soft shadows win when both are set, as in the shading.
+    inline ShadowMode getShadowMode () const {
+        return softShadows ? SoftShadows : (hardShadows ? HardShadows : NoShadows);
+    }
+
+    inline unsigned int getTilesX (unsigned int width) const { return (width + tileSize - 1) / tileSize; }
+    inline unsigned int getTilesY (unsigned int height) const { return (height + tileSize - 1) / tileSize; }
+    inline unsigned int getNbTiles (unsigned int width, unsigned int height) const {
+        return getTilesX (width) * getTilesY (height);
+    }
+    inline RenderTile getTile (unsigned int index, unsigned int width, unsigned int height) const {
+        RenderTile t;
+        unsigned int tilesX = getTilesX (width);
+        t.x0 = (index % tilesX) * tileSize;
+        t.y0 = (index / tilesX) * tileSize;
+        t.x1 = std::min (t.x0 + tileSize, width);
+        t.y1 = std::min (t.y0 + tileSize, height);
+        return t;
+    }
+
+    bool softShadows;
+    bool hardShadows;
+    unsigned int nbRaysPerPixel; // 2 => distribution 2*2, 3 => distribution 3*3, etc
+    unsigned int nbPointsDisc;   // nombre de point répartis aléatoirement sur la source étendue
+    unsigned int tileSize;       // side of the square tiles, in pixels
+};
+
+#endif // RENDERSETTINGS_H
+
+// Some Emacs-Hints -- please don't remove:
+//
+//  Local Variables:
+//  mode:C++
+//  tab-width:4
+//  End:
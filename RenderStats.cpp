@@ -0,0 +1,81 @@
+// *********************************************************
+// Render Statistics
+// *********************************************************
+
+#include "RenderStats.h"
+
+#include <sstream>
+
+using namespace std;
+
+void RenderCounters::add (const RenderCounters & c) {
+    primaryRays += c.primaryRays;
+    shadowRays += c.shadowRays;
+    nodesVisited += c.nodesVisited;
+    leavesVisited += c.leavesVisited;
+    triangleTests += c.triangleTests;
+    mailboxHits += c.mailboxHits;
+    boxTests += c.boxTests;
+    hits += c.hits;
+}
+
+void RenderStats::reset (unsigned int nbObjects, unsigned int nbLights) {
+    rays = RenderCounters ();
+    objects.assign (nbObjects, RenderCounters ());
+    lights.assign (nbLights, RenderCounters ());
+}
+
+void RenderStats::merge (const RenderStats & s) {
+    rays.add (s.rays);
+    if (objects.size () < s.objects.size ())
+        objects.resize (s.objects.size ());
+    for (unsigned int i = 0; i < s.objects.size (); i++)
+        objects[i].add (s.objects[i]);
+    if (lights.size () < s.lights.size ())
+        lights.resize (s.lights.size ());
+    for (unsigned int i = 0; i < s.lights.size (); i++)
+        lights[i].add (s.lights[i]);
+}
+
+RenderCounters RenderStats::getTotal () const {
+    RenderCounters t;
+    for (unsigned int i = 0; i < objects.size (); i++)
+        t.add (objects[i]);
+    t.primaryRays = rays.primaryRays;
+    t.shadowRays = rays.shadowRays;
+    t.hits = rays.hits;
+    return t;
+}
+
+static void printCounters (ostream & out, const RenderCounters & c) {
+    out << c.nodesVisited << " nodes, " << c.leavesVisited << " leaves, "
+        << c.boxTests << " box tests, " << c.triangleTests << " triangle tests ("
+        << c.mailboxHits << " skipped by mailboxing), "
+        << c.hits << " hits";
+}
+
+string RenderStats::getSummary () const {
+    if (!isEnabled ())
+        return "";
+    RenderCounters t = getTotal ();
+    ostringstream s;
+    s << t.primaryRays << " primary rays, " << t.shadowRays << " shadow rays, ";
+    printCounters (s, t);
+    return s.str ();
+}
+
+string RenderStats::getReport () const {
+    if (!isEnabled ())
+        return "Render statistics are disabled (build with RAYMINI_STATS).\n";
+    ostringstream s;
+    s << getSummary () << endl;
+    for (unsigned int i = 0; i < objects.size (); i++) {
+        s << "  object " << i << ": ";
+        printCounters (s, objects[i]);
+        s << endl;
+    }
+    for (unsigned int i = 0; i < lights.size (); i++)
+        s << "  light " << i << ": " << lights[i].shadowRays << " shadow rays, "
+          << lights[i].hits << " occluded" << endl;
+    return s.str ();
+}
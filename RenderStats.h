@@ -0,0 +1,83 @@
+// *********************************************************
+// Render Statistics
+// Ray and traversal counters of a render, in total and per
+// object and light. Counting costs a few increments per node
+// and triangle, so it is only compiled in when RAYMINI_STATS
+// is defined (debug builds, or CONFIG+=stats with qmake);
+// otherwise all the counters stay at 0.
+// *********************************************************
+
+#ifndef RENDERSTATS_H
+#define RENDERSTATS_H
+
+#include <string>
+#include <vector>
+
+#ifdef RAYMINI_STATS
+#define RAYMINI_STAT(statement) do { statement; } while (0)
+#else
+#define RAYMINI_STAT(statement) do {} while (0)
+#endif
+
+struct RenderCounters {
+    inline RenderCounters ()
+        : primaryRays (0), shadowRays (0), nodesVisited (0), leavesVisited (0),
+          triangleTests (0), mailboxHits (0), boxTests (0), hits (0) {}
+
+    void add (const RenderCounters & c);
+
+    unsigned long long primaryRays;
+    unsigned long long shadowRays;
+    unsigned long long nodesVisited;   // KD-tree nodes, leaves included
+    unsigned long long leavesVisited;
+    unsigned long long triangleTests;
+    unsigned long long mailboxHits;    // triangle tests skipped, already done for the ray
+    unsigned long long boxTests;
+    unsigned long long hits;           // rays that hit (an occluder, for shadow rays)
+};
+
+// The rays counters hold the primary and shadow rays and the primary rays
+// that hit the scene. Per object, the counters are those of the rays cast
+// against it; per light, the shadow rays toward it and how many were
+// occluded. Each thread fills its own RenderStats, merged at the end of the
+// render.
+class RenderStats {
+public:
+    static inline bool isEnabled () {
+#ifdef RAYMINI_STATS
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    void reset (unsigned int nbObjects, unsigned int nbLights);
+    void merge (const RenderStats & s);
+
+    inline RenderCounters & getRays () { return rays; }
+    // Rays, with the traversal counters of all the objects.
+    RenderCounters getTotal () const;
+    inline RenderCounters & getObject (unsigned int i) { return objects[i]; }
+    inline const std::vector<RenderCounters> & getObjects () const { return objects; }
+    inline RenderCounters & getLight (unsigned int i) { return lights[i]; }
+    inline const std::vector<RenderCounters> & getLights () const { return lights; }
+
+    // Totals on one line, e.g. for a status bar.
+    std::string getSummary () const;
+    // Totals, then one line per object and per light.
+    std::string getReport () const;
+
+private:
+    RenderCounters rays;
+    std::vector<RenderCounters> objects;
+    std::vector<RenderCounters> lights;
+};
+
+#endif // RENDERSTATS_H
+
+// Some Emacs-Hints -- please don't remove:
+//
+//  Local Variables:
+//  mode:C++
+//  tab-width:4
+//  End:
@@ -0,0 +1,71 @@
+// *********************************************************
+// Render Worker Class
+// *********************************************************
+
+#include "RenderWorker.h"
+#include "RenderProtocol.h"
+#include "RayTracer.h"
+#include "Scene.h"
+#include "Socket.h"
+#include "Trace.h"
+
+#include <iostream>
+#include <vector>
+
+using namespace std;
+
+bool RenderWorker::run (const string & host, unsigned short port) {
+    RayTracer * rayTracer = RayTracer::getInstance ();
+    Scene * scene = Scene::getInstance ();
+    Socket socket;
+    try {
+        socket = Socket::connectTCP (host, port);
+        Message hello (Message::Hello);
+        hello.write (scene->computeHash ());
+        socket.send (hello);
+
+        RenderCamera camera;
+        RenderSettings settings;
+        QImage image;
+        vector<unsigned char> pixels;
+        Message message;
+        while (socket.receive (message)) {
+            if (message.getType () == Message::Frame) {
+                Vec3Df backgroundColor;
+                message.readFrame (camera, settings, backgroundColor);
+                rayTracer->setSettings (settings);
+                rayTracer->setBackgroundColor (backgroundColor);
+                image = QImage (QSize (camera.screenWidth, camera.screenHeight), QImage::Format_RGB888);
+            } else if (message.getType () == Message::Tile) {
+                unsigned int frameId = message.read<unsigned int> ();
+                unsigned int index = message.read<unsigned int> ();
+                if (index >= settings.getNbTiles (camera.screenWidth, camera.screenHeight))
+                    throw Message::Exception ("Tile out of the frame.");
+                RenderTile tile = settings.getTile (index, camera.screenWidth, camera.screenHeight);
+                TraceScope trace ("worker tile", static_cast<int> (index));
+                rayTracer->renderTile (camera, tile, image);
+                RayTracer::getTilePixels (image, tile, pixels);
+                Message answer (Message::Pixels);
+                answer.write (frameId);
+                answer.write (index);
+                answer.write (&pixels[0], pixels.size ());
+                socket.send (answer);
+            } else if (message.getType () == Message::Error) {
+                cerr << "[Coordinator] " << message.readString () << endl;
+                socket.close ();
+                return false;
+            }
+            // Message::Done: nothing to do, wait for the next frame.
+        }
+    } catch (const Socket::Exception & e) {
+        cerr << e.getMessage () << endl;
+        socket.close ();
+        return false;
+    } catch (const Message::Exception & e) {
+        cerr << e.getMessage () << endl;
+        socket.close ();
+        return false;
+    }
+    socket.close ();
+    return true;
+}
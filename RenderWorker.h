@@ -0,0 +1,28 @@
+// *********************************************************
+// Render Worker Class
+// Renders the tiles handed out by a RenderCoordinator.
+// *********************************************************
+
+#ifndef RENDERWORKER_H
+#define RENDERWORKER_H
+
+#include <string>
+
+class RenderWorker {
+public:
+    RenderWorker () {}
+    virtual ~RenderWorker () {}
+
+    // Connects to the coordinator and serves its frames until it hangs up.
+    // Returns false if the coordinator could not be reached or rejected us.
+    bool run (const std::string & host, unsigned short port);
+};
+
+#endif // RENDERWORKER_H
+
+// Some Emacs-Hints -- please don't remove:
+//
+//  Local Variables:
+//  mode:C++
+//  tab-width:4
+//  End:
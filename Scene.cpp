@@ -6,10 +6,23 @@
 // *********************************************************
 
 #include "Scene.h"
+#include "Hash.h"
+#include "SharedScene.h"
+#include "SceneGenerator.h"
+#include "KDTreeTuner.h"
+#include "ThreadPool.h"
+#include "Trace.h"
 
 using namespace std;
 
 static Scene * instance = NULL;
+static string sharedMemoryName;
+static string generatorSpec;
+static bool autoTune = false;
+static bool compressGeometry = false;
+static bool reorderMeshes = false;
+static float cleanTolerance = -1.0f;
+static bool parallelLoading = true;
 
 Scene * Scene::getInstance () {
     if (instance == NULL)
@@ -24,8 +37,98 @@ void Scene::destroyInstance () {
     }
 }
 
-Scene::Scene () {
-    buildDefaultScene ();
+void Scene::setSharedMemoryName (const string & name) {
+    sharedMemoryName = name;
+}
+
+const string & Scene::getSharedMemoryName () {
+    return sharedMemoryName;
+}
+
+void Scene::setGeneratorSpec (const string & spec) {
+    generatorSpec = spec;
+}
+
+const string & Scene::getGeneratorSpec () {
+    return generatorSpec;
+}
+
+void Scene::setAutoTune (bool a) {
+    autoTune = a;
+}
+
+bool Scene::getAutoTune () {
+    return autoTune;
+}
+
+void Scene::setCompressGeometry (bool c) {
+    compressGeometry = c;
+}
+
+bool Scene::getCompressGeometry () {
+    return compressGeometry;
+}
+
+void Scene::setReorderMeshes (bool r) {
+    reorderMeshes = r;
+}
+
+bool Scene::getReorderMeshes () {
+    return reorderMeshes;
+}
+
+void Scene::setCleanTolerance (float t) {
+    cleanTolerance = t;
+}
+
+float Scene::getCleanTolerance () {
+    return cleanTolerance;
+}
+
+void Scene::setParallelLoading (bool p) {
+    parallelLoading = p;
+}
+
+bool Scene::getParallelLoading () {
+    return parallelLoading;
+}
+
+// Ce qui determine le contenu d'une scene partagee : la scene decrite et
+// les options de construction qui changent ses maillages ou ses arbres.
+static unsigned long long sharedFingerprint () {
+    Hash hash;
+    hash.add (generatorSpec);
+    hash.add (autoTune);
+    hash.add (reorderMeshes);
+    hash.add (cleanTolerance);
+    return hash.get ();
+}
+
+Scene::Scene () : readyMs (0.0), nbLoadingThreads (1) {
+    TraceScope trace ("Scene");
+    if (!sharedMemoryName.empty ()) {
+        SharedScene shared (sharedMemoryName, sharedFingerprint ());
+        // Either someone else builds (or has built) the scene, or we do.
+        if (!shared.attach (*this)) {
+            if (shared.create ()) {
+                unsigned long long start = Trace::now ();
+                build ();
+                readyMs = (Trace::now () - start) / 1000.0;
+                shared.publish (*this);
+            } else if (!shared.attach (*this)) {
+                // Another process created the segment between the two calls
+                // but it is gone again, or cannot be removed: give up.
+                throw SharedScene::Exception ("Cannot attach nor create " + sharedMemoryName + ".");
+            }
+        }
+    } else {
+        unsigned long long start = Trace::now ();
+        build ();
+        if (compressGeometry)
+            for (unsigned int i = 0; i < objects.size (); i++)
+                objects[i].compress ();
+        readyMs = (Trace::now () - start) / 1000.0;
+    }
     updateBoundingBox ();
 }
 
@@ -36,52 +139,164 @@ void Scene::updateBoundingBox () {
     if (objects.empty ())
         bbox = BoundingBox ();
     else {
-        bbox = objects[0].getBoundingBox ();
-        for (unsigned int i = 1; i < objects.size (); i++)
-            bbox.extendTo (objects[i].getBoundingBox ());
+        // Boites des objets dans l'espace de la scene
+        for (unsigned int i = 0; i < objects.size (); i++) {
+            const BoundingBox & b = objects[i].getBoundingBox ();
+            BoundingBox translated (b.getMin () + objects[i].getTrans (), b.getMax () + objects[i].getTrans ());
+            if (i == 0)
+                bbox = translated;
+            else
+                bbox.extendTo (translated);
+        }
+    }
+}
+
+unsigned long long Scene::computeHash () const {
+    TraceScope trace ("Scene::computeHash");
+    Hash h;
+    h.add (static_cast<unsigned int> (objects.size ()));
+    for (unsigned int i = 0; i < objects.size (); i++) {
+        const Object & o = objects[i];
+        // The render mesh, not the editable one: processes attached to a
+        // shared scene only have the former.
+        const RenderMesh & mesh = o.getRenderMesh ();
+        h.add (mesh.getNbVertices ());
+        if (mesh.isCompressed ())
+            h.add (mesh.getPackedVertices (), mesh.getNbVertices () * sizeof (PackedVertex));
+        else {
+            h.add (mesh.getPositions (), mesh.getNbVertices () * sizeof (Vec3Df));
+            h.add (mesh.getNormals (), mesh.getNbVertices () * sizeof (Vec3Df));
+        }
+        h.add (mesh.getNbTriangles ());
+        h.add (mesh.getIndices (), 3 * mesh.getNbTriangles () * sizeof (unsigned int));
+        h.add (o.getTrans ());
+        const Material & m = o.getMaterial ();
+        h.add (m.getDiffuse ());
+        h.add (m.getSpecular ());
+        h.add (m.getColor ());
+    }
+    h.add (static_cast<unsigned int> (areaLights.size ()));
+    for (unsigned int i = 0; i < areaLights.size (); i++) {
+        const AreaLight & l = areaLights[i];
+        h.add (l.getPos ());
+        h.add (l.getColor ());
+        h.add (l.getIntensity ());
+        h.add (l.getRayon ());
+        h.add (l.getOrientation ());
+    }
+    return h.get ();
+}
+
+void Scene::build () {
+    if (generatorSpec.empty ())
+        buildDefaultScene ();
+    else {
+        SceneGenerator::Parameters parameters;
+        parameters.parse (generatorSpec);
+        SceneGenerator (parameters).generate (*this);
     }
 }
 
+namespace {
+
+// Un fichier de la scene par defaut, et ce qu'il devient
+struct DefaultAsset {
+    const char * filename;
+    Material material;
+    Vec3Df trans;
+};
+
+// Chargement d'un fichier jusqu'a son objet, dans un job du ThreadPool ou
+// directement : l'objet est construit a sa place dans la scene, les
+// messages et l'exception eventuelle attendent la fin de tous les fichiers.
+class AssetJob : public ThreadPool::Job {
+public:
+    AssetJob () : asset (NULL), object (NULL), start (0), cleaned (false), failed (false), error ("") {}
+    void run ();
+
+    const DefaultAsset * asset;
+    Object * object;
+    unsigned long long start;
+    Scene::AssetTiming timing;
+    bool cleaned;
+    Mesh::CleanReport cleanReport;
+    bool failed;
+    Mesh::Exception error;
+};
+
+void AssetJob::run () {
+    TraceScope trace ("Scene::loadAsset", asset->filename);
+    timing.filename = asset->filename;
+    try {
+        unsigned long long begin = Trace::now ();
+        Mesh mesh;
+        mesh.loadOFF (asset->filename);
+        cleaned = (cleanTolerance >= 0.0f);
+        if (cleaned) {
+            cleanReport = mesh.clean (cleanTolerance);
+            mesh.recomputeSmoothVertexNormals (0);
+        }
+        if (reorderMeshes)
+            mesh.reorderForLocality ();
+        unsigned long long loaded = Trace::now ();
+        object->build (mesh, asset->material, KDTreeTuner::get (asset->filename, mesh, autoTune));
+        object->setTrans (asset->trans);
+        unsigned long long built = Trace::now ();
+        timing.loadMs = (loaded - begin) / 1000.0;
+        timing.buildMs = (built - loaded) / 1000.0;
+        timing.readyMs = (built - start) / 1000.0;
+    } catch (const Mesh::Exception & e) {
+        failed = true;
+        error = e;
+    } catch (...) {
+        // Rien ne doit sortir d'un job : manque de memoire, etc.
+        failed = true;
+        error = Mesh::Exception (string ("Unexpected error while loading ") + asset->filename + ".");
+    }
+}
+
+} // namespace
+
 // Changer ce code pour creer des scenes originales
 void Scene::buildDefaultScene () {
-    Mesh groundMesh;
-    groundMesh.loadOFF ("models/ground.off");
-    Material groundMat;
-    Object ground (groundMesh, groundMat);    
-    objects.push_back (ground);
-/*
-    Mesh ramMesh;
-    ramMesh.loadOFF ("models/ram.off");
-    Material ramMat (1.f, 1.f, Vec3Df (1.f, .6f, .2f));
-    Object ram (ramMesh, ramMat);
-    ram.setTrans (Vec3Df (1.f, 0.5f, 0.f));
-    objects.push_back (ram);
-*/
-    Mesh monkeyMesh;
-    monkeyMesh.loadOFF ("models/monkey.off");
-    Material ramMat (1.f, 1.f, Vec3Df (1.f, .6f, .2f));
-    Object monkey (monkeyMesh, ramMat);
-    monkey.setTrans (Vec3Df (0.0f, 0.0f, 1.0f));
-    objects.push_back (monkey);
-/*
-    Mesh rhinoMesh;
-    rhinoMesh.loadOFF ("models/rhino.off");
-    Material rhinoMat (1.0f, 0.2f, Vec3Df (0.6f, 0.6f, 0.7f));
-    Object rhino (rhinoMesh, rhinoMat);
-    rhino.setTrans (Vec3Df (-1.f, -1.0f, 0.4f));
-    objects.push_back (rhino);
-    Mesh gargMesh;
-    gargMesh.loadOFF ("models/gargoyle.off");
-    Material gargMat (0.7f, 0.4f, Vec3Df (0.5f, 0.8f, 0.5f));
-    Object garg (gargMesh, gargMat);
-    garg.setTrans (Vec3Df (-1.f, 1.0f, 0.1f));
-    objects.push_back (garg);
-    Mesh test;
-    test.loadOFF ("models/testMesh2.off");
-    Material groundMat;
-    Object testObject (test, groundMat);    
-    objects.push_back (testObject);
-*/
+    const DefaultAsset assets[] = {
+        { "models/ground.off", Material (), Vec3Df (0.0f, 0.0f, 0.0f) },
+        // { "models/ram.off", Material (1.f, 1.f, Vec3Df (1.f, .6f, .2f)), Vec3Df (1.f, 0.5f, 0.f) },
+        { "models/monkey.off", Material (1.f, 1.f, Vec3Df (1.f, .6f, .2f)), Vec3Df (0.0f, 0.0f, 1.0f) },
+        // { "models/rhino.off", Material (1.0f, 0.2f, Vec3Df (0.6f, 0.6f, 0.7f)), Vec3Df (-1.f, -1.0f, 0.4f) },
+        // { "models/gargoyle.off", Material (0.7f, 0.4f, Vec3Df (0.5f, 0.8f, 0.5f)), Vec3Df (-1.f, 1.0f, 0.1f) },
+        // { "models/testMesh2.off", Material (), Vec3Df (0.0f, 0.0f, 0.0f) },
+    };
+    const unsigned int nbAssets = sizeof (assets) / sizeof (assets[0]);
+
+    // Tous les fichiers en meme temps, chacun normales et arbre compris :
+    // la scene est prete quand le plus long l'est.
+    objects.resize (nbAssets);
+    vector<AssetJob> jobs (nbAssets);
+    unsigned long long start = Trace::now ();
+    for (unsigned int i = 0; i < nbAssets; i++) {
+        jobs[i].asset = &assets[i];
+        jobs[i].object = &objects[i];
+        jobs[i].start = start;
+    }
+    if (parallelLoading && !autoTune) {
+        ThreadPool & pool = ThreadPool::getInstance ();
+        ThreadPool::Group group (pool);
+        for (unsigned int i = 0; i < nbAssets; i++)
+            group.add (jobs[i]);
+        group.wait ();
+        nbLoadingThreads = pool.getNbThreads ();
+    } else
+        for (unsigned int i = 0; i < nbAssets; i++)
+            jobs[i].run ();
+    for (unsigned int i = 0; i < nbAssets; i++) {
+        if (jobs[i].failed)
+            throw jobs[i].error;
+        if (jobs[i].cleaned)
+            cout << "Cleaned " << assets[i].filename << ": " << jobs[i].cleanReport << endl;
+        assetTimings.push_back (jobs[i].timing);
+    }
+
     Light l (Vec3Df (3.0f, 3.0f, 3.0f), Vec3Df (1.0f, 1.0f, 1.0f), 1.0f);
     lights.push_back (l);
 
@@ -10,6 +10,7 @@
 
 #include <iostream>
 #include <vector>
+#include <string>
 
 #include "Object.h"
 #include "AreaLight.h"
@@ -19,6 +20,59 @@ class Scene {
 public:
     static Scene * getInstance ();
     static void destroyInstance ();
+
+    // When set before the first getInstance, the scene is mapped from (or
+    // published to) the shared memory segment of that name, see SharedScene.
+    static void setSharedMemoryName (const std::string & name);
+    static const std::string & getSharedMemoryName ();
+
+    // When set before the first getInstance, the scene is generated by a
+    // SceneGenerator with these parameters instead of the default scene.
+    static void setGeneratorSpec (const std::string & spec);
+    static const std::string & getGeneratorSpec ();
+
+    // When set before the first getInstance, the KD-tree build parameters
+    // of the meshes without a cached tuning are searched, see KDTreeTuner.
+    static void setAutoTune (bool autoTune);
+    static bool getAutoTune ();
+
+    // When set before the first getInstance, the objects are compressed
+    // once built (Object::compress), unless the scene is shared: for the
+    // scenes that do not fit in memory otherwise.
+    static void setCompressGeometry (bool compress);
+    static bool getCompressGeometry ();
+
+    // When set before the first getInstance, the meshes loaded from files
+    // are reordered for locality (Mesh::reorderForLocality).
+    static void setReorderMeshes (bool reorder);
+    static bool getReorderMeshes ();
+
+    // When set before the first getInstance, the meshes loaded from files
+    // are cleaned (Mesh::clean) with this weld tolerance, and what was
+    // removed is printed. Negative, the default: not cleaned.
+    static void setCleanTolerance (float weldTolerance);
+    static float getCleanTolerance ();
+
+    // When set, the default, before the first getInstance: the files of the
+    // default scene are loaded and their trees built concurrently on the
+    // ThreadPool. Otherwise one after the other, as with -autotune, whose
+    // timings need the machine to themselves.
+    static void setParallelLoading (bool parallel);
+    static bool getParallelLoading ();
+
+    // Startup of the default scene, per file.
+    struct AssetTiming {
+        std::string filename;
+        double loadMs;   // read, cleaned, reordered, with its normals
+        double buildMs;  // tree parameters, render mesh and tree
+        double readyMs;  // since the start of the scene
+    };
+    inline const std::vector<AssetTiming> & getAssetTimings () const { return assetTimings; }
+    // From the start of the scene to its last object; 0 for a scene mapped
+    // from shared memory.
+    inline double getReadyMs () const { return readyMs; }
+    // Threads that loaded the files, 1 on the serial path.
+    inline unsigned int getNbLoadingThreads () const { return nbLoadingThreads; }
     
     inline std::vector<Object> & getObjects () { return objects; }
     inline const std::vector<Object> & getObjects () const { return objects; }
@@ -31,17 +85,25 @@ public:
 
     inline const BoundingBox & getBoundingBox () const { return bbox; }
     void updateBoundingBox ();
+
+    // Fingerprint of the geometry, materials and lights, used to make sure a
+    // saved render state belongs to this scene.
+    unsigned long long computeHash () const;
     
 protected:
     Scene ();
     virtual ~Scene ();
     
 private:
+    void build ();
     void buildDefaultScene ();
     std::vector<Object> objects;
     std::vector<Light> lights;
     std::vector<AreaLight> areaLights;
     BoundingBox bbox;
+    std::vector<AssetTiming> assetTimings;
+    double readyMs;
+    unsigned int nbLoadingThreads;
 };
 
 
@@ -0,0 +1,196 @@
+// *********************************************************
+// Scene Generator Class
+// *********************************************************
+
+#include "SceneGenerator.h"
+#include "Scene.h"
+#include "KDTreeTuner.h"
+#include "Trace.h"
+
+#include <cmath>
+#include <cstdlib>
+#include <sstream>
+#include <vector>
+
+using namespace std;
+
+// Distance between neighbor instances of the uniform placement (the blobs
+// have a radius of about 1).
+static const float INSTANCE_SPACING = 3.0f;
+
+// Same numbers on every platform, unlike rand ().
+class GeneratorRandom {
+public:
+    GeneratorRandom (unsigned int seed) : state (seed * 2654435761u + 1) {}
+    // Uniform in [0,1[.
+    float uniform () {
+        state = state * 1664525u + 1013904223u;
+        return (state >> 8) * (1.0f / 16777216.0f);
+    }
+    float uniform (float a, float b) { return a + (b - a) * uniform (); }
+    float gaussian () {
+        float u = std::max (uniform (), 1e-7f);
+        return sqrt (-2.0f * log (u)) * cos (2.0f * static_cast<float> (M_PI) * uniform ());
+    }
+private:
+    unsigned int state;
+};
+
+SceneGenerator::Parameters::Parameters ()
+    : nbInstances (100), nbTrianglesPerMesh (1000), nbMeshes (8),
+      placement (Uniform), nbClusters (4), nbAreaLights (1), ground (true), seed (1) {}
+
+void SceneGenerator::Parameters::parse (const string & spec) {
+    istringstream items (spec);
+    string item;
+    while (getline (items, item, ',')) {
+        size_t equal = item.find ('=');
+        if (equal == string::npos)
+            throw Exception ("Expected key=value: " + item);
+        string key = item.substr (0, equal);
+        string value = item.substr (equal + 1);
+        unsigned int n = strtoul (value.c_str (), NULL, 10);
+        if (key == "instances")
+            nbInstances = n;
+        else if (key == "triangles")
+            nbTrianglesPerMesh = n;
+        else if (key == "meshes")
+            nbMeshes = n;
+        else if (key == "clusters")
+            nbClusters = n;
+        else if (key == "lights")
+            nbAreaLights = n;
+        else if (key == "ground")
+            ground = (n != 0);
+        else if (key == "seed")
+            seed = n;
+        else if (key == "placement" && (value == "uniform" || value == "clustered"))
+            placement = (value == "uniform" ? Uniform : Clustered);
+        else
+            throw Exception ("Unknown parameter: " + item);
+    }
+    if (nbMeshes == 0 || nbClusters == 0)
+        throw Exception ("meshes and clusters must be positive.");
+}
+
+string SceneGenerator::Parameters::toString () const {
+    ostringstream s;
+    s << "instances=" << nbInstances << ",triangles=" << nbTrianglesPerMesh
+      << ",meshes=" << nbMeshes
+      << ",placement=" << (placement == Uniform ? "uniform" : "clustered")
+      << ",clusters=" << nbClusters << ",lights=" << nbAreaLights
+      << ",ground=" << (ground ? 1 : 0) << ",seed=" << seed;
+    return s.str ();
+}
+
+Mesh SceneGenerator::makeBlob (unsigned int nbTriangles, unsigned int seed) {
+    // Latitude rings between two poles closed by triangle fans:
+    // 2 * nbSegments * (nbRings - 1) triangles with nbSegments = 2 * nbRings.
+    unsigned int nbRings = std::max (2u, static_cast<unsigned int> (ceil ((1.0 + sqrt (1.0 + nbTriangles)) / 2.0)));
+    unsigned int nbSegments = 2 * nbRings;
+    GeneratorRandom random (seed);
+    // A few random bumps, smooth over the sphere.
+    Vec3Df bumps[4];
+    for (unsigned int b = 0; b < 4; b++) {
+        bumps[b] = Vec3Df (random.uniform (-1.f, 1.f), random.uniform (-1.f, 1.f), random.uniform (-1.f, 1.f));
+        bumps[b].normalize ();
+    }
+    vector<Vertex> V;
+    vector<Triangle> T;
+    for (unsigned int r = 0; r <= nbRings; r++) {
+        float theta = static_cast<float> (M_PI) * r / nbRings;
+        unsigned int nbOnRing = (r == 0 || r == nbRings) ? 1 : nbSegments;
+        for (unsigned int s = 0; s < nbOnRing; s++) {
+            float phi = 2.0f * static_cast<float> (M_PI) * s / nbSegments;
+            Vec3Df d (sin (theta) * cos (phi), sin (theta) * sin (phi), cos (theta));
+            float radius = 1.0f;
+            for (unsigned int b = 0; b < 4; b++)
+                radius += 0.15f * Vec3Df::dotProduct (d, bumps[b]) * Vec3Df::dotProduct (d, bumps[b]);
+            V.push_back (Vertex (radius / 1.3f * d));
+        }
+    }
+    unsigned int bottom = V.size () - 1;
+    for (unsigned int s = 0; s < nbSegments; s++) {
+        unsigned int next = (s + 1) % nbSegments;
+        T.push_back (Triangle (0, 1 + s, 1 + next));
+        for (unsigned int r = 1; r + 1 < nbRings; r++) {
+            unsigned int a = 1 + (r - 1) * nbSegments;
+            unsigned int b = 1 + r * nbSegments;
+            T.push_back (Triangle (a + s, b + s, b + next));
+            T.push_back (Triangle (a + s, b + next, a + next));
+        }
+        unsigned int last = 1 + (nbRings - 2) * nbSegments;
+        T.push_back (Triangle (last + s, bottom, last + next));
+    }
+    Mesh mesh (V, T);
+    mesh.recomputeSmoothVertexNormals (0);
+    return mesh;
+}
+
+void SceneGenerator::generate (Scene & scene) const {
+    TraceScope trace ("SceneGenerator::generate", parameters.toString ());
+    const Parameters & p = parameters;
+    GeneratorRandom random (p.seed);
+    float side = INSTANCE_SPACING * std::max (1.0f, sqrt (static_cast<float> (p.nbInstances)));
+
+    vector<Object> & objects = scene.getObjects ();
+    objects.clear ();
+    objects.reserve (p.nbInstances + (p.ground ? 1 : 0));
+    if (p.ground) {
+        float h = side / 2.0f + INSTANCE_SPACING;
+        vector<Vertex> V;
+        V.push_back (Vertex (Vec3Df (-h, -h, 0.0f), Vec3Df (0.0f, 0.0f, 1.0f)));
+        V.push_back (Vertex (Vec3Df (h, -h, 0.0f), Vec3Df (0.0f, 0.0f, 1.0f)));
+        V.push_back (Vertex (Vec3Df (h, h, 0.0f), Vec3Df (0.0f, 0.0f, 1.0f)));
+        V.push_back (Vertex (Vec3Df (-h, h, 0.0f), Vec3Df (0.0f, 0.0f, 1.0f)));
+        vector<Triangle> T;
+        T.push_back (Triangle (0, 1, 2));
+        T.push_back (Triangle (0, 2, 3));
+        objects.push_back (Object (Mesh (V, T), Material ()));
+    }
+
+    unsigned int nbMeshes = std::min (p.nbMeshes, std::max (p.nbInstances, 1u));
+    vector<Mesh> meshes (nbMeshes);
+    vector<Material> materials (nbMeshes);
+    vector<KDBuildParameters> kdParameters (nbMeshes);
+    for (unsigned int m = 0; m < nbMeshes; m++) {
+        meshes[m] = makeBlob (p.nbTrianglesPerMesh, p.seed * 7919 + m);
+        // No file to cache the result in: tuned again on every run.
+        if (Scene::getAutoTune ())
+            kdParameters[m] = KDTreeTuner::tune (meshes[m]);
+        materials[m] = Material (random.uniform (0.5f, 1.0f), random.uniform (0.0f, 1.0f),
+                                 Vec3Df (random.uniform (0.2f, 1.0f), random.uniform (0.2f, 1.0f), random.uniform (0.2f, 1.0f)));
+    }
+
+    vector<Vec3Df> clusters (p.nbClusters);
+    for (unsigned int c = 0; c < p.nbClusters; c++)
+        clusters[c] = Vec3Df (random.uniform (-side / 2.f, side / 2.f), random.uniform (-side / 2.f, side / 2.f), 0.0f);
+    float sigma = side / (4.0f * sqrt (static_cast<float> (p.nbClusters)));
+    for (unsigned int i = 0; i < p.nbInstances; i++) {
+        Vec3Df position;
+        if (p.placement == Uniform)
+            position = Vec3Df (random.uniform (-side / 2.f, side / 2.f), random.uniform (-side / 2.f, side / 2.f), 0.0f);
+        else {
+            const Vec3Df & center = clusters[i % p.nbClusters];
+            position = center + Vec3Df (sigma * random.gaussian (), sigma * random.gaussian (), 0.0f);
+        }
+        position[2] = 1.0f;
+        unsigned int m = i % nbMeshes;
+        Object o (meshes[m], materials[m], kdParameters[m]);
+        o.setTrans (position);
+        objects.push_back (o);
+    }
+
+    // Total intensity of 1 whatever the number of lights.
+    scene.getLights ().clear ();
+    scene.getAreaLights ().clear ();
+    for (unsigned int l = 0; l < p.nbAreaLights; l++) {
+        float angle = 2.0f * static_cast<float> (M_PI) * l / p.nbAreaLights;
+        Vec3Df pos (side / 2.f * cos (angle), side / 2.f * sin (angle), side / 2.f + INSTANCE_SPACING);
+        Vec3Df color (1.0f, 1.0f, 1.0f);
+        float intensity = 1.0f / p.nbAreaLights;
+        scene.getLights ().push_back (Light (pos, color, intensity));
+        scene.getAreaLights ().push_back (AreaLight (pos, color, intensity, 1.0f, -1.0f * pos));
+    }
+    scene.updateBoundingBox ();
+}
@@ -0,0 +1,74 @@
+// *********************************************************
+// Scene Generator Class
+// Builds synthetic scenes of any size, to measure how loading,
+// building and rendering scale with the number of objects,
+// triangles and lights.
+// *********************************************************
+
+#ifndef SCENEGENERATOR_H
+#define SCENEGENERATOR_H
+
+#include <string>
+
+#include "Mesh.h"
+
+class Scene;
+
+// The objects are randomly deformed spheres standing on a ground quad,
+// placed uniformly or in clusters; the area lights are spread on a circle
+// above them. The same parameters always give the same scene.
+class SceneGenerator {
+public:
+    enum Placement { Uniform = 0, Clustered = 1 };
+
+    struct Parameters {
+        Parameters ();
+
+        // Reads a comma separated list of key=value, e.g.
+        // "instances=1000,triangles=5000,placement=clustered,lights=4".
+        // Keys: instances, triangles, meshes, placement (uniform|clustered),
+        // clusters, lights, ground (0|1), seed. Throws on unknown keys.
+        void parse (const std::string & spec);
+        std::string toString () const;
+
+        unsigned int nbInstances;
+        unsigned int nbTrianglesPerMesh;  // approximate
+        unsigned int nbMeshes;            // distinct shapes, reused by the instances
+        Placement placement;
+        unsigned int nbClusters;
+        unsigned int nbAreaLights;
+        bool ground;
+        unsigned int seed;
+    };
+
+    SceneGenerator (const Parameters & parameters) : parameters (parameters) {}
+    virtual ~SceneGenerator () {}
+
+    // Replaces the objects and lights of scene.
+    void generate (Scene & scene) const;
+
+    // A closed sphere of about nbTriangles triangles whose radius varies
+    // randomly around 1.
+    static Mesh makeBlob (unsigned int nbTriangles, unsigned int seed);
+
+    class Exception {
+    private:
+        std::string msg;
+    public:
+        Exception (const std::string & msg) : msg ("[SceneGenerator Exception]" + msg) {}
+        virtual ~Exception () {}
+        inline const std::string & getMessage () const { return msg; }
+    };
+
+private:
+    Parameters parameters;
+};
+
+#endif // SCENEGENERATOR_H
+
+// Some Emacs-Hints -- please don't remove:
+//
+//  Local Variables:
+//  mode:C++
+//  tab-width:4
+//  End:
@@ -0,0 +1,170 @@
+// *********************************************************
+// Scene Report
+// *********************************************************
+
+#include "SceneReport.h"
+#include "Scene.h"
+
+#include <sstream>
+#include <iomanip>
+
+using namespace std;
+
+KDTreeReport::KDTreeReport ()
+    : nbNodes (0), nbLeaves (0), nbEmptyLeaves (0), maxDepth (0), nbReferences (0),
+      duplication (0.0f), mailbox (false), sahCost (0.0f), nodeBytes (0), indexBytes (0) {}
+
+void KDTreeReport::compute (const KDTree & tree, unsigned int nbMeshTriangles) {
+    *this = KDTreeReport ();
+    const KDFlatNode * nodes = tree.getNodes ();
+    nbNodes = tree.getNbNodes ();
+    nodeBytes = static_cast<unsigned long long> (nbNodes) * sizeof (KDFlatNode);
+    indexBytes = tree.getIndexMemorySize ();
+    mailbox = tree.useMailbox ();
+    if (nodes == NULL || nbNodes == 0)
+        return;
+
+    // Depth first from the root, with the depth of each node on the stack.
+    float rootArea = nodes[0].bBox.getArea ();
+    vector<pair<unsigned int, unsigned int> > stack (1, make_pair (0u, 0u));
+    while (!stack.empty ()) {
+        unsigned int index = stack.back ().first;
+        unsigned int depth = stack.back ().second;
+        stack.pop_back ();
+        const KDFlatNode & n = nodes[index];
+        float area = (rootArea > 0.0f) ? n.bBox.getArea () / rootArea : 1.0f;
+        if (!n.leaf) {
+            sahCost += KD_TRAVERSAL_COST * area;
+            stack.push_back (make_pair (n.child, depth + 1));
+            stack.push_back (make_pair (n.child + 1, depth + 1));
+            continue;
+        }
+        nbLeaves++;
+        nbReferences += n.nbTriangles;
+        sahCost += KD_INTERSECTION_COST * n.nbTriangles * area;
+        if (depth >= depthHistogram.size ())
+            depthHistogram.resize (depth + 1, 0);
+        depthHistogram[depth]++;
+        maxDepth = std::max (maxDepth, depth);
+        unsigned int bucket = 0;
+        while ((1u << bucket) <= n.nbTriangles)
+            bucket++;
+        if (bucket >= leafSizeHistogram.size ())
+            leafSizeHistogram.resize (bucket + 1, 0);
+        leafSizeHistogram[bucket]++;
+        if (n.nbTriangles == 0)
+            nbEmptyLeaves++;
+    }
+    duplication = (nbMeshTriangles > 0) ? static_cast<float> (nbReferences) / nbMeshTriangles : 0.0f;
+}
+
+static string printBytes (unsigned long long bytes) {
+    ostringstream s;
+    s << fixed << setprecision (1);
+    if (bytes >= 1024ULL * 1024ULL)
+        s << bytes / (1024.0 * 1024.0) << " MiB";
+    else if (bytes >= 1024ULL)
+        s << bytes / 1024.0 << " KiB";
+    else
+        s << bytes << " B";
+    return s.str ();
+}
+
+string KDTreeReport::toString () const {
+    ostringstream s;
+    s << nbNodes << " nodes, " << nbLeaves << " leaves (" << nbEmptyLeaves << " empty), depth "
+      << maxDepth << ", " << nbReferences << " triangle references (x" << fixed << setprecision (2)
+      << duplication << (mailbox ? ", mailboxing" : "") << "), SAH cost " << sahCost << ", " << printBytes (nodeBytes) << " of nodes, "
+      << printBytes (indexBytes) << " of indices" << endl;
+    s << "    leaves per depth:";
+    for (unsigned int d = 0; d < depthHistogram.size (); d++)
+        if (depthHistogram[d] > 0)
+            s << " " << d << ":" << depthHistogram[d];
+    s << endl << "    leaves per size:";
+    for (unsigned int b = 0; b < leafSizeHistogram.size (); b++) {
+        if (leafSizeHistogram[b] == 0)
+            continue;
+        if (b == 0)
+            s << " 0:";
+        else if (b == 1)
+            s << " 1:";
+        else
+            s << " " << (1u << (b - 1)) << "-" << (1u << b) - 1 << ":";
+        s << leafSizeHistogram[b];
+    }
+    s << endl;
+    return s.str ();
+}
+
+ObjectMemory::ObjectMemory ()
+    : meshVertexBytes (0), meshTriangleBytes (0), renderMeshBytes (0),
+      kdNodeBytes (0), kdIndexBytes (0), editableMesh (false), shared (false), compressed (false) {}
+
+void ObjectMemory::compute (const Object & o) {
+    const Mesh & mesh = o.getMesh ();
+    const KDTree & tree = o.getKDTree ();
+    meshVertexBytes = static_cast<unsigned long long> (mesh.getVertices ().size ()) * sizeof (Vertex);
+    meshTriangleBytes = static_cast<unsigned long long> (mesh.getTriangles ().size ()) * sizeof (Triangle);
+    renderMeshBytes = o.getRenderMesh ().getMemorySize ();
+    kdNodeBytes = static_cast<unsigned long long> (tree.getNbNodes ()) * sizeof (KDFlatNode);
+    kdIndexBytes = tree.getIndexMemorySize ();
+    editableMesh = !mesh.getVertices ().empty () || !mesh.getTriangles ().empty ();
+    shared = o.getRenderMesh ().isAttached () || tree.isAttached ();
+    compressed = o.getRenderMesh ().isCompressed ();
+}
+
+unsigned long long ObjectMemory::getTotal () const {
+    return meshVertexBytes + meshTriangleBytes + renderMeshBytes + kdNodeBytes + kdIndexBytes;
+}
+
+string SceneReport::get (const Scene & scene) {
+    const vector<Object> & objects = scene.getObjects ();
+    ostringstream s;
+    ObjectMemory total;
+    unsigned long long sharedBytes = 0;
+    unsigned int nbTriangles = 0;
+    bool editableMeshes = false;
+    for (unsigned int i = 0; i < objects.size (); i++) {
+        const Object & o = objects[i];
+        // The render mesh, the one every process has and the tree indexes.
+        const RenderMesh & mesh = o.getRenderMesh ();
+        unsigned int nbMeshTriangles = mesh.getNbTriangles ();
+        KDTreeReport tree;
+        tree.compute (o.getKDTree (), nbMeshTriangles);
+        ObjectMemory memory;
+        memory.compute (o);
+        s << "object " << i << ": " << mesh.getNbVertices () << " vertices, "
+          << nbMeshTriangles << " triangles, " << printBytes (memory.getTotal ())
+          << (memory.editableMesh ? "" : " (no editable mesh)")
+          << (memory.shared ? " (render mesh and tree shared)" : "")
+          << (memory.compressed ? " (render mesh and tree compressed)" : "") << endl
+          << "  kd-tree: " << tree.toString ();
+        total.meshVertexBytes += memory.meshVertexBytes;
+        total.meshTriangleBytes += memory.meshTriangleBytes;
+        total.renderMeshBytes += memory.renderMeshBytes;
+        total.kdNodeBytes += memory.kdNodeBytes;
+        total.kdIndexBytes += memory.kdIndexBytes;
+        if (memory.shared)
+            sharedBytes += memory.renderMeshBytes + memory.kdNodeBytes + memory.kdIndexBytes;
+        nbTriangles += nbMeshTriangles;
+        editableMeshes = editableMeshes || memory.editableMesh;
+    }
+    s << "scene: " << objects.size () << " objects, " << nbTriangles << " triangles, "
+      << printBytes (total.getTotal ()) << endl
+      << "  mesh vertices   " << (editableMeshes ? printBytes (total.meshVertexBytes) : "absent") << endl
+      << "  mesh triangles  " << (editableMeshes ? printBytes (total.meshTriangleBytes) : "absent") << endl
+      << "  render meshes   " << printBytes (total.renderMeshBytes) << endl
+      << "  kd-tree nodes   " << printBytes (total.kdNodeBytes) << endl
+      << "  kd-tree indices " << printBytes (total.kdIndexBytes) << endl;
+    if (sharedBytes > 0)
+        s << "  (" << printBytes (sharedBytes) << " of it in shared memory)" << endl;
+    const vector<Scene::AssetTiming> & timings = scene.getAssetTimings ();
+    if (!timings.empty ()) {
+        s << fixed << setprecision (1) << "startup: ready in " << scene.getReadyMs () << " ms, files loaded on "
+          << scene.getNbLoadingThreads () << (scene.getNbLoadingThreads () > 1 ? " threads" : " thread") << endl;
+        for (unsigned int i = 0; i < timings.size (); i++)
+            s << "  " << timings[i].filename << ": loaded in " << timings[i].loadMs << " ms, tree built in "
+              << timings[i].buildMs << " ms, ready at " << timings[i].readyMs << " ms" << endl;
+    }
+    return s.str ();
+}
@@ -0,0 +1,75 @@
+// *********************************************************
+// Scene Report
+// Quality of the KD-trees and memory used by the scene, to
+// tune the tree build and to size the render machines, and
+// the startup time of the default scene.
+// *********************************************************
+
+#ifndef SCENEREPORT_H
+#define SCENEREPORT_H
+
+#include <string>
+#include <vector>
+
+class KDTree;
+class Object;
+class Scene;
+
+// Measured on the flattened tree.
+struct KDTreeReport {
+    KDTreeReport ();
+    void compute (const KDTree & tree, unsigned int nbMeshTriangles);
+    std::string toString () const;
+
+    unsigned int nbNodes;
+    unsigned int nbLeaves;
+    unsigned int nbEmptyLeaves;
+    unsigned int maxDepth;
+    // Leaves per depth.
+    std::vector<unsigned int> depthHistogram;
+    // Bucket 0: empty leaves, bucket b > 0: leaves of [2^(b-1), 2^b[ triangles.
+    std::vector<unsigned int> leafSizeHistogram;
+    // Triangle references of the leaves, over the triangles of the mesh.
+    unsigned long long nbReferences;
+    float duplication;
+    // Above KD_MAILBOX_DUPLICATION, the traversal skips the repeated tests.
+    bool mailbox;
+    // Expected cost of a ray entering the root, see KD_TRAVERSAL_COST.
+    float sahCost;
+    unsigned long long nodeBytes;
+    unsigned long long indexBytes;
+};
+
+struct ObjectMemory {
+    ObjectMemory ();
+    void compute (const Object & o);
+    unsigned long long getTotal () const;
+
+    unsigned long long meshVertexBytes;
+    unsigned long long meshTriangleBytes;
+    unsigned long long renderMeshBytes;
+    unsigned long long kdNodeBytes;
+    unsigned long long kdIndexBytes;
+    // The editable Mesh is loaded: not in the processes attached to a
+    // shared scene, which only map the render mesh.
+    bool editableMesh;
+    // The render mesh and the tree live in a shared memory segment.
+    bool shared;
+    // See Object::compress.
+    bool compressed;
+};
+
+class SceneReport {
+public:
+    // One block per object, then the scene totals and the startup.
+    static std::string get (const Scene & scene);
+};
+
+#endif // SCENEREPORT_H
+
+// Some Emacs-Hints -- please don't remove:
+//
+//  Local Variables:
+//  mode:C++
+//  tab-width:4
+//  End:
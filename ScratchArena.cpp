@@ -0,0 +1,73 @@
+// *********************************************************
+// Scratch Arena
+// *********************************************************
+
+#include "ScratchArena.h"
+
+#include <cstdlib>
+#include <new>
+#include <pthread.h>
+
+using namespace std;
+
+static void * allocateAligned (size_t size) {
+    void * p = NULL;
+    if (posix_memalign (&p, ScratchArena::ALIGNMENT, size) != 0)
+        throw bad_alloc ();
+    return p;
+}
+
+ScratchArena::ScratchArena (size_t capacity)
+    : block (static_cast<char *> (allocateAligned (capacity))), capacity (capacity), used (0),
+      overflows (NULL), overflowSize (0), nbOverflows (0) {}
+
+ScratchArena::~ScratchArena () {
+    reset ();
+    free (block);
+}
+
+void * ScratchArena::allocateOverflow (size_t size) {
+    // The link goes in the first ALIGNMENT bytes, to keep the data aligned.
+    Overflow * o = static_cast<Overflow *> (allocateAligned (ALIGNMENT + size));
+    o->next = overflows;
+    overflows = o;
+    overflowSize += (size + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+    nbOverflows++;
+    return reinterpret_cast<char *> (o) + ALIGNMENT;
+}
+
+void ScratchArena::reset () {
+    used = 0;
+    if (overflows == NULL)
+        return;
+    while (overflows != NULL) {
+        Overflow * next = overflows->next;
+        free (overflows);
+        overflows = next;
+    }
+    free (block);
+    capacity += overflowSize;
+    block = static_cast<char *> (allocateAligned (capacity));
+    overflowSize = 0;
+}
+
+static pthread_key_t threadArenaKey;
+static pthread_once_t threadArenaOnce = PTHREAD_ONCE_INIT;
+
+static void deleteThreadArena (void * arena) {
+    delete static_cast<ScratchArena *> (arena);
+}
+
+static void createThreadArenaKey () {
+    pthread_key_create (&threadArenaKey, deleteThreadArena);
+}
+
+ScratchArena & ScratchArena::getThreadArena () {
+    pthread_once (&threadArenaOnce, createThreadArenaKey);
+    ScratchArena * arena = static_cast<ScratchArena *> (pthread_getspecific (threadArenaKey));
+    if (arena == NULL) {
+        arena = new ScratchArena ();
+        pthread_setspecific (threadArenaKey, arena);
+    }
+    return *arena;
+}
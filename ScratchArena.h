@@ -0,0 +1,77 @@
+// *********************************************************
+// Scratch Arena
+// Bump allocator for the temporary arrays of the render loop,
+// one per render thread, emptied at the start of each tile:
+// the pixels take their memory from it instead of the heap.
+// *********************************************************
+
+#ifndef SCRATCHARENA_H
+#define SCRATCHARENA_H
+
+#include <cstddef>
+
+class ScratchArena {
+public:
+    static const size_t DEFAULT_CAPACITY = 64 * 1024;
+    static const size_t ALIGNMENT = 64;
+
+    explicit ScratchArena (size_t capacity = DEFAULT_CAPACITY);
+    ~ScratchArena ();
+
+    // Arena of the calling thread, created on its first call and freed when
+    // the thread exits.
+    static ScratchArena & getThreadArena ();
+
+    // n uninitialized objects, for types without constructor or destructor
+    // that matter (Vec3Df, float...), aligned on ALIGNMENT bytes. Valid until
+    // the arena is rewound before them or reset.
+    template <typename T>
+    inline T * allocate (size_t n) { return static_cast<T *> (allocateBytes (n * sizeof (T))); }
+    inline void * allocateBytes (size_t size) {
+        size_t offset = (used + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+        if (offset + size > capacity)
+            return allocateOverflow (size);
+        used = offset + size;
+        return block + offset;
+    }
+
+    // Frees what was allocated after getMark, e.g. at the end of a pixel.
+    inline size_t getMark () const { return used; }
+    inline void rewind (size_t mark) { if (mark < used) used = mark; }
+
+    // Frees everything. When the arena overflowed since the last reset, it
+    // is reallocated at the size that was needed, so that the next tiles
+    // find all their memory in the block.
+    void reset ();
+
+    inline size_t getCapacity () const { return capacity; }
+    // Heap allocations made because the block was full, since the creation.
+    inline unsigned long long getNbOverflows () const { return nbOverflows; }
+
+private:
+    ScratchArena (const ScratchArena &);
+    ScratchArena & operator= (const ScratchArena &);
+
+    void * allocateOverflow (size_t size);
+
+    // Allocations past the block, chained until the next reset.
+    struct Overflow {
+        Overflow * next;
+    };
+
+    char * block;
+    size_t capacity;
+    size_t used;
+    Overflow * overflows;
+    size_t overflowSize;
+    unsigned long long nbOverflows;
+};
+
+#endif // SCRATCHARENA_H
+
+// Some Emacs-Hints -- please don't remove:
+//
+//  Local Variables:
+//  mode:C++
+//  tab-width:4
+//  End:
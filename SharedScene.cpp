@@ -0,0 +1,310 @@
+// *********************************************************
+// Shared Scene Class
+// *********************************************************
+
+#include "SharedScene.h"
+#include "Scene.h"
+#include "Trace.h"
+
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+using namespace std;
+
+static const char SHARED_MAGIC[8] = {'R', 'A', 'Y', 'M', 'I', 'N', 'I', 0};
+static const unsigned int SHARED_VERSION = 2;
+// How long to wait for a creator that has not even written the header yet.
+static const unsigned int HEADER_TIMEOUT_MS = 10000;
+static const unsigned int POLL_INTERVAL_MS = 100;
+
+// Segment layout: header, object records, light records, then the arrays,
+// each one 16 bytes aligned. Offsets are relative to the segment start.
+struct SharedHeader {
+    char magic[8];
+    unsigned int version;
+    volatile unsigned int ready;
+    unsigned long long fingerprint;
+    unsigned long long size;
+    unsigned int nbObjects;
+    unsigned int nbAreaLights;
+    unsigned int nbLights;
+};
+
+struct SharedObject {
+    Vec3Df trans;
+    float diffuse;
+    float specular;
+    Vec3Df color;
+    unsigned int nbVertices;
+    unsigned int nbTriangles;
+    unsigned int nbNodes;
+    unsigned int nbLeafTriangles;
+    unsigned long long positions;
+    unsigned long long normals;
+    unsigned long long indices;
+    unsigned long long nodes;
+    unsigned long long leafTriangles;
+};
+
+struct SharedLight {
+    Vec3Df pos;
+    Vec3Df color;
+    float intensity;
+    float rayon;
+    Vec3Df orientation;
+};
+
+static inline unsigned long long align (unsigned long long offset) {
+    return (offset + 15) & ~15ULL;
+}
+
+static inline string segmentName (const string & name) {
+    return (name.empty () || name[0] != '/') ? "/" + name : name;
+}
+
+// The builder may have published between our check and taking the lock.
+static bool isReady (int f) {
+    void * p = mmap (NULL, sizeof (SharedHeader), PROT_READ, MAP_SHARED, f, 0);
+    if (p == MAP_FAILED)
+        return false;
+    bool ready = (static_cast<const SharedHeader *> (p)->ready != 0);
+    munmap (p, sizeof (SharedHeader));
+    return ready;
+}
+
+SharedScene::SharedScene (const string & n, unsigned long long f) : name (segmentName (n)), fingerprint (f), fd (-1) {}
+
+SharedScene::~SharedScene () {
+    if (fd >= 0)
+        close (fd);
+}
+
+bool SharedScene::attach (Scene & scene) {
+    TraceScope trace ("SharedScene::attach", name);
+    int f = shm_open (name.c_str (), O_RDONLY, 0);
+    if (f < 0) {
+        if (errno == ENOENT)
+            return false;
+        throw Exception ("Cannot open " + name + ": " + strerror (errno));
+    }
+    unsigned int waited = 0;
+    while (true) {
+        struct stat st;
+        if (fstat (f, &st) == 0 && st.st_size >= static_cast<off_t> (sizeof (SharedHeader))) {
+            void * p = mmap (NULL, sizeof (SharedHeader), PROT_READ, MAP_SHARED, f, 0);
+            if (p == MAP_FAILED)
+                break;
+            const SharedHeader * header = static_cast<const SharedHeader *> (p);
+            bool ready = (header->ready != 0);
+            unsigned long long found = header->fingerprint;
+            munmap (p, sizeof (SharedHeader));
+            if (found != fingerprint) {
+                cerr << "[SharedScene] " << name << " holds another scene or was built with other options, rebuilding." << endl;
+                close (f);
+                remove (name);
+                return false;
+            }
+            if (ready)
+                break;
+            // The builder holds an exclusive lock on the segment from before
+            // writing the header until the scene is published. The kernel
+            // releases it if the builder dies, whatever its PID namespace.
+            if (flock (f, LOCK_SH | LOCK_NB) == 0) {
+                flock (f, LOCK_UN);
+                if (!isReady (f)) {
+                    cerr << "[SharedScene] The builder of " << name << " died, rebuilding." << endl;
+                    close (f);
+                    remove (name);
+                    return false;
+                }
+                break;
+            }
+        } else if (waited > HEADER_TIMEOUT_MS) {
+            cerr << "[SharedScene] " << name << " was never initialized, rebuilding." << endl;
+            close (f);
+            remove (name);
+            return false;
+        }
+        usleep (1000 * POLL_INTERVAL_MS);
+        waited += POLL_INTERVAL_MS;
+    }
+
+    struct stat st;
+    if (fstat (f, &st) < 0) {
+        close (f);
+        throw Exception ("Cannot stat " + name);
+    }
+    void * p = mmap (NULL, st.st_size, PROT_READ, MAP_SHARED, f, 0);
+    close (f);
+    if (p == MAP_FAILED)
+        throw Exception ("Cannot map " + name + ": " + strerror (errno));
+    const SharedHeader * header = static_cast<const SharedHeader *> (p);
+    if (memcmp (header->magic, SHARED_MAGIC, sizeof (SHARED_MAGIC)) != 0
+        || header->version != SHARED_VERSION
+        || header->size != static_cast<unsigned long long> (st.st_size))
+        throw Exception (name + " is not a raymini scene segment of this version.");
+    // The mapping stays for the lifetime of the process.
+    scene.getObjects ().clear ();
+    bind (static_cast<const unsigned char *> (p), scene);
+    return true;
+}
+
+bool SharedScene::create () {
+    fd = shm_open (name.c_str (), O_RDWR | O_CREAT | O_EXCL, 0644);
+    if (fd < 0) {
+        if (errno == EEXIST)
+            return false;
+        throw Exception ("Cannot create " + name + ": " + strerror (errno));
+    }
+    // Held until publish closes fd, or until we die: see attach.
+    if (flock (fd, LOCK_EX) < 0)
+        throw Exception ("Cannot lock " + name + ": " + strerror (errno));
+    SharedHeader header;
+    memset (&header, 0, sizeof (header));
+    memcpy (header.magic, SHARED_MAGIC, sizeof (SHARED_MAGIC));
+    header.version = SHARED_VERSION;
+    header.fingerprint = fingerprint;
+    if (write (fd, &header, sizeof (header)) != static_cast<ssize_t> (sizeof (header)))
+        throw Exception ("Cannot initialize " + name);
+    return true;
+}
+
+void SharedScene::publish (Scene & scene) {
+    TraceScope trace ("SharedScene::publish", name);
+    const vector<Object> & objects = scene.getObjects ();
+    const vector<AreaLight> & areaLights = scene.getAreaLights ();
+    const vector<Light> & lights = scene.getLights ();
+
+    unsigned long long size = align (sizeof (SharedHeader));
+    unsigned long long objectsOffset = size;
+    size = align (size + objects.size () * sizeof (SharedObject));
+    unsigned long long areaLightsOffset = size;
+    size = align (size + areaLights.size () * sizeof (SharedLight));
+    unsigned long long lightsOffset = size;
+    size = align (size + lights.size () * sizeof (SharedLight));
+    vector<SharedObject> records (objects.size ());
+    for (unsigned int i = 0; i < objects.size (); i++) {
+        const Object & o = objects[i];
+        const RenderMesh & m = o.getRenderMesh ();
+        const KDTree & t = o.getKDTree ();
+        SharedObject & r = records[i];
+        r.trans = o.getTrans ();
+        r.diffuse = o.getMaterial ().getDiffuse ();
+        r.specular = o.getMaterial ().getSpecular ();
+        r.color = o.getMaterial ().getColor ();
+        r.nbVertices = m.getNbVertices ();
+        r.nbTriangles = m.getNbTriangles ();
+        r.nbNodes = t.getNbNodes ();
+        r.nbLeafTriangles = t.getNbTriangles ();
+        r.positions = size;
+        size = align (size + r.nbVertices * sizeof (Vec3Df));
+        r.normals = size;
+        size = align (size + r.nbVertices * sizeof (Vec3Df));
+        r.indices = size;
+        size = align (size + 3 * r.nbTriangles * sizeof (unsigned int));
+        r.nodes = size;
+        size = align (size + r.nbNodes * sizeof (KDFlatNode));
+        r.leafTriangles = size;
+        size = align (size + r.nbLeafTriangles * sizeof (unsigned int));
+    }
+
+    if (ftruncate (fd, size) < 0)
+        throw Exception ("Cannot resize " + name + ": " + strerror (errno));
+    void * p = mmap (NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (p == MAP_FAILED)
+        throw Exception ("Cannot map " + name + ": " + strerror (errno));
+    unsigned char * segment = static_cast<unsigned char *> (p);
+    SharedHeader * header = reinterpret_cast<SharedHeader *> (segment);
+    header->size = size;
+    header->nbObjects = objects.size ();
+    header->nbAreaLights = areaLights.size ();
+    header->nbLights = lights.size ();
+    for (unsigned int i = 0; i < objects.size (); i++) {
+        const RenderMesh & m = objects[i].getRenderMesh ();
+        const KDTree & t = objects[i].getKDTree ();
+        const SharedObject & r = records[i];
+        memcpy (segment + objectsOffset + i * sizeof (SharedObject), &r, sizeof (SharedObject));
+        memcpy (segment + r.positions, m.getPositions (), r.nbVertices * sizeof (Vec3Df));
+        memcpy (segment + r.normals, m.getNormals (), r.nbVertices * sizeof (Vec3Df));
+        memcpy (segment + r.indices, m.getIndices (), 3 * r.nbTriangles * sizeof (unsigned int));
+        memcpy (segment + r.nodes, t.getNodes (), r.nbNodes * sizeof (KDFlatNode));
+        memcpy (segment + r.leafTriangles, t.getTriangles (), r.nbLeafTriangles * sizeof (unsigned int));
+    }
+    for (unsigned int i = 0; i < areaLights.size (); i++) {
+        SharedLight * l = reinterpret_cast<SharedLight *> (segment + areaLightsOffset) + i;
+        l->pos = areaLights[i].getPos ();
+        l->color = areaLights[i].getColor ();
+        l->intensity = areaLights[i].getIntensity ();
+        l->rayon = areaLights[i].getRayon ();
+        l->orientation = areaLights[i].getOrientation ();
+    }
+    for (unsigned int i = 0; i < lights.size (); i++) {
+        SharedLight * l = reinterpret_cast<SharedLight *> (segment + lightsOffset) + i;
+        l->pos = lights[i].getPos ();
+        l->color = lights[i].getColor ();
+        l->intensity = lights[i].getIntensity ();
+    }
+    __sync_synchronize ();
+    header->ready = 1;
+    mprotect (p, size, PROT_READ);
+    close (fd);
+    fd = -1;
+
+    // Our own objects keep their editable mesh (for the preview) but render
+    // from the shared copy, like every other process.
+    bind (segment, scene);
+}
+
+bool SharedScene::remove (const string & name) {
+    return (shm_unlink (segmentName (name).c_str ()) == 0);
+}
+
+void SharedScene::bind (const unsigned char * segment, Scene & scene) const {
+    const SharedHeader * header = reinterpret_cast<const SharedHeader *> (segment);
+    unsigned long long offset = align (sizeof (SharedHeader));
+    const SharedObject * records = reinterpret_cast<const SharedObject *> (segment + offset);
+    offset = align (offset + header->nbObjects * sizeof (SharedObject));
+    const SharedLight * areaLights = reinterpret_cast<const SharedLight *> (segment + offset);
+    offset = align (offset + header->nbAreaLights * sizeof (SharedLight));
+    const SharedLight * lights = reinterpret_cast<const SharedLight *> (segment + offset);
+
+    vector<Object> & objects = scene.getObjects ();
+    bool inPlace = (objects.size () == header->nbObjects);
+    if (!inPlace)
+        objects.assign (header->nbObjects, Object ());
+    for (unsigned int i = 0; i < header->nbObjects; i++) {
+        const SharedObject & r = records[i];
+        Object & o = objects[i];
+        o.getRenderMesh ().attach (reinterpret_cast<const Vec3Df *> (segment + r.positions),
+                                   reinterpret_cast<const Vec3Df *> (segment + r.normals),
+                                   r.nbVertices,
+                                   reinterpret_cast<const unsigned int *> (segment + r.indices),
+                                   r.nbTriangles);
+        o.getKDTree ().attach (reinterpret_cast<const KDFlatNode *> (segment + r.nodes), r.nbNodes,
+                               reinterpret_cast<const unsigned int *> (segment + r.leafTriangles), r.nbLeafTriangles,
+                               r.nbTriangles);
+        if (!inPlace) {
+            o.setTrans (r.trans);
+            o.getMaterial () = Material (r.diffuse, r.specular, r.color);
+            o.updateBoundingBox ();
+        }
+    }
+    if (inPlace)
+        return;
+    scene.getAreaLights ().clear ();
+    for (unsigned int i = 0; i < header->nbAreaLights; i++) {
+        scene.getAreaLights ().push_back (AreaLight (areaLights[i].pos, areaLights[i].color, areaLights[i].intensity,
+                                                     areaLights[i].rayon, areaLights[i].orientation));
+        scene.getAreaLights ().back ().setOrientation (areaLights[i].orientation);
+    }
+    scene.getLights ().clear ();
+    for (unsigned int i = 0; i < header->nbLights; i++)
+        scene.getLights ().push_back (Light (lights[i].pos, lights[i].color, lights[i].intensity));
+}
@@ -0,0 +1,70 @@
+// *********************************************************
+// Shared Scene Class
+// Places the render meshes and flattened KD-trees of a scene
+// in a named POSIX shared memory segment, so that several
+// raymini processes of one node map a single copy.
+// *********************************************************
+
+#ifndef SHAREDSCENE_H
+#define SHAREDSCENE_H
+
+#include <string>
+
+class Scene;
+
+// The first process creates the segment, builds the scene as usual, copies
+// it into the segment and then renders from the segment too. The others
+// wait for the segment to be complete and map it read-only: they never load
+// the meshes nor build the trees, their objects have an empty editable Mesh
+// (so nothing to preview) and render from the shared arrays. The segment
+// outlives the processes, until SharedScene::remove (raymini -shmremove) or
+// a reboot. It records the fingerprint of the scene it holds: a process
+// asking for another scene under the same name removes it and builds its own.
+class SharedScene {
+public:
+    // fingerprint identifies the scene definition and the options it was
+    // built with, see Scene.
+    SharedScene (const std::string & name, unsigned long long fingerprint);
+    virtual ~SharedScene ();
+
+    // Maps a complete segment into scene, waiting for its builder if needed.
+    // Returns false if there is no such segment, or if it was removed
+    // because its builder died or it holds another scene. Throws if the
+    // segment exists but cannot be opened, e.g. for lack of permission.
+    bool attach (Scene & scene);
+
+    // Reserves the segment. Returns false if another process got it first.
+    bool create ();
+
+    // Copies scene into the reserved segment and makes its objects refer
+    // to the shared copy.
+    void publish (Scene & scene);
+
+    // Returns false if there was no such segment.
+    static bool remove (const std::string & name);
+
+    class Exception {
+    private:
+        std::string msg;
+    public:
+        Exception (const std::string & msg) : msg ("[SharedScene Exception]" + msg) {}
+        virtual ~Exception () {}
+        inline const std::string & getMessage () const { return msg; }
+    };
+
+private:
+    void bind (const unsigned char * segment, Scene & scene) const;
+
+    std::string name;
+    unsigned long long fingerprint;
+    int fd;
+};
+
+#endif // SHAREDSCENE_H
+
+// Some Emacs-Hints -- please don't remove:
+//
+//  Local Variables:
+//  mode:C++
+//  tab-width:4
+//  End:
@@ -0,0 +1,194 @@
+// *********************************************************
+// Socket Class
+// *********************************************************
+
+#include "Socket.h"
+
+#include <cerrno>
+#include <cstring>
+#include <cstdio>
+#include <unistd.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+using namespace std;
+
+// Upper bound of a message payload, protects against garbage on the wire.
+static const unsigned int MAX_MESSAGE_SIZE = 1u << 30;
+
+static string systemError (const string & what) {
+    return what + ": " + strerror (errno);
+}
+
+static int createSocket (int domain) {
+    int fd = ::socket (domain, SOCK_STREAM, 0);
+    if (fd < 0)
+        throw Socket::Exception (systemError ("socket"));
+    // Workers are spawned with fork/exec, they must not inherit our sockets.
+    fcntl (fd, F_SETFD, FD_CLOEXEC);
+    return fd;
+}
+
+Socket Socket::listenTCP (unsigned short port) {
+    int fd = createSocket (AF_INET);
+    int yes = 1;
+    setsockopt (fd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof (yes));
+    sockaddr_in address;
+    memset (&address, 0, sizeof (address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl (INADDR_ANY);
+    address.sin_port = htons (port);
+    if (::bind (fd, reinterpret_cast<sockaddr *> (&address), sizeof (address)) < 0
+        || ::listen (fd, 64) < 0) {
+        string error = systemError ("bind/listen");
+        ::close (fd);
+        throw Exception (error);
+    }
+    return Socket (fd);
+}
+
+Socket Socket::connectTCP (const string & host, unsigned short port) {
+    addrinfo hints;
+    memset (&hints, 0, sizeof (hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo * result = NULL;
+    char service[16];
+    snprintf (service, sizeof (service), "%u", port);
+    if (getaddrinfo (host.c_str (), service, &hints, &result) != 0 || result == NULL)
+        throw Exception ("Cannot resolve " + host);
+    int fd = createSocket (AF_INET);
+    int status = ::connect (fd, result->ai_addr, result->ai_addrlen);
+    freeaddrinfo (result);
+    if (status < 0) {
+        string error = systemError ("connect to " + host);
+        ::close (fd);
+        throw Exception (error);
+    }
+    int yes = 1;
+    setsockopt (fd, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof (yes));
+    return Socket (fd);
+}
+
+static sockaddr_un localAddress (const string & path) {
+    sockaddr_un address;
+    memset (&address, 0, sizeof (address));
+    address.sun_family = AF_UNIX;
+    if (path.size () >= sizeof (address.sun_path))
+        throw Socket::Exception ("Socket path too long: " + path);
+    strcpy (address.sun_path, path.c_str ());
+    return address;
+}
+
+Socket Socket::listenLocal (const string & path) {
+    sockaddr_un address = localAddress (path);
+    int fd = createSocket (AF_UNIX);
+    unlink (path.c_str ());
+    if (::bind (fd, reinterpret_cast<sockaddr *> (&address), sizeof (address)) < 0
+        || ::listen (fd, 16) < 0) {
+        string error = systemError ("bind/listen " + path);
+        ::close (fd);
+        throw Exception (error);
+    }
+    return Socket (fd);
+}
+
+Socket Socket::connectLocal (const string & path) {
+    sockaddr_un address = localAddress (path);
+    int fd = createSocket (AF_UNIX);
+    if (::connect (fd, reinterpret_cast<sockaddr *> (&address), sizeof (address)) < 0) {
+        string error = systemError ("connect to " + path);
+        ::close (fd);
+        throw Exception (error);
+    }
+    return Socket (fd);
+}
+
+Socket Socket::accept () const {
+    int client = ::accept (fd, NULL, NULL);
+    if (client < 0)
+        throw Exception (systemError ("accept"));
+    fcntl (client, F_SETFD, FD_CLOEXEC);
+    return Socket (client);
+}
+
+void Socket::send (const Message & message) const {
+    unsigned int header[2];
+    header[0] = message.getType ();
+    header[1] = message.getData ().size ();
+    sendAll (header, sizeof (header));
+    if (header[1] > 0)
+        sendAll (&message.getData ()[0], header[1]);
+}
+
+bool Socket::receive (Message & message) const {
+    unsigned int header[2];
+    if (!receiveAll (header, sizeof (header)))
+        return false;
+    if (header[1] > MAX_MESSAGE_SIZE)
+        throw Exception ("Message too large.");
+    message.clear ();
+    message.setType (header[0]);
+    message.getData ().resize (header[1]);
+    if (header[1] > 0 && !receiveAll (&message.getData ()[0], header[1]))
+        throw Exception ("Connection closed in the middle of a message.");
+    return true;
+}
+
+void Socket::setReceiveTimeout (unsigned int ms) const {
+    timeval tv;
+    tv.tv_sec = ms / 1000;
+    tv.tv_usec = 1000 * (ms % 1000);
+    if (setsockopt (fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof (tv)) < 0)
+        throw Exception (systemError ("setsockopt"));
+}
+
+void Socket::close () {
+    if (fd >= 0) {
+        ::close (fd);
+        fd = -1;
+    }
+}
+
+void Socket::sendAll (const void * data, unsigned int size) const {
+    const char * bytes = static_cast<const char *> (data);
+    while (size > 0) {
+        // MSG_NOSIGNAL: a dead peer must raise an exception, not SIGPIPE.
+        ssize_t n = ::send (fd, bytes, size, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            throw Exception (systemError ("send"));
+        }
+        bytes += n;
+        size -= n;
+    }
+}
+
+bool Socket::receiveAll (void * data, unsigned int size) const {
+    char * bytes = static_cast<char *> (data);
+    unsigned int received = 0;
+    while (received < size) {
+        ssize_t n = ::recv (fd, bytes + received, size - received, 0);
+        if (n == 0) {
+            if (received == 0)
+                return false;
+            throw Exception ("Connection closed in the middle of a message.");
+        }
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                throw Exception ("The peer stopped sending.");
+            throw Exception (systemError ("recv"));
+        }
+        received += n;
+    }
+    return true;
+}
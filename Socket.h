@@ -0,0 +1,62 @@
+// *********************************************************
+// Socket Class
+// Thin wrapper over POSIX stream sockets (TCP and Unix
+// domain), exchanging framed Messages.
+// *********************************************************
+
+#ifndef SOCKET_H
+#define SOCKET_H
+
+#include <string>
+
+#include "RenderProtocol.h"
+
+// Sockets are plain handles: copies share the same descriptor, which is
+// released by an explicit close ().
+class Socket {
+public:
+    inline Socket () : fd (-1) {}
+    inline explicit Socket (int fd) : fd (fd) {}
+    virtual ~Socket () {}
+
+    static Socket listenTCP (unsigned short port);
+    static Socket connectTCP (const std::string & host, unsigned short port);
+    static Socket listenLocal (const std::string & path);
+    static Socket connectLocal (const std::string & path);
+
+    Socket accept () const;
+    void send (const Message & message) const;
+    // Returns false when the peer closed the connection.
+    bool receive (Message & message) const;
+    // From then on, receive throws when the peer leaves it waiting for ms
+    // milliseconds, e.g. in the middle of a message.
+    void setReceiveTimeout (unsigned int ms) const;
+    void close ();
+
+    inline bool isValid () const { return fd >= 0; }
+    inline int getDescriptor () const { return fd; }
+
+    class Exception {
+    private:
+        std::string msg;
+    public:
+        Exception (const std::string & msg) : msg ("[Socket Exception]" + msg) {}
+        virtual ~Exception () {}
+        inline const std::string & getMessage () const { return msg; }
+    };
+
+private:
+    void sendAll (const void * data, unsigned int size) const;
+    bool receiveAll (void * data, unsigned int size) const;
+
+    int fd;
+};
+
+#endif // SOCKET_H
+
+// Some Emacs-Hints -- please don't remove:
+//
+//  Local Variables:
+//  mode:C++
+//  tab-width:4
+//  End:
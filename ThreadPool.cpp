@@ -0,0 +1,120 @@
+// *********************************************************
+// Thread Pool
+// *********************************************************
+
+#include "ThreadPool.h"
+
+#include <iostream>
+#include <unistd.h>
+
+using namespace std;
+
+static ThreadPool * instance = NULL;
+static unsigned int requestedNbThreads = 0;
+
+ThreadPool & ThreadPool::getInstance () {
+    if (instance == NULL) {
+        unsigned int n = requestedNbThreads;
+        if (n == 0) {
+            long nbCpus = sysconf (_SC_NPROCESSORS_ONLN);
+            n = (nbCpus > 0) ? static_cast<unsigned int> (nbCpus) : 1;
+        }
+        instance = new ThreadPool (n);
+    }
+    return *instance;
+}
+
+void ThreadPool::setNbThreads (unsigned int n) {
+    requestedNbThreads = n;
+}
+
+// The pool lives as long as the process: the workers are left blocked on
+// an empty queue at exit.
+ThreadPool::ThreadPool (unsigned int nbThreads) {
+    pthread_mutex_init (&mutex, NULL);
+    pthread_cond_init (&jobQueued, NULL);
+    pthread_cond_init (&jobDone, NULL);
+    for (unsigned int i = 1; i < nbThreads; i++) {
+        pthread_t thread;
+        if (pthread_create (&thread, NULL, work, this) != 0) {
+            cerr << "[ThreadPool] Cannot start more than " << i << " threads." << endl;
+            break;
+        }
+        pthread_detach (thread);
+        workers.push_back (thread);
+    }
+}
+
+void * ThreadPool::work (void * p) {
+    ThreadPool * pool = static_cast<ThreadPool *> (p);
+    pthread_mutex_lock (&pool->mutex);
+    for (;;)
+        if (!pool->runQueuedJob ())
+            pthread_cond_wait (&pool->jobQueued, &pool->mutex);
+    return NULL;
+}
+
+bool ThreadPool::runQueuedJob () {
+    if (queue.empty ())
+        return false;
+    QueuedJob queued = queue.front ();
+    queue.pop_front ();
+    pthread_mutex_unlock (&mutex);
+    queued.job->run ();
+    pthread_mutex_lock (&mutex);
+    queued.group->nbPending--;
+    pthread_cond_broadcast (&jobDone);
+    return true;
+}
+
+void ThreadPool::Group::add (Job & job) {
+    QueuedJob queued = { &job, this };
+    pthread_mutex_lock (&pool.mutex);
+    pool.queue.push_back (queued);
+    nbPending++;
+    pthread_cond_signal (&pool.jobQueued);
+    pthread_mutex_unlock (&pool.mutex);
+}
+
+void ThreadPool::Group::wait () {
+    pthread_mutex_lock (&pool.mutex);
+    while (nbPending > 0)
+        if (!pool.runQueuedJob ())
+            pthread_cond_wait (&pool.jobDone, &pool.mutex);
+    pthread_mutex_unlock (&pool.mutex);
+}
+
+namespace {
+
+class RangeJob : public ThreadPool::Job {
+public:
+    RangeJob () : range (NULL), begin (0), end (0) {}
+    void run () { range->run (begin, end); }
+    ThreadPool::Range * range;
+    unsigned int begin, end;
+};
+
+} // namespace
+
+void ThreadPool::parallelFor (Range & range, unsigned int n, unsigned int grain) {
+    if (grain == 0)
+        grain = 1;
+    // A few pieces per thread, to even out their durations.
+    unsigned int nbPieces = (n + grain - 1) / grain;
+    if (nbPieces > 4 * getNbThreads ())
+        nbPieces = 4 * getNbThreads ();
+    if (nbPieces <= 1 || workers.empty ()) {
+        if (n > 0)
+            range.run (0, n);
+        return;
+    }
+    vector<RangeJob> jobs (nbPieces);
+    Group group (*this);
+    for (unsigned int i = 0; i < nbPieces; i++) {
+        jobs[i].range = &range;
+        jobs[i].begin = static_cast<unsigned int> ((static_cast<unsigned long long> (n) * i) / nbPieces);
+        jobs[i].end = static_cast<unsigned int> ((static_cast<unsigned long long> (n) * (i + 1)) / nbPieces);
+        group.add (jobs[i]);
+    }
+    group.wait ();
+}
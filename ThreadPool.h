@@ -0,0 +1,89 @@
+// *********************************************************
+// Thread Pool
+// Worker threads for the preprocessing of the meshes, shared
+// by the whole process. Jobs are queued in groups; a thread
+// waiting for a group runs queued jobs meanwhile, so that a
+// job may itself wait for jobs it queued.
+// *********************************************************
+
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <deque>
+#include <vector>
+#include <pthread.h>
+
+class ThreadPool {
+public:
+    class Job {
+    public:
+        virtual ~Job () {}
+        // Must not throw: the exceptions are to be caught and kept by the job.
+        virtual void run () = 0;
+    };
+
+    // Jobs waited for together.
+    class Group {
+    public:
+        explicit Group (ThreadPool & pool) : pool (pool), nbPending (0) {}
+        ~Group () { wait (); }
+        // The job is not owned, and must live until wait returns.
+        void add (Job & job);
+        void wait ();
+    private:
+        Group (const Group &);
+        Group & operator= (const Group &);
+        friend class ThreadPool;
+        ThreadPool & pool;
+        unsigned int nbPending;
+    };
+
+    // Loop body of parallelFor, called on disjoint ranges of indices.
+    class Range {
+    public:
+        virtual ~Range () {}
+        virtual void run (unsigned int begin, unsigned int end) = 0;
+    };
+
+    // Created on the first call, with setNbThreads threads.
+    static ThreadPool & getInstance ();
+    // Before the first getInstance; 0, the default, is one per online CPU.
+    static void setNbThreads (unsigned int nbThreads);
+
+    // Threads running the jobs, the waiting one included.
+    inline unsigned int getNbThreads () const { return workers.size () + 1; }
+
+    // range.run on [0, n) in pieces of at least grain indices, on all the
+    // threads; returns once they are all done.
+    void parallelFor (Range & range, unsigned int n, unsigned int grain);
+
+private:
+    explicit ThreadPool (unsigned int nbThreads);
+    ThreadPool (const ThreadPool &);
+    ThreadPool & operator= (const ThreadPool &);
+
+    static void * work (void * pool);
+    // With the mutex held: runs the first queued job, unlocked, and returns
+    // true; false if the queue is empty.
+    bool runQueuedJob ();
+
+    struct QueuedJob {
+        Job * job;
+        Group * group;
+    };
+
+    pthread_mutex_t mutex;
+    pthread_cond_t jobQueued;
+    pthread_cond_t jobDone;
+    std::deque<QueuedJob> queue;
+    std::vector<pthread_t> workers;
+};
+
+#endif // THREADPOOL_H
+
+// Some Emacs-Hints -- please don't remove:
+//
+//  Local Variables:
+//  mode:C++
+//  tab-width:4
+//  End:
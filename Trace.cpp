@@ -0,0 +1,107 @@
+// *********************************************************
+// Trace
+// *********************************************************
+
+#include "Trace.h"
+
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <iostream>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <pthread.h>
+
+using namespace std;
+
+struct TraceEvent {
+    const char * name;
+    string detail;
+    int index;
+    unsigned long long begin;
+    unsigned long long end;
+    long tid;
+};
+
+bool Trace::enabled = false;
+static string traceFilename;
+static vector<TraceEvent> events;
+static pthread_mutex_t eventsMutex = PTHREAD_MUTEX_INITIALIZER;
+
+static void finishAtExit () {
+    Trace::finish ();
+}
+
+void Trace::start (const string & filename) {
+    if (!enabled)
+        atexit (finishAtExit);
+    traceFilename = filename;
+    enabled = true;
+}
+
+unsigned long long Trace::now () {
+    timespec ts;
+    clock_gettime (CLOCK_MONOTONIC, &ts);
+    return static_cast<unsigned long long> (ts.tv_sec) * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+void Trace::record (const char * name, const string & detail, int index,
+                    unsigned long long begin, unsigned long long end) {
+    TraceEvent e;
+    e.name = name;
+    e.detail = detail;
+    e.index = index;
+    e.begin = begin;
+    e.end = end;
+    e.tid = syscall (SYS_gettid);
+    pthread_mutex_lock (&eventsMutex);
+    events.push_back (e);
+    pthread_mutex_unlock (&eventsMutex);
+}
+
+static string escape (const string & s) {
+    string e;
+    for (unsigned int i = 0; i < s.size (); i++) {
+        if (s[i] == '"' || s[i] == '\\')
+            e += '\\';
+        if (static_cast<unsigned char> (s[i]) >= 0x20)
+            e += s[i];
+    }
+    return e;
+}
+
+void Trace::finish () {
+    if (!enabled)
+        return;
+    enabled = false;
+    FILE * output = fopen (traceFilename.c_str (), "w");
+    if (output == NULL) {
+        cerr << "Cannot write the trace to " << traceFilename << endl;
+        return;
+    }
+    pthread_mutex_lock (&eventsMutex);
+    int pid = getpid ();
+    fprintf (output, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    fprintf (output, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":\"raymini\"}}",
+             pid, pid);
+    for (unsigned int i = 0; i < events.size (); i++) {
+        const TraceEvent & e = events[i];
+        fprintf (output, ",\n{\"name\":\"%s\",\"cat\":\"raymini\",\"ph\":\"X\",\"ts\":%llu,\"dur\":%llu,\"pid\":%d,\"tid\":%ld",
+                 escape (e.name).c_str (), e.begin, e.end - e.begin, pid, e.tid);
+        if (!e.detail.empty () || e.index >= 0) {
+            fprintf (output, ",\"args\":{");
+            if (!e.detail.empty ())
+                fprintf (output, "\"detail\":\"%s\"%s", escape (e.detail).c_str (), e.index >= 0 ? "," : "");
+            if (e.index >= 0)
+                fprintf (output, "\"index\":%d", e.index);
+            fprintf (output, "}");
+        }
+        fprintf (output, "}");
+    }
+    fprintf (output, "\n]}\n");
+    events.clear ();
+    pthread_mutex_unlock (&eventsMutex);
+    fclose (output);
+    cout << "Trace written to " << traceFilename << endl;
+}
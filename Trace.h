@@ -0,0 +1,68 @@
+// *********************************************************
+// Trace
+// Timeline of the startup and render phases, written as a
+// Chrome trace (JSON) that chrome://tracing and Perfetto open.
+// Disabled unless Trace::start is called; then a TraceScope
+// costs a single test.
+// *********************************************************
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <string>
+
+class Trace {
+public:
+    // Records the events from now on, written to filename by finish, which
+    // is also called at exit.
+    static void start (const std::string & filename);
+    static void finish ();
+    static inline bool isEnabled () { return enabled; }
+
+    // Microseconds of the monotonic clock.
+    static unsigned long long now ();
+
+    // index < 0: no index argument.
+    static void record (const char * name, const std::string & detail, int index,
+                        unsigned long long begin, unsigned long long end);
+
+private:
+    static bool enabled;
+};
+
+// Records its own lifetime as a complete event of the calling thread, e.g.
+//     TraceScope trace ("Mesh::loadOFF", filename);
+class TraceScope {
+public:
+    inline TraceScope (const char * name)
+        : name (name), index (-1), begin (Trace::isEnabled () ? Trace::now () : 0) {}
+    inline TraceScope (const char * name, const std::string & d)
+        : name (name), index (-1), begin (Trace::isEnabled () ? Trace::now () : 0) {
+        if (begin)
+            detail = d;
+    }
+    inline TraceScope (const char * name, int index)
+        : name (name), index (index), begin (Trace::isEnabled () ? Trace::now () : 0) {}
+    inline ~TraceScope () {
+        if (begin)
+            Trace::record (name, detail, index, begin, Trace::now ());
+    }
+
+private:
+    TraceScope (const TraceScope &);
+    TraceScope & operator= (const TraceScope &);
+
+    const char * name;
+    std::string detail;
+    int index;
+    unsigned long long begin;
+};
+
+#endif // TRACE_H
+
+// Some Emacs-Hints -- please don't remove:
+//
+//  Local Variables:
+//  mode:C++
+//  tab-width:4
+//  End:
@@ -35,6 +35,7 @@
 #include <QStatusBar>
 
 #include "RayTracer.h"
+#include "Trace.h"
 
 using namespace std;
 
@@ -63,6 +64,7 @@ Window::~Window () {
 }
 
 void Window::renderRayImage () {
+    TraceScope trace ("Window::renderRayImage");
     qglviewer::Camera * cam = viewer->camera ();
     RayTracer * rayTracer = RayTracer::getInstance ();
     qglviewer::Vec p = cam->position ();
@@ -85,7 +87,10 @@ void Window::renderRayImage () {
                              QString::number (timer.elapsed ()) +
                              QString ("ms at ") +
                              QString::number (screenWidth) + QString ("x") + QString::number (screenHeight) +
-                             QString (" screen resolution"));
+                             QString (" screen resolution") +
+                             (RenderStats::isEnabled ()
+                              ? QString (" - ") + QString (rayTracer->getLastStats ().getSummary ().c_str ())
+                              : QString ()));
     viewer->setDisplayMode (GLViewer::RayDisplayMode);
 }
 
@@ -0,0 +1,81 @@
+// *********************************************************
+// Allocation counter
+// *********************************************************
+
+#include "AllocationCounter.h"
+
+#include <cstdlib>
+#include <new>
+
+// The exception specifications of <new>, which changed in C++11.
+#if __cplusplus >= 201103L
+#define THROWS_BAD_ALLOC
+#define THROWS_NOTHING noexcept
+#else
+#define THROWS_BAD_ALLOC throw (std::bad_alloc)
+#define THROWS_NOTHING throw ()
+#endif
+
+static unsigned long long nbAllocations = 0;
+
+static inline void * countedAllocation (std::size_t size) {
+    __sync_fetch_and_add (&nbAllocations, 1ULL);
+    // new of 0 bytes returns a distinct pointer.
+    void * p = std::malloc (size > 0 ? size : 1);
+    if (p == NULL)
+        throw std::bad_alloc ();
+    return p;
+}
+
+unsigned long long AllocationCounter::get () {
+    return __sync_fetch_and_add (&nbAllocations, 0ULL);
+}
+
+void AllocationCounter::reset () {
+    __sync_lock_test_and_set (&nbAllocations, 0ULL);
+}
+
+void * operator new (std::size_t size) THROWS_BAD_ALLOC {
+    return countedAllocation (size);
+}
+
+void * operator new[] (std::size_t size) THROWS_BAD_ALLOC {
+    return countedAllocation (size);
+}
+
+void * operator new (std::size_t size, const std::nothrow_t &) THROWS_NOTHING {
+    __sync_fetch_and_add (&nbAllocations, 1ULL);
+    return std::malloc (size > 0 ? size : 1);
+}
+
+void * operator new[] (std::size_t size, const std::nothrow_t &) THROWS_NOTHING {
+    __sync_fetch_and_add (&nbAllocations, 1ULL);
+    return std::malloc (size > 0 ? size : 1);
+}
+
+void operator delete (void * p) THROWS_NOTHING {
+    std::free (p);
+}
+
+void operator delete[] (void * p) THROWS_NOTHING {
+    std::free (p);
+}
+
+// The sized forms of C++14, replaced along with the unsized ones.
+#if __cplusplus >= 201402L
+void operator delete (void * p, std::size_t) THROWS_NOTHING {
+    std::free (p);
+}
+
+void operator delete[] (void * p, std::size_t) THROWS_NOTHING {
+    std::free (p);
+}
+#endif
+
+void operator delete (void * p, const std::nothrow_t &) THROWS_NOTHING {
+    std::free (p);
+}
+
+void operator delete[] (void * p, const std::nothrow_t &) THROWS_NOTHING {
+    std::free (p);
+}
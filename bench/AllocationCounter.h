@@ -0,0 +1,25 @@
+// *********************************************************
+// Allocation counter
+// Counts the calls to operator new of the whole benchmark,
+// which replaces the global allocation functions: the STL
+// containers and everything else allocated with new show up.
+// *********************************************************
+
+#ifndef ALLOCATIONCOUNTER_H
+#define ALLOCATIONCOUNTER_H
+
+class AllocationCounter {
+public:
+    // Allocations since the last reset, of all threads.
+    static unsigned long long get ();
+    static void reset ();
+};
+
+#endif // ALLOCATIONCOUNTER_H
+
+// Some Emacs-Hints -- please don't remove:
+//
+//  Local Variables:
+//  mode:C++
+//  tab-width:4
+//  End:
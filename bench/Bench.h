@@ -0,0 +1,106 @@
+// *********************************************************
+// Benchmark helpers
+// Timing, seeded random numbers and machine-readable output
+// shared by the raymini benchmarks.
+// *********************************************************
+
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cstdio>
+#include <ctime>
+
+// Monotonic clock, in nanoseconds.
+class BenchTimer {
+public:
+    inline BenchTimer () { start (); }
+    inline void start () { begin = now (); }
+    inline unsigned long long elapsed () const { return now () - begin; }
+
+    static inline unsigned long long now () {
+        timespec ts;
+        clock_gettime (CLOCK_MONOTONIC, &ts);
+        return static_cast<unsigned long long> (ts.tv_sec) * 1000000000ULL + ts.tv_nsec;
+    }
+
+private:
+    unsigned long long begin;
+};
+
+// Small LCG, so that the ray sets are the same on every platform and libc
+// (unlike rand ()).
+class BenchRandom {
+public:
+    inline BenchRandom (unsigned int seed) : state (seed * 2654435761u + 1) {}
+    inline unsigned int next () {
+        state = state * 1664525u + 1013904223u;
+        return state;
+    }
+    // Uniform in [0,1[.
+    inline float uniform () { return (next () >> 8) * (1.0f / 16777216.0f); }
+    inline unsigned int below (unsigned int n) { return static_cast<unsigned int> (uniform () * n) % n; }
+
+private:
+    unsigned int state;
+};
+
+// One JSON object per line, flat, with string and number values.
+class BenchRecord {
+public:
+    inline BenchRecord & add (const std::string & key, const std::string & value) {
+        fields.push_back (quote (key) + ":" + quote (value));
+        return *this;
+    }
+    inline BenchRecord & add (const std::string & key, double value) {
+        char buffer[64];
+        snprintf (buffer, sizeof (buffer), "%.6g", value);
+        fields.push_back (quote (key) + ":" + buffer);
+        return *this;
+    }
+    inline BenchRecord & add (const std::string & key, unsigned long long value) {
+        char buffer[32];
+        snprintf (buffer, sizeof (buffer), "%llu", value);
+        fields.push_back (quote (key) + ":" + buffer);
+        return *this;
+    }
+    inline void print (FILE * output) const {
+        std::string line ("{");
+        for (unsigned int i = 0; i < fields.size (); i++)
+            line += (i ? "," : "") + fields[i];
+        fprintf (output, "%s}\n", line.c_str ());
+        fflush (output);
+    }
+
+private:
+    static inline std::string quote (const std::string & s) {
+        std::string q ("\"");
+        for (unsigned int i = 0; i < s.size (); i++) {
+            if (s[i] == '"' || s[i] == '\\')
+                q += '\\';
+            q += s[i];
+        }
+        return q + "\"";
+    }
+
+    std::vector<std::string> fields;
+};
+
+// Median of a set of timings.
+inline unsigned long long benchMedian (std::vector<unsigned long long> samples) {
+    if (samples.empty ())
+        return 0;
+    std::sort (samples.begin (), samples.end ());
+    return samples[samples.size () / 2];
+}
+
+#endif // BENCH_H
+
+// Some Emacs-Hints -- please don't remove:
+//
+//  Local Variables:
+//  mode:C++
+//  tab-width:4
+//  End:
@@ -0,0 +1,578 @@
+// *********************************************************
+// Micro-benchmarks of the intersection and traversal kernels
+// of the ray tracer: ray/box, ray/triangle, full object
+// intersection (plain and compressed geometry), shadow queries,
+// KD-tree construction, the import cleanup and the smooth
+// normals of the meshes, and the gather of triangles from the
+// editable and the render meshes.
+// The kernels built on the leaf intersection are run with each
+// of its instruction-set variants the CPU supports, and their
+// results checked against the scalar variant.
+//
+// qmake bench/microbench.pro && make, then run from the
+// directory holding models/ (or pass -models <dir>).
+// *********************************************************
+
+#include <string>
+#include <vector>
+#include <iostream>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "Bench.h"
+#include "Hash.h"
+#include "AllocationCounter.h"
+#include "PerfCounters.h"
+#include "Mesh.h"
+#include "Object.h"
+#include "Ray.h"
+#include "KDTree.h"
+#include "RayKernels.h"
+#include "RenderSettings.h"
+
+using namespace std;
+
+// A kernel runs a fixed set of operations; run returns a checksum of the
+// results (e.g. number of hits), reported along with the timings so that a
+// faster kernel that changed the results shows up.
+class Kernel {
+public:
+    Kernel (const string & name, const string & model, unsigned int nbOps)
+        : name (name), model (model), nbOps (nbOps), throughputUnit ("rays_per_s"), item ("ray"), itemsPerOp (1),
+          usesLeafKernel (false), geometryBytes (0) {}
+    virtual ~Kernel () {}
+    virtual unsigned long long run () = 0;
+
+    string name;
+    string model;
+    unsigned int nbOps;
+    string throughputUnit;
+    string item;              // what the hardware counters are reported per
+    unsigned int itemsPerOp;  // rays, or triangles, per operation
+    bool usesLeafKernel;      // run once per RayKernels variant
+    unsigned long long geometryBytes;  // of the mesh it reads, reported if not 0
+};
+
+// Primary ray through (x, y) in pixels, computed as in RayTracer::shadePixel.
+static Ray cameraRay (const RenderCamera & c, float x, float y, const Vec3Df & trans)
+{
+    float tanX = tan (c.fieldOfView) * c.aspectRatio;
+    float tanY = tan (c.fieldOfView);
+    Vec3Df stepX = (x - c.screenWidth / 2.f) * (tanX / c.screenWidth) * c.rightVector;
+    Vec3Df stepY = (y - c.screenHeight / 2.f) * (tanY / c.screenHeight) * c.upVector;
+    Vec3Df dir = c.viewDirection + stepX + stepY;
+    dir.normalize ();
+    return Ray (c.position - trans, dir);
+}
+
+// Rays of a 512x512 view fitted to the object, at random sub-pixel
+// positions, in object space.
+static void makePrimaryRays (const Object & o, unsigned int nbRays, unsigned int seed, vector<Ray> & rays)
+{
+    RenderCamera camera = RenderCamera::fitBoundingBox (o.getBoundingBox (), 512, 512);
+    BenchRandom random (seed);
+    rays.resize (nbRays);
+    for (unsigned int i = 0; i < nbRays; i++)
+        rays[i] = cameraRay (camera, 512.f * random.uniform (), 512.f * random.uniform (), Vec3Df ());
+}
+
+class BoxKernel : public Kernel {
+public:
+    BoxKernel (const string & model, const Object & o, const vector<Ray> & rays)
+        : Kernel ("ray_box", model, rays.size ()), kdtree (o.getKDTree ()), rays (rays) {}
+    unsigned long long run () {
+        // Boxes of the KD-tree nodes, from the root to the leaves, as seen
+        // by a traversal.
+        const KDFlatNode * nodes = kdtree.getNodes ();
+        unsigned int nbNodes = kdtree.getNbNodes ();
+        unsigned long long hits = 0;
+        float tNear, tFar;
+        for (unsigned int i = 0; i < rays.size (); i++)
+            if (rays[i].intersect (nodes[i % nbNodes].bBox, tNear, tFar))
+                hits++;
+        return hits;
+    }
+private:
+    const KDTree & kdtree;
+    const vector<Ray> & rays;
+};
+
+class TriangleKernel : public Kernel {
+public:
+    TriangleKernel (const string & model, const Object & o, const vector<Ray> & rays, unsigned int seed)
+        : Kernel ("ray_triangle", model, rays.size ()), mesh (o.getRenderMesh ()), rays (rays) {
+        // Half of the tests against a triangle the ray is aimed at, half
+        // against a random one (mostly misses).
+        RenderCamera camera = RenderCamera::fitBoundingBox (o.getBoundingBox (), 512, 512);
+        BenchRandom random (seed);
+        const Vec3Df * P = mesh.getPositions ();
+        const unsigned int * T = mesh.getIndices ();
+        triangles.resize (rays.size ());
+        aimed.resize (rays.size ());
+        for (unsigned int i = 0; i < rays.size (); i++) {
+            triangles[i] = random.below (mesh.getNbTriangles ());
+            if (i % 2)
+                continue;
+            float a = random.uniform (), b = random.uniform ();
+            if (a + b > 1.f) {
+                a = 1.f - a;
+                b = 1.f - b;
+            }
+            const unsigned int * v = T + 3 * triangles[i];
+            Vec3Df target = (1.f - a - b) * P[v[0]] + a * P[v[1]] + b * P[v[2]];
+            Vec3Df dir = target - camera.position;
+            dir.normalize ();
+            aimed[i] = Ray (camera.position, dir);
+        }
+    }
+    unsigned long long run () {
+        const Vec3Df * P = mesh.getPositions ();
+        const unsigned int * T = mesh.getIndices ();
+        unsigned long long hits = 0;
+        float t, coef1, coef2;
+        for (unsigned int i = 0; i < rays.size (); i++) {
+            const Ray & ray = (i % 2) ? rays[i] : aimed[i];
+            const unsigned int * v = T + 3 * triangles[i];
+            if (ray.intersectTriangle (P[v[0]], P[v[1]], P[v[2]], t, coef1, coef2))
+                hits++;
+        }
+        return hits;
+    }
+private:
+    const RenderMesh & mesh;
+    const vector<Ray> & rays;
+    vector<Ray> aimed;
+    vector<unsigned int> triangles;
+};
+
+// All the triangles of a leaf of the KD-tree, as tested by the traversal
+// when it reaches the leaf: the leaves are taken in turn, empty ones skipped.
+// The checksum hashes the triangle, distance and barycentric coordinates of
+// each hit, which every variant must give bit for bit.
+class LeafKernel : public Kernel {
+public:
+    LeafKernel (const string & model, const Object & o, const vector<Ray> & rays)
+        : Kernel ("ray_leaf", model, rays.size ()), mesh (o.getRenderMesh ()), kdtree (o.getKDTree ()), rays (rays) {
+        usesLeafKernel = true;
+        const KDFlatNode * nodes = kdtree.getNodes ();
+        for (unsigned int i = 0; i < kdtree.getNbNodes (); i++)
+            if (nodes[i].leaf && nodes[i].nbTriangles > 0)
+                leaves.push_back (i);
+        if (leaves.empty ())
+            nbOps = 0;
+    }
+    unsigned long long run () {
+        const KDFlatNode * nodes = kdtree.getNodes ();
+        const unsigned int * leafTriangles = kdtree.getTriangles ();
+        Hash hits;
+        for (unsigned int i = 0; i < rays.size (); i++) {
+            const KDFlatNode & leaf = nodes[leaves[i % leaves.size ()]];
+            float tMin = INFINITY, coef1, coef2;
+            unsigned int triangle;
+            if (RayKernels::intersectLeaf (rays[i], mesh.getPositions (), mesh.getIndices (),
+                                           leafTriangles + leaf.firstTriangle, leaf.nbTriangles,
+                                           tMin, triangle, coef1, coef2)) {
+                hits.add (i);
+                hits.add (triangle);
+                hits.add (tMin);
+                hits.add (coef1);
+                hits.add (coef2);
+            }
+        }
+        return hits.get ();
+    }
+private:
+    const RenderMesh & mesh;
+    const KDTree & kdtree;
+    const vector<Ray> & rays;
+    vector<unsigned int> leaves;
+};
+
+class ObjectKernel : public Kernel {
+public:
+    ObjectKernel (const string & model, const Object & o, const vector<Ray> & rays)
+        : Kernel (o.getRenderMesh ().isCompressed () ? "intersect_object_compressed" : "intersect_object",
+                  model, rays.size ()), o (o), rays (rays) {
+        usesLeafKernel = true;
+        const KDTree & kdtree = o.getKDTree ();
+        geometryBytes = o.getRenderMesh ().getMemorySize ()
+            + static_cast<unsigned long long> (kdtree.getNbNodes ()) * sizeof (KDFlatNode) + kdtree.getIndexMemorySize ();
+    }
+    unsigned long long run () {
+        unsigned long long hits = 0;
+        Vertex v;
+        for (unsigned int i = 0; i < rays.size (); i++)
+            if (rays[i].intersectObject (o, v))
+                hits++;
+        return hits;
+    }
+private:
+    const Object & o;
+    const vector<Ray> & rays;
+};
+
+// Visibility of the light from the first hits of primary rays, tested over
+// all the objects with an early exit, as the hard shadows of the renderer.
+class ShadowKernel : public Kernel {
+public:
+    ShadowKernel (const vector<Object> & objects, const Vec3Df & lightPos, unsigned int nbRays, unsigned int seed)
+        : Kernel ("shadow", "scene", 0), objects (objects) {
+        BoundingBox bbox;
+        for (unsigned int k = 0; k < objects.size (); k++) {
+            const BoundingBox & b = objects[k].getBoundingBox ();
+            BoundingBox world (b.getMin () + objects[k].getTrans (), b.getMax () + objects[k].getTrans ());
+            if (k == 0)
+                bbox = world;
+            else
+                bbox.extendTo (world);
+        }
+        RenderCamera camera = RenderCamera::fitBoundingBox (bbox, 512, 512);
+        BenchRandom random (seed);
+        for (unsigned int attempt = 0; attempt < 4 * nbRays && points.size () < nbRays; attempt++) {
+            float x = 512.f * random.uniform (), y = 512.f * random.uniform ();
+            float nearest = 1e30f;
+            Vec3Df point;
+            for (unsigned int k = 0; k < objects.size (); k++) {
+                Vertex v;
+                Ray ray = cameraRay (camera, x, y, objects[k].getTrans ());
+                if (ray.intersectObject (objects[k], v)) {
+                    Vec3Df p = v.getPos () + objects[k].getTrans ();
+                    float d = Vec3Df::squaredDistance (p, camera.position);
+                    if (d < nearest) {
+                        nearest = d;
+                        point = p;
+                    }
+                }
+            }
+            if (nearest < 1e30f) {
+                Vec3Df dir = lightPos - point;
+                dir.normalize ();
+                points.push_back (point);
+                directions.push_back (dir);
+            }
+        }
+        nbOps = points.size ();
+        usesLeafKernel = true;
+    }
+    unsigned long long run () {
+        unsigned long long occluded = 0;
+        Vertex v;
+        for (unsigned int i = 0; i < points.size (); i++)
+            for (unsigned int k = 0; k < objects.size (); k++) {
+                Ray ray (points[i] - objects[k].getTrans (), directions[i]);
+                if (ray.intersectObject (objects[k], v)) {
+                    occluded++;
+                    break;
+                }
+            }
+        return occluded;
+    }
+private:
+    const vector<Object> & objects;
+    vector<Vec3Df> points;
+    vector<Vec3Df> directions;
+};
+
+// Bounding boxes of the triangles in a random order, as the leaves of a
+// traversal reach them: the same gather from the editable Mesh (Vertex and
+// Triangle objects) and from the packed RenderMesh, to compare their memory
+// and cache misses.
+class BoundsKernel : public Kernel {
+public:
+    BoundsKernel (const string & model, const Object & o, bool packed, unsigned int seed)
+        : Kernel (packed ? "bounds_render_mesh" : "bounds_mesh", model, o.getRenderMesh ().getNbTriangles ()),
+          mesh (o.getMesh ()), renderMesh (o.getRenderMesh ()), packed (packed) {
+        throughputUnit = "triangles_per_s";
+        item = "triangle";
+        geometryBytes = packed ? renderMesh.getMemorySize ()
+            : mesh.getVertices ().size () * sizeof (Vertex) + mesh.getTriangles ().size () * sizeof (Triangle);
+        BenchRandom random (seed);
+        order.resize (nbOps);
+        for (unsigned int i = 0; i < nbOps; i++)
+            order[i] = i;
+        for (unsigned int i = nbOps; i > 1; i--)
+            swap (order[i - 1], order[random.below (i)]);
+    }
+    unsigned long long run () {
+        float sum = 0.0f;
+        if (packed) {
+            const Vec3Df * P = renderMesh.getPositions ();
+            const unsigned int * T = renderMesh.getIndices ();
+            for (unsigned int i = 0; i < order.size (); i++) {
+                const unsigned int * v = T + 3 * order[i];
+                BoundingBox b (P[v[0]]);
+                b.extendTo (P[v[1]]);
+                b.extendTo (P[v[2]]);
+                sum += b.getSize ();
+            }
+        }
+        else {
+            const vector<Vertex> & V = mesh.getVertices ();
+            const vector<Triangle> & T = mesh.getTriangles ();
+            for (unsigned int i = 0; i < order.size (); i++) {
+                const Triangle & t = T[order[i]];
+                BoundingBox b (V[t.getVertex (0)].getPos ());
+                b.extendTo (V[t.getVertex (1)].getPos ());
+                b.extendTo (V[t.getVertex (2)].getPos ());
+                sum += b.getSize ();
+            }
+        }
+        return static_cast<unsigned long long> (sum);
+    }
+private:
+    const Mesh & mesh;
+    const RenderMesh & renderMesh;
+    bool packed;
+    vector<unsigned int> order;
+};
+
+class BuildKernel : public Kernel {
+public:
+    BuildKernel (const string & model, const RenderMesh & mesh, unsigned int seed)
+        : Kernel ("kdtree_build", model, 1), mesh (mesh), seed (seed) {
+        throughputUnit = "triangles_per_s";
+        item = "triangle";
+        itemsPerOp = mesh.getNbTriangles ();
+        geometryBytes = mesh.getMemorySize ();
+    }
+    unsigned long long run () {
+        // The median search picks its pivots with rand ().
+        srand (seed);
+        KDTree kdtree;
+        kdtree.buildKDTree (mesh);
+        return kdtree.getNbNodes ();
+    }
+private:
+    const RenderMesh & mesh;
+    unsigned int seed;
+};
+
+// Mesh::clean on a copy of the mesh as loaded, the copy included: both are
+// linear in the size of the mesh.
+class CleanKernel : public Kernel {
+public:
+    CleanKernel (const string & model, const Mesh & mesh, float weldTolerance)
+        : Kernel ("mesh_clean", model, 1), mesh (mesh), weldTolerance (weldTolerance) {
+        throughputUnit = "vertices_per_s";
+        item = "vertex";
+        itemsPerOp = mesh.getVertices ().size ();
+        geometryBytes = mesh.getVertices ().size () * sizeof (Vertex) + mesh.getTriangles ().size () * sizeof (Triangle);
+    }
+    unsigned long long run () {
+        Mesh cleaned (mesh);
+        Mesh::CleanReport report = cleaned.clean (weldTolerance);
+        return report.nbWeldedVertices + report.nbUnusedVertices
+            + report.nbDegenerateTriangles + report.nbDuplicateTriangles;
+    }
+private:
+    const Mesh & mesh;
+    float weldTolerance;
+};
+
+// Mesh::recomputeSmoothVertexNormals, in place: the normals only depend on
+// the positions. On the ThreadPool, of as many threads as CPUs.
+class NormalsKernel : public Kernel {
+public:
+    NormalsKernel (const string & model, const Mesh & mesh)
+        : Kernel ("mesh_normals", model, 1), mesh (mesh) {
+        throughputUnit = "vertices_per_s";
+        item = "vertex";
+        itemsPerOp = mesh.getVertices ().size ();
+        geometryBytes = mesh.getVertices ().size () * sizeof (Vertex) + mesh.getTriangles ().size () * sizeof (Triangle);
+    }
+    unsigned long long run () {
+        mesh.recomputeSmoothVertexNormals (0);
+        Hash h;
+        for (unsigned int i = 0; i < mesh.getVertices ().size (); i++)
+            h.add (mesh.getVertices ()[i].getNormal ());
+        return h.get ();
+    }
+private:
+    Mesh mesh;
+};
+
+static void usage (const char * name)
+{
+    cerr << "Usage: " << name << " [-models <dir>] [-rays <n>] [-repeat <n>] [-seed <n>] [-filter <name>] [-output <file>] [-isa <name>] [-perf] [-reorder]" << endl
+         << "Prints one JSON object per benchmark and model." << endl
+         << "-perf adds the hardware counters (cycles, instructions, cache and branch misses) per ray," << endl
+         << "measured on one more run of each benchmark, when perf_event is allowed." << endl
+         << "-isa runs the leaf intersection with this variant only (scalar, sse4.2, avx2, avx512)," << endl
+         << "instead of each one the CPU supports. Exits with 1 if a variant gives other results than" << endl
+         << "the scalar kernel." << endl
+         << "-reorder sorts the meshes for locality once loaded (Mesh::reorderForLocality), to compare" << endl
+         << "the rays per second and cache misses with a run in file order." << endl;
+}
+
+int main (int argc, char ** argv)
+{
+    string modelsDir ("models"), filter, outputName;
+    unsigned int nbRays = 100000, nbRepeats = 5, seed = 1;
+    bool perf = false, reorder = false;
+    vector<RayKernels::Isa> isas;
+    for (int i = 1; i < argc; i++) {
+        string arg (argv[i]);
+        bool hasValue = (i + 1 < argc);
+        if (arg == "-models" && hasValue)
+            modelsDir = argv[++i];
+        else if (arg == "-rays" && hasValue && atoi (argv[i+1]) > 0)
+            nbRays = atoi (argv[++i]);
+        else if (arg == "-repeat" && hasValue && atoi (argv[i+1]) > 0)
+            nbRepeats = atoi (argv[++i]);
+        else if (arg == "-seed" && hasValue)
+            seed = atoi (argv[++i]);
+        else if (arg == "-filter" && hasValue)
+            filter = argv[++i];
+        else if (arg == "-output" && hasValue)
+            outputName = argv[++i];
+        else if (arg == "-perf")
+            perf = true;
+        else if (arg == "-reorder")
+            reorder = true;
+        else if (arg == "-isa" && hasValue) {
+            RayKernels::Isa isa;
+            if (!RayKernels::parse (argv[++i], isa) || !RayKernels::isSupported (isa)) {
+                cerr << argv[i] << " is not a variant this CPU supports." << endl;
+                return 1;
+            }
+            isas.push_back (isa);
+        }
+        else {
+            usage (argv[0]);
+            return 1;
+        }
+    }
+    FILE * output = stdout;
+    if (!outputName.empty () && (output = fopen (outputName.c_str (), "w")) == NULL) {
+        perror (outputName.c_str ());
+        return 1;
+    }
+
+    // The objects of Scene::buildDefaultScene.
+    const char * names[] = { "ground", "monkey" };
+    const Vec3Df trans[] = { Vec3Df (0.0f, 0.0f, 0.0f), Vec3Df (0.0f, 0.0f, 1.0f) };
+    const unsigned int nbModels = 2;
+    vector<Mesh> meshes (nbModels);
+    vector<Object> objects;
+    try {
+        for (unsigned int m = 0; m < nbModels; m++) {
+            meshes[m].loadOFF (modelsDir + "/" + names[m] + ".off");
+            if (reorder)
+                meshes[m].reorderForLocality ();
+            srand (seed);
+            Object o (meshes[m], Material ());
+            o.setTrans (trans[m]);
+            objects.push_back (o);
+        }
+    } catch (const Mesh::Exception & e) {
+        cerr << e.getMessage () << " (" << modelsDir << ")" << endl;
+        return 1;
+    }
+
+    if (isas.empty ())
+        for (int i = 0; i < RayKernels::NbIsas; i++)
+            if (RayKernels::isSupported (static_cast<RayKernels::Isa> (i)))
+                isas.push_back (static_cast<RayKernels::Isa> (i));
+
+    PerfCounters counters;
+    if (perf && !counters.open ())
+        cerr << "No hardware counters: " << counters.getError () << endl;
+
+    // Same objects, compressed (Object::compress), against the plain ones.
+    vector<Object> compressedObjects (objects);
+    for (unsigned int m = 0; m < nbModels; m++)
+        compressedObjects[m].compress ();
+
+    vector<vector<Ray> > rays (nbModels);
+    vector<Kernel *> kernels;
+    for (unsigned int m = 0; m < nbModels; m++) {
+        makePrimaryRays (objects[m], nbRays, seed + m, rays[m]);
+        kernels.push_back (new BoxKernel (names[m], objects[m], rays[m]));
+        kernels.push_back (new TriangleKernel (names[m], objects[m], rays[m], seed + m));
+        kernels.push_back (new LeafKernel (names[m], objects[m], rays[m]));
+        kernels.push_back (new ObjectKernel (names[m], objects[m], rays[m]));
+        kernels.push_back (new ObjectKernel (names[m], compressedObjects[m], rays[m]));
+        kernels.push_back (new BoundsKernel (names[m], objects[m], false, seed + m));
+        kernels.push_back (new BoundsKernel (names[m], objects[m], true, seed + m));
+    }
+    kernels.push_back (new ShadowKernel (objects, Vec3Df (3.0f, 3.0f, 3.0f), nbRays, seed));
+    for (unsigned int m = 0; m < nbModels; m++)
+        kernels.push_back (new BuildKernel (names[m], objects[m].getRenderMesh (), seed));
+    for (unsigned int m = 0; m < nbModels; m++)
+        kernels.push_back (new CleanKernel (names[m], meshes[m], 1e-5f));
+    for (unsigned int m = 0; m < nbModels; m++)
+        kernels.push_back (new NormalsKernel (names[m], meshes[m]));
+
+    bool mismatch = false;
+    for (unsigned int k = 0; k < kernels.size (); k++) {
+        Kernel & kernel = *kernels[k];
+        if (!filter.empty () && kernel.name.find (filter) == string::npos)
+            continue;
+        if (kernel.nbOps == 0)
+            continue;
+        // The variants must give the results of the scalar kernel.
+        unsigned long long reference = 0;
+        if (kernel.usesLeafKernel) {
+            RayKernels::setIsa (RayKernels::Scalar);
+            reference = kernel.run ();
+        }
+        for (unsigned int v = 0; v < (kernel.usesLeafKernel ? isas.size () : 1); v++) {
+            if (kernel.usesLeafKernel)
+                RayKernels::setIsa (isas[v]);
+            // Warm-up, then the timed runs.
+            unsigned long long checksum = kernel.run ();
+            if (kernel.usesLeafKernel && checksum != reference) {
+                cerr << kernel.name << " (" << kernel.model << ") gives other results with "
+                     << RayKernels::getName (isas[v]) << " than with the scalar kernel." << endl;
+                mismatch = true;
+            }
+            vector<unsigned long long> samples;
+            unsigned long long nbAllocations = 0;
+            for (unsigned int r = 0; r < nbRepeats; r++) {
+                AllocationCounter::reset ();
+                BenchTimer timer;
+                unsigned long long result = kernel.run ();
+                unsigned long long elapsed = timer.elapsed ();
+                nbAllocations += AllocationCounter::get ();
+                samples.push_back (elapsed);
+                if (result != checksum)
+                    cerr << kernel.name << " (" << kernel.model << ") is not deterministic." << endl;
+            }
+            double allocationsPerOp = double (nbAllocations) / (double (nbRepeats) * kernel.nbOps);
+            unsigned long long best = *min_element (samples.begin (), samples.end ());
+            double bestPerOp = double (best) / kernel.nbOps;
+            double throughput = 1e9 / bestPerOp * kernel.itemsPerOp;
+            BenchRecord record;
+            record
+                .add ("benchmark", kernel.name)
+                .add ("model", kernel.model)
+                .add ("isa", kernel.usesLeafKernel ? RayKernels::getName (isas[v]) : "none")
+                .add ("mesh_order", reorder ? "morton" : "file")
+                .add ("ops", static_cast<unsigned long long> (kernel.nbOps))
+                .add ("repeat", static_cast<unsigned long long> (nbRepeats))
+                .add ("best_ns_per_op", bestPerOp)
+                .add ("median_ns_per_op", double (benchMedian (samples)) / kernel.nbOps)
+                .add (kernel.throughputUnit, throughput)
+                .add ("allocations_per_op", allocationsPerOp)
+                .add ("checksum", checksum);
+            if (kernel.geometryBytes > 0)
+                record.add ("geometry_bytes", kernel.geometryBytes);
+            if (counters.isOpen ()) {
+                // On a run of its own, to leave the timed runs undisturbed.
+                counters.reset ();
+                counters.start ();
+                kernel.run ();
+                counters.stop ();
+                counters.add (record, double (kernel.nbOps) * kernel.itemsPerOp, kernel.item);
+            }
+            record.print (output);
+        }
+    }
+
+    for (unsigned int k = 0; k < kernels.size (); k++)
+        delete kernels[k];
+    if (output != stdout)
+        fclose (output);
+    return (mismatch ? 1 : 0);
+}
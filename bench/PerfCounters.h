@@ -0,0 +1,173 @@
+// *********************************************************
+// Hardware performance counters
+// Cycles, instructions, cache and branch misses of the calling
+// thread (user space only) through Linux perf_event, to tell a
+// memory-bound kernel from a compute-bound one. When perf_event
+// is missing or restricted (perf_event_paranoid, containers,
+// some VMs), the counters are reported as unavailable and the
+// benchmarks run as usual.
+// *********************************************************
+
+#ifndef PERFCOUNTERS_H
+#define PERFCOUNTERS_H
+
+#include <string>
+#include <cstring>
+#include <cerrno>
+
+#include "Bench.h"
+
+#ifdef __linux__
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+class PerfCounters {
+public:
+    enum Event { Cycles = 0, Instructions, L1DMisses, LLCMisses, BranchMisses, NB_EVENTS };
+
+    inline PerfCounters () : nbOpen (0) {
+        for (unsigned int e = 0; e < NB_EVENTS; e++)
+            fd[e] = -1;
+        reset ();
+    }
+    inline ~PerfCounters () { close (); }
+
+    static inline const char * getName (Event e) {
+        static const char * names[NB_EVENTS] =
+            { "cycles", "instructions", "l1d_misses", "llc_misses", "branch_misses" };
+        return names[e];
+    }
+
+    // Opens the counters the machine and the permissions allow. Returns
+    // false, with the reason in getError, when none can be read.
+    bool open ();
+    void close ();
+    inline bool isOpen () const { return nbOpen > 0; }
+    inline bool isAvailable (Event e) const { return fd[e] >= 0; }
+    inline const std::string & getError () const { return error; }
+
+    // The counts accumulate over the start/stop pairs until reset.
+    inline void reset () {
+        for (unsigned int e = 0; e < NB_EVENTS; e++)
+            counts[e] = 0.0;
+    }
+    void start ();
+    void stop ();
+    // Scaled up when the kernel multiplexed the counters.
+    inline double get (Event e) const { return counts[e]; }
+
+    // <event>_per_<item> for the available counters, and ipc.
+    void add (BenchRecord & record, double nbItems, const std::string & item) const {
+        for (unsigned int e = 0; e < NB_EVENTS; e++)
+            if (isAvailable (Event (e)))
+                record.add (std::string (getName (Event (e))) + "_per_" + item, counts[e] / nbItems);
+        if (isAvailable (Cycles) && isAvailable (Instructions) && counts[Cycles] > 0.0)
+            record.add ("ipc", counts[Instructions] / counts[Cycles]);
+    }
+
+private:
+    PerfCounters (const PerfCounters &);
+    PerfCounters & operator= (const PerfCounters &);
+
+    int fd[NB_EVENTS];
+    double counts[NB_EVENTS];
+    unsigned int nbOpen;
+    std::string error;
+};
+
+#ifdef __linux__
+
+inline bool PerfCounters::open () {
+    static const unsigned int types[NB_EVENTS] =
+        { PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HW_CACHE, PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE };
+    static const unsigned long long configs[NB_EVENTS] = {
+        PERF_COUNT_HW_CPU_CYCLES,
+        PERF_COUNT_HW_INSTRUCTIONS,
+        PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16),
+        PERF_COUNT_HW_CACHE_MISSES,
+        PERF_COUNT_HW_BRANCH_MISSES
+    };
+    close ();
+    int firstErrno = 0;
+    for (unsigned int e = 0; e < NB_EVENTS; e++) {
+        perf_event_attr attr;
+        memset (&attr, 0, sizeof (attr));
+        attr.size = sizeof (attr);
+        attr.type = types[e];
+        attr.config = configs[e];
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+        fd[e] = syscall (__NR_perf_event_open, &attr, 0, -1, -1, 0);
+        if (fd[e] >= 0)
+            nbOpen++;
+        else if (firstErrno == 0)
+            firstErrno = errno;
+    }
+    if (nbOpen > 0)
+        return true;
+    if (firstErrno == EACCES || firstErrno == EPERM)
+        error = "perf_event access denied (see /proc/sys/kernel/perf_event_paranoid)";
+    else if (firstErrno == ENOENT || firstErrno == EOPNOTSUPP || firstErrno == ENOSYS)
+        error = "no hardware counters on this machine";
+    else
+        error = std::string ("perf_event_open failed: ") + strerror (firstErrno);
+    return false;
+}
+
+inline void PerfCounters::close () {
+    for (unsigned int e = 0; e < NB_EVENTS; e++)
+        if (fd[e] >= 0) {
+            ::close (fd[e]);
+            fd[e] = -1;
+        }
+    nbOpen = 0;
+}
+
+inline void PerfCounters::start () {
+    for (unsigned int e = 0; e < NB_EVENTS; e++)
+        if (fd[e] >= 0) {
+            ioctl (fd[e], PERF_EVENT_IOC_RESET, 0);
+            ioctl (fd[e], PERF_EVENT_IOC_ENABLE, 0);
+        }
+}
+
+inline void PerfCounters::stop () {
+    for (unsigned int e = 0; e < NB_EVENTS; e++)
+        if (fd[e] >= 0)
+            ioctl (fd[e], PERF_EVENT_IOC_DISABLE, 0);
+    for (unsigned int e = 0; e < NB_EVENTS; e++) {
+        // value, time enabled, time running
+        unsigned long long values[3];
+        if (fd[e] < 0 || read (fd[e], values, sizeof (values)) != sizeof (values))
+            continue;
+        if (values[2] > 0)
+            counts[e] += double (values[0]) * values[1] / values[2];
+    }
+}
+
+#else
+
+inline bool PerfCounters::open () {
+    nbOpen = 0;
+    error = "perf_event is Linux only";
+    return false;
+}
+inline void PerfCounters::close () { nbOpen = 0; }
+inline void PerfCounters::start () {}
+inline void PerfCounters::stop () {}
+
+#endif
+
+#endif // PERFCOUNTERS_H
+
+// Some Emacs-Hints -- please don't remove:
+//
+//  Local Variables:
+//  mode:C++
+//  tab-width:4
+//  End:
@@ -0,0 +1,468 @@
+// *********************************************************
+// End-to-end benchmark of whole frames on reference scenes.
+// Renders fixed scenes from fixed cameras at several sizes and
+// sampling settings, records the timings and the peak memory
+// to CSV, and compares them with a baseline CSV of a previous
+// run: exits with 2 if a case got slower than the tolerance,
+// or if rendering its pixels allocated memory on the heap.
+//
+// qmake bench/scenebench.pro && make, then run from the
+// directory holding models/ (or pass -models <dir>).
+// *********************************************************
+
+#include <QApplication>
+#include <QImage>
+
+#include <string>
+#include <vector>
+#include <map>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <cstdio>
+#include <cstdlib>
+
+#include "Bench.h"
+#include "AllocationCounter.h"
+#include "PerfCounters.h"
+#include "Mesh.h"
+#include "Object.h"
+#include "Scene.h"
+#include "SceneGenerator.h"
+#include "KDTreeTuner.h"
+#include "RayTracer.h"
+#include "RenderSettings.h"
+#include "RayKernels.h"
+#include "ScratchArena.h"
+
+using namespace std;
+
+// Objects of a reference scene: a model placed at a translation.
+struct Placement {
+    string model;
+    Vec3Df trans;
+    Material material;
+};
+
+// Either models from OFF files, or a synthetic scene.
+struct ReferenceScene {
+    string name;
+    vector<Placement> placements;
+    string generator;
+};
+
+// Size and sampling of a frame.
+struct FrameConfig {
+    unsigned int width;
+    unsigned int height;
+    unsigned int nbRaysPerPixel;
+    string shadows;  // soft, hard or none
+    unsigned int nbPointsDisc;
+};
+
+struct Measure {
+    double loadMs;
+    double buildMs;
+    double renderMs;
+    double primaryRaysPerSecond;
+    unsigned long long peakRssKb;
+    // Heap allocations of RayTracer::renderTile over the whole frame, after
+    // the timed renders: through operator new, or by the scratch arena once
+    // its block is full (posix_memalign, not seen by AllocationCounter).
+    unsigned long long tileAllocations;
+};
+
+static const char * CSV_HEADER = "case,load_ms,build_ms,render_ms,primary_rays_per_s,peak_rss_kb,tile_allocations";
+
+// Hardware counters of the build (per triangle) and of the renders (per
+// primary ray); an empty field is a counter the machine does not give.
+static const char * PERF_CSV_HEADER = "case,phase,unit,cycles,instructions,ipc,l1d_misses,llc_misses,branch_misses";
+
+static void printPerf (FILE * output, const string & name, const char * phase, const char * unit,
+                       const PerfCounters & counters, double nbItems)
+{
+    fprintf (output, "%s,%s,%s", name.c_str (), phase, unit);
+    for (unsigned int e = 0; e < PerfCounters::NB_EVENTS; e++) {
+        PerfCounters::Event event = PerfCounters::Event (e);
+        if (counters.isAvailable (event))
+            fprintf (output, ",%.6g", counters.get (event) / nbItems);
+        else
+            fprintf (output, ",");
+        if (event == PerfCounters::Instructions) {
+            if (counters.isAvailable (PerfCounters::Cycles) && counters.isAvailable (PerfCounters::Instructions)
+                && counters.get (PerfCounters::Cycles) > 0.0)
+                fprintf (output, ",%.3f", counters.get (PerfCounters::Instructions) / counters.get (PerfCounters::Cycles));
+            else
+                fprintf (output, ",");
+        }
+    }
+    fprintf (output, "\n");
+    fflush (output);
+}
+
+static void buildReferenceScenes (vector<ReferenceScene> & scenes)
+{
+    Material monkeyMat (1.f, 1.f, Vec3Df (1.f, .6f, .2f));
+
+    // Scene::buildDefaultScene.
+    ReferenceScene simple;
+    simple.name = "default";
+    Placement ground = { "ground", Vec3Df (0.f, 0.f, 0.f), Material () };
+    Placement monkey = { "monkey", Vec3Df (0.f, 0.f, 1.f), monkeyMat };
+    simple.placements.push_back (ground);
+    simple.placements.push_back (monkey);
+    scenes.push_back (simple);
+
+    // Ground and grids of monkeys, n x n, one unit apart.
+    unsigned int sizes[] = { 3, 6 };
+    for (unsigned int s = 0; s < 2; s++) {
+        unsigned int n = sizes[s];
+        ReferenceScene grid;
+        ostringstream name;
+        name << "grid" << n << "x" << n;
+        grid.name = name.str ();
+        grid.placements.push_back (ground);
+        for (unsigned int i = 0; i < n; i++)
+            for (unsigned int j = 0; j < n; j++) {
+                Placement p = monkey;
+                p.trans = Vec3Df (float (i) - (n - 1) / 2.f, float (j) - (n - 1) / 2.f, 1.f);
+                grid.placements.push_back (p);
+            }
+        scenes.push_back (grid);
+    }
+}
+
+static void buildFrameConfigs (bool quick, vector<FrameConfig> & configs)
+{
+    FrameConfig preview = { 160, 120, 1, "hard", 1 };
+    FrameConfig medium = { 320, 240, 2, "soft", 8 };
+    FrameConfig full = { 640, 480, 2, "soft", 20 };  // default RenderSettings
+    configs.push_back (preview);
+    if (quick)
+        return;
+    configs.push_back (medium);
+    configs.push_back (full);
+}
+
+static string caseName (const ReferenceScene & scene, const FrameConfig & config)
+{
+    ostringstream s;
+    s << scene.name << "/" << config.width << "x" << config.height
+      << "/r" << config.nbRaysPerPixel << "/" << config.shadows;
+    if (config.shadows == "soft")
+        s << config.nbPointsDisc;
+    return s.str ();
+}
+
+// Peak resident set size since the last reset, in kB (Linux only, 0 elsewhere).
+static void resetPeakRss ()
+{
+    ofstream clearRefs ("/proc/self/clear_refs");
+    if (clearRefs)
+        clearRefs << "5" << endl;
+}
+
+static unsigned long long getPeakRss ()
+{
+    ifstream status ("/proc/self/status");
+    string line;
+    while (getline (status, line))
+        if (line.compare (0, 6, "VmHWM:") == 0)
+            return strtoull (line.c_str () + 6, NULL, 10);
+    return 0;
+}
+
+static bool loadBaseline (const string & filename, map<string, Measure> & baseline)
+{
+    ifstream input (filename.c_str ());
+    if (!input)
+        return false;
+    string line;
+    getline (input, line);
+    // Or the header of older runs, without the last columns.
+    if (line.empty () || string (CSV_HEADER).compare (0, line.size (), line) != 0)
+        return false;
+    while (getline (input, line)) {
+        for (unsigned int i = 0; i < line.size (); i++)
+            if (line[i] == ',')
+                line[i] = ' ';
+        istringstream fields (line);
+        string name;
+        Measure m;
+        if (fields >> name >> m.loadMs >> m.buildMs >> m.renderMs >> m.primaryRaysPerSecond >> m.peakRssKb)
+            baseline[name] = m;
+    }
+    return true;
+}
+
+// Relative increase of current over reference, for the regression check.
+static double slowdown (double current, double reference)
+{
+    return (reference > 0.0) ? current / reference - 1.0 : 0.0;
+}
+
+static void usage (const char * name)
+{
+    cerr << "Usage: " << name << " [-models <dir>] [-generate <parameters>]... [-filter <scene>] [-quick] [-repeat <n> (best of, 3)]" << endl
+         << "       [-output <csv>] [-baseline <csv>] [-tolerance <fraction>] [-perf <csv>] [-isa <name>] [-compress] [-reorder] [-clean <tolerance>]" << endl
+         << "Exits with 2 when a case is slower (render or build time) or bigger (peak RSS)" << endl
+         << "than in the baseline by more than the tolerance (default 0.1), or when" << endl
+         << "RayTracer::renderTile allocates on the heap." << endl
+         << "Each -generate adds a synthetic scene (see raymini -generate), in place of the" << endl
+         << "reference scenes, e.g. to measure the scaling with the number of instances." << endl
+         << "-perf writes the hardware counters of the builds and renders, when perf_event is allowed." << endl
+         << "-isa renders with this variant of the intersection kernel (scalar, sse4.2, avx2, avx512)" << endl
+         << "instead of the best one the CPU supports." << endl
+         << "-compress compresses the objects (raymini -compress): against a baseline of a plain run," << endl
+         << "the render and RSS columns give the throughput lost and the memory saved." << endl
+         << "-reorder reorders the meshes for locality once loaded (raymini -reorder), to compare" << endl
+         << "with a baseline of a plain run in the same way." << endl
+         << "-clean cleans the meshes once loaded (raymini -clean), in the load time." << endl;
+}
+
+int main (int argc, char ** argv)
+{
+    QApplication app (argc, argv, false);
+
+    string modelsDir ("models"), filter, outputName, baselineName, perfName;
+    bool quick = false, compress = false, reorder = false;
+    unsigned int nbRepeats = 3;
+    double tolerance = 0.1;
+    float cleanTolerance = -1.0f;
+    vector<ReferenceScene> scenes;
+    for (int i = 1; i < argc; i++) {
+        string arg (argv[i]);
+        bool hasValue = (i + 1 < argc);
+        if (arg == "-models" && hasValue)
+            modelsDir = argv[++i];
+        else if (arg == "-generate" && hasValue) {
+            SceneGenerator::Parameters parameters;
+            try {
+                parameters.parse (argv[++i]);
+            } catch (const SceneGenerator::Exception & e) {
+                cerr << e.getMessage () << endl;
+                return 1;
+            }
+            ReferenceScene generated;
+            generated.generator = parameters.toString ();
+            // No commas in the CSV.
+            generated.name = generated.generator;
+            replace (generated.name.begin (), generated.name.end (), ',', ';');
+            scenes.push_back (generated);
+        }
+        else if (arg == "-filter" && hasValue)
+            filter = argv[++i];
+        else if (arg == "-quick")
+            quick = true;
+        else if (arg == "-compress")
+            compress = true;
+        else if (arg == "-reorder")
+            reorder = true;
+        else if (arg == "-clean" && hasValue && atof (argv[i+1]) >= 0.0)
+            cleanTolerance = atof (argv[++i]);
+        else if (arg == "-repeat" && hasValue && atoi (argv[i+1]) > 0)
+            nbRepeats = atoi (argv[++i]);
+        else if (arg == "-output" && hasValue)
+            outputName = argv[++i];
+        else if (arg == "-baseline" && hasValue)
+            baselineName = argv[++i];
+        else if (arg == "-tolerance" && hasValue)
+            tolerance = atof (argv[++i]);
+        else if (arg == "-perf" && hasValue)
+            perfName = argv[++i];
+        else if (arg == "-isa" && hasValue) {
+            RayKernels::Isa isa;
+            if (!RayKernels::parse (argv[++i], isa) || !RayKernels::setIsa (isa)) {
+                cerr << argv[i] << " is not a variant this CPU supports." << endl;
+                return 1;
+            }
+        }
+        else {
+            usage (argv[0]);
+            return 1;
+        }
+    }
+
+    map<string, Measure> baseline;
+    if (!baselineName.empty () && !loadBaseline (baselineName, baseline)) {
+        cerr << "Cannot read the baseline " << baselineName << endl;
+        return 1;
+    }
+    FILE * output = stdout;
+    if (!outputName.empty () && (output = fopen (outputName.c_str (), "w")) == NULL) {
+        perror (outputName.c_str ());
+        return 1;
+    }
+    fprintf (output, "%s\n", CSV_HEADER);
+    PerfCounters counters;
+    FILE * perfOutput = NULL;
+    if (!perfName.empty ()) {
+        if (!counters.open ())
+            cerr << "No hardware counters: " << counters.getError () << endl;
+        else if ((perfOutput = fopen (perfName.c_str (), "w")) == NULL) {
+            perror (perfName.c_str ());
+            return 1;
+        }
+        else
+            fprintf (perfOutput, "%s\n", PERF_CSV_HEADER);
+    }
+
+    if (scenes.empty ())
+        buildReferenceScenes (scenes);
+    else
+        // Then the default scene needs no model either.
+        Scene::setGeneratorSpec (scenes[0].generator);
+    vector<FrameConfig> configs;
+    buildFrameConfigs (quick, configs);
+
+    // The reference scenes replace the objects of the default scene, and
+    // keep its lights.
+    Scene * scene = Scene::getInstance ();
+    RayTracer * rayTracer = RayTracer::getInstance ();
+    unsigned int nbRegressions = 0;
+    for (unsigned int s = 0; s < scenes.size (); s++) {
+        const ReferenceScene & reference = scenes[s];
+        if (!filter.empty () && reference.name.find (filter) == string::npos)
+            continue;
+        scene->getObjects ().clear ();
+        resetPeakRss ();
+
+        Measure m;
+        map<string, Mesh> meshes;
+        BenchTimer timer;
+        try {
+            for (unsigned int p = 0; p < reference.placements.size (); p++) {
+                const string & model = reference.placements[p].model;
+                if (meshes.find (model) == meshes.end ()) {
+                    meshes[model].loadOFF (modelsDir + "/" + model + ".off");
+                    if (cleanTolerance >= 0.0f) {
+                        Mesh::CleanReport report = meshes[model].clean (cleanTolerance);
+                        meshes[model].recomputeSmoothVertexNormals (0);
+                        cerr << "Cleaned " << model << ": " << report << endl;
+                    }
+                    if (reorder)
+                        meshes[model].reorderForLocality ();
+                }
+            }
+        } catch (const Mesh::Exception & e) {
+            cerr << e.getMessage () << " (" << modelsDir << ")" << endl;
+            return 1;
+        }
+        m.loadMs = timer.elapsed () / 1e6;
+
+        counters.reset ();
+        counters.start ();
+        timer.start ();
+        if (!reference.generator.empty ()) {
+            SceneGenerator::Parameters parameters;
+            parameters.parse (reference.generator);
+            SceneGenerator (parameters).generate (*scene);
+        }
+        if (compress)
+            for (unsigned int o = 0; o < scene->getObjects ().size (); o++)
+                scene->getObjects ()[o].compress ();
+        for (unsigned int p = 0; p < reference.placements.size (); p++) {
+            const Placement & placement = reference.placements[p];
+            // Same pivots for the KD-tree median search on every run.
+            srand (1);
+            const Mesh & mesh = meshes[placement.model];
+            // With the parameters raymini -autotune cached for the model, if any.
+            Object o (mesh, placement.material,
+                      KDTreeTuner::get (modelsDir + "/" + placement.model + ".off", mesh, false));
+            o.setTrans (placement.trans);
+            if (compress)
+                o.compress ();
+            scene->getObjects ().push_back (o);
+        }
+        scene->updateBoundingBox ();
+        m.buildMs = timer.elapsed () / 1e6;
+        counters.stop ();
+        if (perfOutput != NULL) {
+            unsigned int nbTriangles = 0;
+            for (unsigned int o = 0; o < scene->getObjects ().size (); o++)
+                nbTriangles += scene->getObjects ()[o].getMesh ().getTriangles ().size ();
+            printPerf (perfOutput, reference.name, "build", "triangle", counters, nbTriangles);
+        }
+
+        for (unsigned int c = 0; c < configs.size (); c++) {
+            const FrameConfig & config = configs[c];
+            RenderSettings settings;
+            settings.nbRaysPerPixel = config.nbRaysPerPixel;
+            settings.softShadows = (config.shadows == "soft");
+            settings.hardShadows = (config.shadows == "hard");
+            settings.nbPointsDisc = config.nbPointsDisc;
+            rayTracer->setSettings (settings);
+            RenderCamera camera = RenderCamera::fitBoundingBox (scene->getBoundingBox (), config.width, config.height);
+
+            vector<unsigned long long> samples;
+            counters.reset ();
+            for (unsigned int r = 0; r < nbRepeats; r++) {
+                // The soft shadows sample the light with rand ().
+                srand (1);
+                counters.start ();
+                timer.start ();
+                rayTracer->render (camera);
+                samples.push_back (timer.elapsed ());
+                counters.stop ();
+            }
+            unsigned long long best = *min_element (samples.begin (), samples.end ());
+            m.renderMs = best / 1e6;
+            m.primaryRaysPerSecond = double (config.width) * config.height
+                * config.nbRaysPerPixel * config.nbRaysPerPixel / (best / 1e9);
+            m.peakRssKb = getPeakRss ();
+            unsigned long long tileOverflows = 0;
+
+            // The pixel loop allocates nothing: the whole frame as one tile,
+            // with the arena of the thread already sized by the renders.
+            {
+                QImage image (QSize (config.width, config.height), QImage::Format_RGB888);
+                RenderTile frame = { 0, 0, config.width, config.height };
+                srand (1);
+                const ScratchArena & arena = ScratchArena::getThreadArena ();
+                unsigned long long overflowsBefore = arena.getNbOverflows ();
+                AllocationCounter::reset ();
+                rayTracer->renderTile (camera, frame, image);
+                m.tileAllocations = AllocationCounter::get ();
+                tileOverflows = arena.getNbOverflows () - overflowsBefore;
+                m.tileAllocations += tileOverflows;
+            }
+
+            string name = caseName (reference, config);
+            if (perfOutput != NULL)
+                printPerf (perfOutput, name, "render", "primary_ray", counters,
+                           double (config.width) * config.height * config.nbRaysPerPixel * config.nbRaysPerPixel
+                           * nbRepeats);
+            fprintf (output, "%s,%.3f,%.3f,%.3f,%.6g,%llu,%llu\n", name.c_str (),
+                     m.loadMs, m.buildMs, m.renderMs, m.primaryRaysPerSecond, m.peakRssKb, m.tileAllocations);
+            fflush (output);
+            if (m.tileAllocations > 0) {
+                fprintf (stderr, "%-32s %llu heap allocation(s) in the pixel loop, %llu of them scratch arena overflows\n",
+                         name.c_str (), m.tileAllocations, tileOverflows);
+                nbRegressions++;
+            }
+
+            map<string, Measure>::const_iterator b = baseline.find (name);
+            if (b == baseline.end ())
+                continue;
+            const Measure & ref = b->second;
+            double render = slowdown (m.renderMs, ref.renderMs);
+            double build = slowdown (m.buildMs, ref.buildMs);
+            double rss = slowdown (m.peakRssKb, ref.peakRssKb);
+            bool regression = (render > tolerance || build > tolerance || rss > tolerance);
+            fprintf (stderr, "%-32s render %+6.1f%%  build %+6.1f%%  rss %+6.1f%%%s\n", name.c_str (),
+                     100.0 * render, 100.0 * build, 100.0 * rss, regression ? "  REGRESSION" : "");
+            if (regression)
+                nbRegressions++;
+        }
+    }
+
+    if (output != stdout)
+        fclose (output);
+    if (perfOutput != NULL)
+        fclose (perfOutput);
+    if (nbRegressions > 0) {
+        cerr << nbRegressions << " case(s) regressed by more than " << 100.0 * tolerance << "%." << endl;
+        return 2;
+    }
+    return 0;
+}
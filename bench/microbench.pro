@@ -0,0 +1,37 @@
+TEMPLATE = app
+TARGET   = raymini-microbench
+CONFIG  += warn_on console release
+CONFIG  -= qt
+INCLUDEPATH += ..
+HEADERS = Bench.h \
+          AllocationCounter.h \
+          PerfCounters.h
+SOURCES = MicroBench.cpp \
+          AllocationCounter.cpp \
+          ../Vertex.cpp \
+          ../Triangle.cpp \
+          ../Mesh.cpp \
+          ../MeshAdjacency.cpp \
+          ../ThreadPool.cpp \
+          ../Trace.cpp \
+          ../BoundingBox.cpp \
+          ../Material.cpp \
+          ../RenderMesh.cpp \
+          ../Object.cpp \
+          ../Ray.cpp \
+          ../RayKernels.cpp \
+          ../RayKernelsSSE42.cpp \
+          ../RayKernelsAVX2.cpp \
+          ../RayKernelsAVX512.cpp \
+          ../KDTree.cpp \
+          ../Node.cpp
+
+    DESTDIR=.
+
+unix {
+    LIBS += -lGL \
+	-lrt \
+	-lpthread
+}
+
+OBJECTS_DIR = .tmp
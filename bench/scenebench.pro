@@ -0,0 +1,46 @@
+TEMPLATE = app
+TARGET   = raymini-scenebench
+CONFIG  += qt warn_on console release
+INCLUDEPATH += ..
+HEADERS = Bench.h \
+          AllocationCounter.h \
+          PerfCounters.h
+SOURCES = SceneBench.cpp \
+          AllocationCounter.cpp \
+          ../Vertex.cpp \
+          ../Triangle.cpp \
+          ../Mesh.cpp \
+          ../MeshAdjacency.cpp \
+          ../ThreadPool.cpp \
+          ../BoundingBox.cpp \
+          ../Material.cpp \
+          ../RenderMesh.cpp \
+          ../Object.cpp \
+          ../Light.cpp \
+          ../AreaLight.cpp \
+          ../Scene.cpp \
+          ../SharedScene.cpp \
+          ../SceneGenerator.cpp \
+          ../RayTracer.cpp \
+          ../RenderStats.cpp \
+          ../RenderCostMap.cpp \
+          ../Trace.cpp \
+          ../KDTreeTuner.cpp \
+          ../RayKernels.cpp \
+          ../RayKernelsSSE42.cpp \
+          ../RayKernelsAVX2.cpp \
+          ../RayKernelsAVX512.cpp \
+          ../ScratchArena.cpp \
+          ../RenderCheckpoint.cpp \
+          ../Ray.cpp \
+          ../KDTree.cpp \
+          ../Node.cpp
+
+    DESTDIR=.
+
+unix {
+    LIBS += -lGL \
+	-lrt
+}
+
+OBJECTS_DIR = .tmp
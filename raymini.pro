@@ -8,6 +8,7 @@ HEADERS = Window.h \
           Vertex.h \
           Triangle.h \
           Mesh.h \
+          MeshAdjacency.h \
           BoundingBox.h \
           Material.h \
           Object.h \
@@ -15,6 +16,27 @@ HEADERS = Window.h \
           AreaLight.h \
           Scene.h \
           RayTracer.h \
+          RenderSettings.h \
+          RenderCheckpoint.h \
+          Hash.h \
+          RenderProtocol.h \
+          Socket.h \
+          RenderCoordinator.h \
+          RenderWorker.h \
+          RenderServer.h \
+          RenderClient.h \
+          RenderMesh.h \
+          SharedScene.h \
+          SceneGenerator.h \
+          RenderStats.h \
+          RenderCostMap.h \
+          Trace.h \
+          SceneReport.h \
+          KDTreeTuner.h \
+          RayKernels.h \
+          RayKernelsLanes.h \
+          ScratchArena.h \
+          ThreadPool.h \
           Ray.h \
     	  Vec3D.h \
           KDTree.h \
@@ -26,6 +48,7 @@ SOURCES = Window.cpp \
           Vertex.cpp \
           Triangle.cpp \
           Mesh.cpp \
+          MeshAdjacency.cpp \
           BoundingBox.cpp \
           Material.cpp \
           Object.cpp \
@@ -33,6 +56,27 @@ SOURCES = Window.cpp \
           AreaLight.cpp \
           Scene.cpp \ 
           RayTracer.cpp \
+          RenderCheckpoint.cpp \
+          RenderProtocol.cpp \
+          Socket.cpp \
+          RenderCoordinator.cpp \
+          RenderWorker.cpp \
+          RenderServer.cpp \
+          RenderClient.cpp \
+          RenderMesh.cpp \
+          SharedScene.cpp \
+          SceneGenerator.cpp \
+          RenderStats.cpp \
+          RenderCostMap.cpp \
+          Trace.cpp \
+          SceneReport.cpp \
+          KDTreeTuner.cpp \
+          RayKernels.cpp \
+          RayKernelsSSE42.cpp \
+          RayKernelsAVX2.cpp \
+          RayKernelsAVX512.cpp \
+          ScratchArena.cpp \
+          ThreadPool.cpp \
           Ray.cpp \
           Main.cpp \
           KDTree.cpp \
@@ -40,6 +84,11 @@ SOURCES = Window.cpp \
 
     DESTDIR=.
 
+# Ray and traversal counters (RenderStats), off in plain release builds
+CONFIG(debug, debug|release)|stats {
+    DEFINES += RAYMINI_STATS
+}
+
 win32 {
     INCLUDEPATH += 'C:\Users\plequ_000\projects\computer-graphics\extern\libQGLViewer-2.3.17'
     LIBS += -L"C:\Users\plequ_000\projects\computer-graphics\extern\libQGLViewer-2.3.17\QGLViewer\release" \
@@ -51,7 +100,8 @@ win32 {
 unix {
     LIBS += -lGLEW \
         -lQGLViewer \
-	-lGLU
+	-lGLU \
+	-lrt
 }
 
 MOC_DIR = .tmp